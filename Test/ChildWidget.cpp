@@ -30,25 +30,25 @@ bool ChildWidget::OnMessageReceived(const IPC::Message& message)
 	IPC_BEGIN_MESSAGE_MAP(ChildWidget, message)
 	  IPC_MESSAGE_HANDLER(TestMsg_Text, OnShowText)
 	  IPC_MESSAGE_HANDLER(TestMsg_Log,  OnLogdata)
-	  IPC_MESSAGE_HANDLER(TestMsg_Live, OnLiveData)
+	  IPC_MESSAGE_HANDLER_WITH_SCRATCH(TestMsg_Live, OnLiveData, live_scratch_)
 	IPC_END_MESSAGE_MAP()
 
 	return true;
 }
 
-void ChildWidget::OnShowText(std::string text)
+void ChildWidget::OnShowText(const std::string& text)
 {
 	ui.textEdit->append(QString::fromUtf8(text.data()));
 }
 
-void ChildWidget::OnLogdata(Logdata data)
+void ChildWidget::OnLogdata(const Logdata& data)
 {
 	ui.textEdit->append(QString::number(data.id));
 	ui.textEdit->append(QString::fromUtf8(data.name.data()));
 	ui.textEdit->append(QString::number(data.time));
 }
 
-void ChildWidget::OnLiveData(Loglive data)
+void ChildWidget::OnLiveData(const Loglive& data)
 {
 	ui.textEdit->append(QString::number(data.id));
 	ui.textEdit->append(QString::number(data.flows));
@@ -2,6 +2,7 @@
 #define CHILDWIDGET_H
 
 #include <QWidget>
+#include <tuple>
 #include "ui_ChildWidget.h"
 
 #include "ipc/message_filter.h"
@@ -25,15 +26,19 @@ public:
 
     virtual bool OnMessageReceived(const IPC::Message& message);
 
-	void OnShowText(std::string text);
-	void OnLogdata(Logdata data);
-	void OnLiveData(Loglive data);
+	void OnShowText(const std::string& text);
+	void OnLogdata(const Logdata& data);
+	void OnLiveData(const Loglive& data);
 
 
 private:
 	Ui::ChildWidget ui;
 
 	content::RenderProcess* process_;
+
+	// TestMsg_Live comes at a high rate, its parameters are decoded into the
+	// same objects every time.
+	std::tuple<Loglive> live_scratch_;
 };
 
 #endif // CHILDWIDGET_H
@@ -0,0 +1,167 @@
+#include "ipc_benchmark.h"
+
+#include <stdint.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <QCoreApplication>
+#include <QDebug>
+#include <QLocalSocket>
+
+#include "base/time2.h"
+#include "ipc/ipc_channel_qt.h"
+#include "ipc/ipc_listener.h"
+#include "ipc/ipc_message.h"
+#include "ipc/ipc_message_utils.h"
+
+namespace {
+
+const int kIterations = 10;
+
+// Milliseconds to write |p| to a message and read it back with |Traits|.
+template <class Traits>
+double RoundTrip(const typename Traits::param_type& p)
+{
+	base::TimeTicks start = TimeTicksNow;
+	for (int i = 0; i < kIterations; ++i)
+	{
+		IPC::Message m(MSG_ROUTING_NONE, 0);
+		Traits::Write(&m, p);
+
+		base::PickleIterator iter(m);
+		typename Traits::param_type r;
+		if (!Traits::Read(&m, &iter, &r) || r != p)
+		{
+			qDebug() << "round trip failed";
+			return -1;
+		}
+	}
+	return static_cast<double>(TimeTicksNow - start) / kIterations;
+}
+
+// The memcpy path of ParamTraits<std::vector<P> > against the element by
+// element one.
+template <class P>
+void BenchmarkVector(const char* name)
+{
+	std::vector<P> p(1000 * 1000);
+	for (size_t i = 0; i < p.size(); ++i)
+		p[i] = static_cast<P>(i);
+
+	double bulk = RoundTrip<IPC::internal::VectorParamTraits<P, true> >(p);
+	double each = RoundTrip<IPC::internal::VectorParamTraits<P, false> >(p);
+	qDebug() << "vector<" << name << "> of 1M elements, ms per round trip:"
+			 << "memcpy" << bulk << "per element" << each;
+}
+
+// Counts the clients whose hello message reached the server.
+class BroadcastListener : public IPC::Listener
+{
+public:
+	BroadcastListener() : connected_(0) {}
+
+	int connected() const { return connected_; }
+
+	virtual bool OnMessageReceived(const IPC::Message& /*message*/) { return false; }
+	virtual void OnChannelConnected(int32_t /*peer_pid*/) { ++connected_; }
+
+private:
+	int connected_;
+};
+
+// ChannelServer::SendAll() fanning one 1 MB message out to 500 clients. The
+// clients are plain sockets, each says hello with a pid of its own so the
+// server keeps them apart, and reads until it has the hello of the server
+// and the broadcast.
+void BenchmarkBroadcast()
+{
+	const int kClients = 500;
+	const size_t kPayloadBytes = 1024 * 1024;
+	const qint64 kTimeoutMs = 60 * 1000;
+	const std::string kChannelName = "libHH.ipc_benchmark";
+
+	BroadcastListener listener;
+	IPC::ChannelServer server(kChannelName, &listener);
+	server.Connect();
+
+	std::vector<std::unique_ptr<QLocalSocket> > clients;
+	for (int i = 0; i < kClients; ++i)
+	{
+		std::unique_ptr<QLocalSocket> client(new QLocalSocket);
+		client->connectToServer(QString::fromStdString(kChannelName));
+
+		// The server accepts from the event loop.
+		qint64 deadline = TimeTicksNow + kTimeoutMs;
+		while (client->state() == QLocalSocket::ConnectingState && TimeTicksNow < deadline)
+			QCoreApplication::processEvents();
+		if (client->state() != QLocalSocket::ConnectedState)
+		{
+			qDebug() << "broadcast: client" << i << "failed to connect";
+			return;
+		}
+
+		IPC::Message hello(MSG_ROUTING_NONE, IPC::Channel::HELLO_MESSAGE_TYPE);
+		hello.WriteInt32(i + 1);
+		client->write(reinterpret_cast<const char*>(hello.data()), hello.size());
+		clients.push_back(std::move(client));
+	}
+
+	qint64 deadline = TimeTicksNow + kTimeoutMs;
+	while (listener.connected() < kClients && TimeTicksNow < deadline)
+		QCoreApplication::processEvents();
+	if (listener.connected() < kClients)
+	{
+		qDebug() << "broadcast: only" << listener.connected() << "clients said hello";
+		return;
+	}
+
+	IPC::Message* msg = new IPC::Message(MSG_ROUTING_CONTROL, 0);
+	IPC::WriteParam(msg, std::string(kPayloadBytes, 'x'));
+
+	IPC::Message server_hello(MSG_ROUTING_NONE, IPC::Channel::HELLO_MESSAGE_TYPE);
+	server_hello.WriteInt32(1);
+	const qint64 expected = server_hello.size() + msg->size();
+
+	std::vector<qint64> received(kClients, 0);
+	std::vector<char> buffer(64 * 1024);
+	int done = 0;
+
+	base::TimeTicks start = TimeTicksNow;
+	server.Send(msg);
+	deadline = start + kTimeoutMs;
+	while (done < kClients && TimeTicksNow < deadline)
+	{
+		QCoreApplication::processEvents();
+		for (int i = 0; i < kClients; ++i)
+		{
+			if (received[i] == expected)
+				continue;
+
+			qint64 count;
+			while ((count = clients[i]->read(buffer.data(), buffer.size())) > 0)
+				received[i] += count;
+			if (received[i] == expected)
+				++done;
+		}
+	}
+	base::TimeTicks elapsed = TimeTicksNow - start;
+
+	if (done < kClients)
+	{
+		qDebug() << "broadcast: only" << done << "of" << kClients << "clients got the message";
+		return;
+	}
+	qDebug() << "broadcast of 1 MB to" << kClients << "clients, ms:" << elapsed
+			 << "MB/s:" << (elapsed > 0 ? kClients * 1000.0 / elapsed : 0.0);
+}
+
+}  // namespace
+
+void RunIpcBenchmarks()
+{
+	BenchmarkVector<int>("int");
+	BenchmarkVector<double>("double");
+	BenchmarkBroadcast();
+}
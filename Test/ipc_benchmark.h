@@ -0,0 +1,8 @@
+#ifndef IPC_BENCHMARK_H
+#define IPC_BENCHMARK_H
+
+// Micro benchmarks of the IPC serialization and channels, run with
+// -benchmark instead of opening the window. Results go to qDebug().
+void RunIpcBenchmarks();
+
+#endif // IPC_BENCHMARK_H
@@ -0,0 +1,323 @@
+#include "ipc_self_test.h"
+
+#include <functional>
+#include <memory>
+#include <string>
+
+#include <QDebug>
+
+#include "base/synchronization/waitable_event.h"
+#include "base/threading/thread.h"
+#include "base/time2.h"
+#include "ipc/ipc_channel_proxy.h"
+#include "ipc/ipc_message.h"
+#include "ipc/ipc_message_macros.h"
+#include "ipc/ipc_message_utils.h"
+#include "ipc/ipc_sync_channel.h"
+#include "message_define.h"
+
+namespace {
+
+int Check(bool condition, const char* test, const char* what)
+{
+	if (condition)
+		return 0;
+
+	qDebug() << test << "failed:" << what;
+	return 1;
+}
+
+// GetParamSize() of wide strings against the bytes written, characters above
+// the BMP included.
+int TestWStringRoundTrip()
+{
+	const wchar_t* strings[] = {
+		L"",
+		L"a",
+		L"ab",
+		L"\u00e9t\u00e9",
+		L"\U0001F600\U0001F601",
+		L"x\U00010000y",
+	};
+
+	int failures = 0;
+	for (size_t i = 0; i < sizeof(strings) / sizeof(strings[0]); ++i)
+	{
+		std::wstring s(strings[i]);
+		IPC::Message m(MSG_ROUTING_NONE, 0);
+		IPC::WriteParam(&m, s);
+		failures += Check(IPC::GetParamSize(s) == m.payload_size(),
+						  "TestWStringRoundTrip", "GetSize() differs from the written size");
+
+		base::PickleIterator iter(m);
+		std::wstring r;
+		failures += Check(IPC::ReadParam(&m, &iter, &r) && r == s,
+						  "TestWStringRoundTrip", "read back a different string");
+	}
+	return failures;
+}
+
+// A coalescing window no test should wait out.
+const int64_t kLongWindowMs = 60 * 1000;
+
+void RunAndSignal(const std::function<void()>& task, base::WaitableEvent* done)
+{
+	task();
+	done->Signal();
+}
+
+// Runs |task| on |thread| and waits for it. The channels are created and
+// destroyed on the thread of their listener.
+void RunOnThread(base::Thread* thread, const std::function<void()>& task)
+{
+	base::WaitableEvent done;
+	base::Closure closure = std::bind(&RunAndSignal, task, &done);
+	thread->task_runner()->PostTask(closure);
+	done.Wait();
+}
+
+class TestListener : public IPC::Listener, public IPC::Sender
+{
+public:
+	TestListener()
+		: channel(NULL), expected_sequences(0), sequences(0), last_sequence(-1), in_order(true) {}
+
+	bool Send(IPC::Message* message) override { return channel->Send(message); }
+
+	bool OnMessageReceived(const IPC::Message& message) override
+	{
+		IPC_BEGIN_MESSAGE_MAP(TestListener, message)
+			IPC_MESSAGE_HANDLER(TestMsg_Echo, OnEcho)
+			IPC_MESSAGE_HANDLER(TestMsg_Sequence, OnSequence)
+		IPC_END_MESSAGE_MAP()
+		return true;
+	}
+
+	void OnEcho(int value, int* result) { *result = value; }
+
+	void OnSequence(int value)
+	{
+		if (value <= last_sequence)
+			in_order = false;
+		last_sequence = value;
+		if (++sequences == expected_sequences)
+			received.Signal();
+	}
+
+	IPC::Sender* channel;
+
+	int expected_sequences;
+	int sequences;
+	int last_sequence;
+	bool in_order;
+	base::WaitableEvent received;
+};
+
+// A sync message gets its reply at once from a peer that coalesces its
+// sends, the reply does not wait for the window.
+int TestSyncReplyWithCoalescing()
+{
+	base::Thread io_thread(base::Thread::IO);
+	base::Thread server_thread(base::Thread::UI);
+	base::Thread client_thread(base::Thread::UI);
+	io_thread.Start();
+	server_thread.Start();
+	client_thread.Start();
+
+	const IPC::ChannelHandle name("libHH.selftest.sync_reply");
+	TestListener server;
+	TestListener client;
+	std::unique_ptr<IPC::ChannelProxy> server_channel;
+	std::unique_ptr<IPC::SyncChannel> client_channel;
+
+	RunOnThread(&server_thread, [&]() {
+		server_channel = IPC::ChannelProxy::Create(name, IPC::Channel::MODE_SERVER, &server,
+												   io_thread.task_runner());
+		server_channel->SetSendCoalescing(kLongWindowMs, 1 << 30);
+		server.channel = server_channel.get();
+	});
+
+	bool sent = false;
+	int result = 0;
+	base::TimeTicks elapsed = 0;
+	RunOnThread(&client_thread, [&]() {
+		client_channel = IPC::SyncChannel::Create(name, IPC::Channel::MODE_CLIENT, &client,
+												  io_thread.task_runner());
+		client.channel = client_channel.get();
+
+		base::TimeTicks start = TimeTicksNow;
+		sent = client_channel->Send(new TestMsg_Echo(7, &result));
+		elapsed = TimeTicksNow - start;
+	});
+
+	int failures = 0;
+	failures += Check(sent && result == 7, "TestSyncReplyWithCoalescing", "no reply");
+	failures += Check(elapsed < kLongWindowMs / 2, "TestSyncReplyWithCoalescing",
+					  "the reply waited for the coalescing window");
+
+	RunOnThread(&client_thread, [&]() { client_channel.reset(); });
+	RunOnThread(&server_thread, [&]() { server_channel.reset(); });
+	return failures;
+}
+
+// Messages held by coalescing go out before the ones sent after it was
+// turned off on another thread.
+int TestCoalescingOrder()
+{
+	const int kSequences = 20000;
+
+	base::Thread io_thread(base::Thread::IO);
+	base::Thread server_thread(base::Thread::UI);
+	base::Thread client_thread(base::Thread::UI);
+	io_thread.Start();
+	server_thread.Start();
+	client_thread.Start();
+
+	const IPC::ChannelHandle name("libHH.selftest.coalescing_order");
+	TestListener server;
+	TestListener client;
+	server.expected_sequences = kSequences;
+	std::unique_ptr<IPC::ChannelProxy> server_channel;
+	std::unique_ptr<IPC::ChannelProxy> client_channel;
+
+	RunOnThread(&server_thread, [&]() {
+		server_channel = IPC::ChannelProxy::Create(name, IPC::Channel::MODE_SERVER, &server,
+												   io_thread.task_runner());
+		server.channel = server_channel.get();
+	});
+	RunOnThread(&client_thread, [&]() {
+		client_channel = IPC::ChannelProxy::Create(name, IPC::Channel::MODE_CLIENT, &client,
+												   io_thread.task_runner());
+		client.channel = client_channel.get();
+	});
+
+	// The client's thread sends while this one turns coalescing on and off.
+	base::WaitableEvent all_sent;
+	std::function<void()> send = [&]() {
+		for (int i = 0; i < kSequences; ++i)
+			client_channel->Send(new TestMsg_Sequence(i));
+	};
+	base::Closure closure = std::bind(&RunAndSignal, send, &all_sent);
+	client_thread.task_runner()->PostTask(closure);
+	while (!all_sent.IsSignaled())
+	{
+		client_channel->SetSendCoalescing(0, 0);
+		client_channel->SetSendCoalescing(5, 64 * 1024);
+	}
+	client_channel->SetSendCoalescing(0, 0);
+
+	int failures = 0;
+	failures += Check(server.received.Wait(static_cast<unsigned long>(kLongWindowMs)),
+					  "TestCoalescingOrder",
+					  "messages were lost");
+	RunOnThread(&server_thread, [&]() {
+		failures += Check(server.in_order, "TestCoalescingOrder", "messages overtook each other");
+	});
+
+	RunOnThread(&client_thread, [&]() { client_channel.reset(); });
+	RunOnThread(&server_thread, [&]() { server_channel.reset(); });
+	return failures;
+}
+
+// A client floods a server whose listener is busy past
+// Channel::kReceiveWindowMessages, then both send sync messages to each
+// other. The replies and sync messages do not wait for credit, which the
+// server's listener only grants once its Send() returned.
+struct FloodTest
+{
+	FloodTest()
+		: io_thread(base::Thread::IO),
+		  server_thread(base::Thread::UI),
+		  client_thread(base::Thread::UI),
+		  server_result(0),
+		  client_result(0) {}
+
+	base::Thread io_thread;
+	base::Thread server_thread;
+	base::Thread client_thread;
+	TestListener server;
+	TestListener client;
+	std::unique_ptr<IPC::SyncChannel> server_channel;
+	std::unique_ptr<IPC::SyncChannel> client_channel;
+	base::WaitableEvent flooded;
+	base::WaitableEvent server_done;
+	base::WaitableEvent client_done;
+	int server_result;
+	int client_result;
+};
+
+int TestSyncAfterFlood()
+{
+	const int kSequences = 2 * static_cast<int>(IPC::Channel::kReceiveWindowMessages);
+
+	// Left running if the channels deadlock, their threads never return.
+	FloodTest* test = new FloodTest;
+	test->io_thread.Start();
+	test->server_thread.Start();
+	test->client_thread.Start();
+	test->server.expected_sequences = kSequences;
+
+	const IPC::ChannelHandle name("libHH.selftest.sync_after_flood");
+	RunOnThread(&test->server_thread, [test, &name]() {
+		test->server_channel = IPC::SyncChannel::Create(name, IPC::Channel::MODE_SERVER,
+														&test->server,
+														test->io_thread.task_runner());
+		test->server.channel = test->server_channel.get();
+	});
+	RunOnThread(&test->client_thread, [test, &name]() {
+		test->client_channel = IPC::SyncChannel::Create(name, IPC::Channel::MODE_CLIENT,
+														&test->client,
+														test->io_thread.task_runner());
+		test->client.channel = test->client_channel.get();
+	});
+
+	// The server's listener takes none of the flood until it sent its own
+	// sync message.
+	std::function<void()> server_send = [test]() {
+		test->flooded.Wait();
+		test->server_channel->Send(new TestMsg_Echo(3, &test->server_result));
+	};
+	base::Closure closure = std::bind(&RunAndSignal, server_send, &test->server_done);
+	test->server_thread.task_runner()->PostTask(closure);
+
+	std::function<void()> client_send = [test, kSequences]() {
+		for (int i = 0; i < kSequences; ++i)
+			test->client_channel->Send(new TestMsg_Sequence(i));
+		test->flooded.Signal();
+		test->client_channel->Send(new TestMsg_Echo(7, &test->client_result));
+	};
+	closure = std::bind(&RunAndSignal, client_send, &test->client_done);
+	test->client_thread.task_runner()->PostTask(closure);
+
+	unsigned long timeout = static_cast<unsigned long>(kLongWindowMs);
+	bool done = test->server_done.Wait(timeout) && test->client_done.Wait(timeout) &&
+				test->server.received.Wait(timeout);
+	if (!done)
+		return Check(false, "TestSyncAfterFlood", "the channels deadlocked");
+
+	int failures = 0;
+	failures += Check(test->server_result == 3 && test->client_result == 7,
+					  "TestSyncAfterFlood", "wrong reply");
+	RunOnThread(&test->server_thread, [test, &failures]() {
+		failures += Check(test->server.in_order, "TestSyncAfterFlood",
+						  "messages overtook each other");
+	});
+
+	RunOnThread(&test->client_thread, [test]() { test->client_channel.reset(); });
+	RunOnThread(&test->server_thread, [test]() { test->server_channel.reset(); });
+	delete test;
+	return failures;
+}
+
+}  // namespace
+
+int RunIpcSelfTests()
+{
+	int failures = 0;
+	failures += TestWStringRoundTrip();
+	failures += TestSyncReplyWithCoalescing();
+	failures += TestCoalescingOrder();
+	failures += TestSyncAfterFlood();
+	qDebug() << "IPC self tests:" << failures << "failures";
+	return failures;
+}
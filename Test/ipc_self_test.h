@@ -0,0 +1,8 @@
+#ifndef IPC_SELF_TEST_H
+#define IPC_SELF_TEST_H
+
+// Checks of the IPC code, run with -selftest instead of opening the window.
+// Failures go to qDebug(). Returns the number of failed checks.
+int RunIpcSelfTests();
+
+#endif // IPC_SELF_TEST_H
@@ -3,6 +3,8 @@
 #include <stdint.h>
 
 #include "ChildWidget.h"
+#include "ipc_benchmark.h"
+#include "ipc_self_test.h"
 
 #include "base/lazy_instance.h"
 #include "base/message_loop/message_loop.h"
@@ -14,6 +16,8 @@ int main(int argc, char *argv[])
 	QApplication a(argc, argv);
 
 	bool is_client = false;
+	bool run_benchmark = false;
+	bool run_self_test = false;
 	QString pipe_name;
 	for (int i = 0; i < argc; i++)
 	{
@@ -26,8 +30,25 @@ int main(int argc, char *argv[])
 		{
 			pipe_name = QString::fromLatin1(argv[++i]);
 		}
+		else if (lowerArgument == QString::fromLatin1("-benchmark"))
+		{
+			run_benchmark = true;
+		}
+		else if (lowerArgument == QString::fromLatin1("-selftest"))
+		{
+			run_self_test = true;
+		}
 	}
 
+	if (run_benchmark)
+	{
+		RunIpcBenchmarks();
+		return 0;
+	}
+
+	if (run_self_test)
+		return RunIpcSelfTests() ? 1 : 0;
+
     // ҪȴһuiϢѭ
     //  io ̵߳listenӿڴ ui߳
     base::MessageLoop *loop = new base::MessageLoop(base::MessageLoopForUI::TYPE_UI);
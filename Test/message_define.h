@@ -30,4 +30,9 @@ IPC_MESSAGE_CONTROL1(TestMsg_Log, Logdata)
 
 IPC_MESSAGE_CONTROL1(TestMsg_Live, Loglive)
 
+// Used by the IPC self tests.
+IPC_SYNC_MESSAGE_CONTROL1_1(TestMsg_Echo, int, int)
+
+IPC_MESSAGE_CONTROL1(TestMsg_Sequence, int)
+
 #endif // message_define_h__
\ No newline at end of file
@@ -20,6 +20,13 @@ namespace IPC {
 #include "message_define.h"
 }
 
+// Generate param traits size methods.
+#include "IPC/param_traits_size_macros.h"
+namespace IPC {
+#undef message_define_h__
+#include "message_define.h"
+}
+
 // Generate param traits read methods.
 #include "IPC/param_traits_read_macros.h"
 namespace IPC {
@@ -20,6 +20,13 @@ namespace IPC {
 #include "message_traits.h"
 }  // namespace IPC
 
+// Generate param traits size methods.
+#include "IPC/param_traits_size_macros.h"
+namespace IPC {
+	#undef MESSAGE_TRAITS_H
+#include "message_traits.h"
+}  // namespace IPC
+
 // Generate param traits read methods.
 #include "IPC/param_traits_read_macros.h"
 namespace IPC {
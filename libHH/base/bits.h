@@ -6,6 +6,12 @@
 #include <stddef.h>
 #include <stdint.h>
 
+#include "build/build_config.h"
+
+#if defined(COMPILER_MSVC)
+#include <intrin.h>
+#endif
+
 namespace base {
 namespace bits {
 
@@ -41,6 +47,25 @@ inline size_t Align(size_t size, size_t alignment) {
   return (size + alignment - 1) & ~(alignment - 1);
 }
 
+// Returns the number of zero bits below the lowest set bit of |x|, 64 if
+// |x| is 0.
+inline int CountTrailingZeroBits64(uint64_t x) {
+#if defined(COMPILER_MSVC)
+  unsigned long index;
+#if defined(ARCH_CPU_64_BITS)
+  return _BitScanForward64(&index, x) ? static_cast<int>(index) : 64;
+#else
+  if (_BitScanForward(&index, static_cast<uint32_t>(x)))
+    return static_cast<int>(index);
+  if (_BitScanForward(&index, static_cast<uint32_t>(x >> 32)))
+    return 32 + static_cast<int>(index);
+  return 64;
+#endif
+#else
+  return x ? __builtin_ctzll(x) : 64;
+#endif
+}
+
 }  // namespace bits
 }  // namespace base
 
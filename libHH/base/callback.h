@@ -15,6 +15,8 @@ class CallBack
 public:
 	typedef std::function<R> InvokeFuncStorage;
 
+	CallBack() {}
+
 	CallBack(InvokeFuncStorage func) {
 		polymorphic_invoke_ = func;
 	}
@@ -27,6 +29,9 @@ public:
         return *this;
     }
 
+	// Returns true if no function has been bound yet.
+	bool is_null() const { return !polymorphic_invoke_; }
+
 	void Run() const
 	{
 		polymorphic_invoke_();
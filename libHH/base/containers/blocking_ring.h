@@ -0,0 +1,136 @@
+#ifndef BLOCKING_RING_H__
+#define BLOCKING_RING_H__
+
+#include <stddef.h>
+
+#include "base/atomicops.h"
+#include "base/macros.h"
+#include "base/synchronization/waitable_event.h"
+#include "base/time2.h"
+
+namespace base {
+
+// Adds blocking waits to a SpscRing or a MpmcRing. The fast path is the one of
+// the ring, the events are only signaled when a thread is actually waiting on
+// the other side, so a busy ring never touches a mutex:
+//
+//   BlockingRing<SpscRing<Frame> > frames(256);
+//   // IO thread
+//   frames.Push(frame);
+//   // decoder thread
+//   Frame frame;
+//   while (frames.Pop(&frame, 1000))
+//       Decode(frame);
+template <typename Ring>
+class BlockingRing
+{
+public:
+	explicit BlockingRing(size_t capacity)
+		: ring_(capacity),
+		  waiting_consumers_(0),
+		  waiting_producers_(0)
+	{
+	}
+
+	Ring& ring() { return ring_; }
+
+	// Pushes |value|, waiting up to |timeout| ms for room. Returns false on
+	// timeout.
+	template <typename T>
+	bool Push(const T& value, TimeDelta timeout = -1)
+	{
+		return WaitFor(timeout, &waiting_producers_, &not_full_, [&]() { return ring_.Push(value); })
+			&& NotifyIfWaiting(&waiting_consumers_, &not_empty_);
+	}
+
+	// Pushes as many of |values| as fit right away, never blocks.
+	template <typename T>
+	size_t PushBatch(const T* values, size_t count)
+	{
+		size_t pushed = ring_.PushBatch(values, count);
+		if (pushed)
+			NotifyIfWaiting(&waiting_consumers_, &not_empty_);
+		return pushed;
+	}
+
+	// Pops into |value|, waiting up to |timeout| ms for data. Returns false on
+	// timeout.
+	template <typename T>
+	bool Pop(T* value, TimeDelta timeout = -1)
+	{
+		return WaitFor(timeout, &waiting_consumers_, &not_empty_, [&]() { return ring_.Pop(value); })
+			&& NotifyIfWaiting(&waiting_producers_, &not_full_);
+	}
+
+	// Waits up to |timeout| ms for data, then pops up to |max_count| values.
+	template <typename T>
+	size_t PopBatch(T* values, size_t max_count, TimeDelta timeout = -1)
+	{
+		size_t popped = 0;
+		if (!WaitFor(timeout, &waiting_consumers_, &not_empty_,
+			[&]() { popped = ring_.PopBatch(values, max_count); return popped != 0; }))
+			return 0;
+
+		NotifyIfWaiting(&waiting_producers_, &not_full_);
+		return popped;
+	}
+
+private:
+	// Runs |attempt| until it succeeds. A failed attempt announces the waiter
+	// in |waiters| and retries once before sleeping on |event|, the other side
+	// checks |waiters| after publishing, so either the retry sees the update
+	// or the other side sees the waiter. A negative |timeout| waits forever.
+	template <typename Attempt>
+	bool WaitFor(TimeDelta timeout, volatile subtle::Atomic32* waiters, WaitableEvent* event, Attempt attempt)
+	{
+		if (attempt())
+			return true;
+
+		TimeTicks deadline = timeout < 0 ? 0 : TimeTicksNow + timeout;
+		for (;;)
+		{
+			subtle::Barrier_AtomicIncrement(waiters, 1);
+			bool done = attempt();
+			if (!done)
+			{
+				unsigned long wait_time = ULONG_MAX;
+				if (timeout >= 0)
+				{
+					TimeDelta remaining = deadline - TimeTicksNow;
+					wait_time = remaining > 0 ? static_cast<unsigned long>(remaining) : 0;
+				}
+				if (wait_time)
+					event->Wait(wait_time);
+				done = attempt();
+			}
+			subtle::Barrier_AtomicIncrement(waiters, -1);
+
+			if (done)
+				return true;
+			if (timeout >= 0 && TimeTicksNow >= deadline)
+				return false;
+		}
+	}
+
+	bool NotifyIfWaiting(volatile subtle::Atomic32* waiters, WaitableEvent* event)
+	{
+		subtle::MemoryBarrier();
+		if (subtle::NoBarrier_Load(waiters) != 0)
+			event->Signal();
+		return true;
+	}
+
+	Ring ring_;
+
+	volatile subtle::Atomic32 waiting_consumers_;
+	volatile subtle::Atomic32 waiting_producers_;
+
+	WaitableEvent not_empty_;
+	WaitableEvent not_full_;
+
+	DISALLOW_COPY_AND_ASSIGN(BlockingRing);
+};
+
+}  // namespace base
+
+#endif // BLOCKING_RING_H__
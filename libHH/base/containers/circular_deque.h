@@ -0,0 +1,300 @@
+#ifndef CIRCULAR_DEQUE_H__
+#define CIRCULAR_DEQUE_H__
+
+#include <stddef.h>
+
+#include <iterator>
+#include <new>
+#include <utility>
+
+namespace base {
+
+// Double ended queue stored in one ring buffer. Unlike std::deque it does not
+// allocate and free a block every few hundred bytes while elements churn, the
+// buffer only grows (by doubling) and keeps its capacity when the queue is
+// drained. Push and pop at both ends are amortized O(1), indexing is O(1).
+//
+// Any push may reallocate and invalidates iterators, references and pointers
+// to the elements. It can be used as the container of a std::queue.
+template <typename T>
+class circular_deque
+{
+public:
+	typedef T value_type;
+	typedef size_t size_type;
+	typedef ptrdiff_t difference_type;
+	typedef T& reference;
+	typedef const T& const_reference;
+	typedef T* pointer;
+	typedef const T* const_pointer;
+
+	template <typename Deque, typename Value>
+	class basic_iterator
+	{
+	public:
+		typedef std::random_access_iterator_tag iterator_category;
+		typedef typename circular_deque::value_type value_type;
+		typedef ptrdiff_t difference_type;
+		typedef Value* pointer;
+		typedef Value& reference;
+
+		basic_iterator() : deque_(NULL), index_(0) {}
+		basic_iterator(Deque* deque, size_t index) : deque_(deque), index_(index) {}
+
+		// const_iterator from iterator.
+		template <typename OtherDeque, typename OtherValue>
+		basic_iterator(const basic_iterator<OtherDeque, OtherValue>& other)
+			: deque_(other.deque_), index_(other.index_) {}
+
+		reference operator*() const { return (*deque_)[index_]; }
+		pointer operator->() const { return &(*deque_)[index_]; }
+		reference operator[](difference_type n) const { return (*deque_)[index_ + n]; }
+
+		basic_iterator& operator++() { ++index_; return *this; }
+		basic_iterator operator++(int) { basic_iterator it(*this); ++index_; return it; }
+		basic_iterator& operator--() { --index_; return *this; }
+		basic_iterator operator--(int) { basic_iterator it(*this); --index_; return it; }
+		basic_iterator& operator+=(difference_type n) { index_ += n; return *this; }
+		basic_iterator& operator-=(difference_type n) { index_ -= n; return *this; }
+		basic_iterator operator+(difference_type n) const { return basic_iterator(deque_, index_ + n); }
+		basic_iterator operator-(difference_type n) const { return basic_iterator(deque_, index_ - n); }
+
+		difference_type operator-(const basic_iterator& other) const
+		{
+			return static_cast<difference_type>(index_) - static_cast<difference_type>(other.index_);
+		}
+
+		bool operator==(const basic_iterator& other) const { return index_ == other.index_; }
+		bool operator!=(const basic_iterator& other) const { return index_ != other.index_; }
+		bool operator<(const basic_iterator& other) const { return index_ < other.index_; }
+		bool operator>(const basic_iterator& other) const { return index_ > other.index_; }
+		bool operator<=(const basic_iterator& other) const { return index_ <= other.index_; }
+		bool operator>=(const basic_iterator& other) const { return index_ >= other.index_; }
+
+	private:
+		template <typename OtherDeque, typename OtherValue> friend class basic_iterator;
+
+		Deque* deque_;
+
+		// Logical index, 0 is the front.
+		size_t index_;
+	};
+
+	typedef basic_iterator<circular_deque, T> iterator;
+	typedef basic_iterator<const circular_deque, const T> const_iterator;
+
+	circular_deque()
+		: buffer_(NULL),
+		  capacity_(0),
+		  begin_(0),
+		  size_(0)
+	{
+	}
+
+	circular_deque(const circular_deque& other)
+		: buffer_(NULL),
+		  capacity_(0),
+		  begin_(0),
+		  size_(0)
+	{
+		reserve(other.size_);
+		for (size_t i = 0; i < other.size_; ++i)
+			push_back(other[i]);
+	}
+
+	circular_deque(circular_deque&& other)
+		: buffer_(other.buffer_),
+		  capacity_(other.capacity_),
+		  begin_(other.begin_),
+		  size_(other.size_)
+	{
+		other.buffer_ = NULL;
+		other.capacity_ = 0;
+		other.begin_ = 0;
+		other.size_ = 0;
+	}
+
+	~circular_deque()
+	{
+		clear();
+		::operator delete(buffer_);
+	}
+
+	circular_deque& operator=(const circular_deque& other)
+	{
+		if (this != &other)
+		{
+			circular_deque copy(other);
+			swap(copy);
+		}
+		return *this;
+	}
+
+	circular_deque& operator=(circular_deque&& other)
+	{
+		swap(other);
+		return *this;
+	}
+
+	bool empty() const { return size_ == 0; }
+	size_t size() const { return size_; }
+	size_t capacity() const { return capacity_; }
+
+	reference operator[](size_t i) { return buffer_[Slot(i)]; }
+	const_reference operator[](size_t i) const { return buffer_[Slot(i)]; }
+
+	reference front() { return buffer_[begin_]; }
+	const_reference front() const { return buffer_[begin_]; }
+	reference back() { return buffer_[Slot(size_ - 1)]; }
+	const_reference back() const { return buffer_[Slot(size_ - 1)]; }
+
+	iterator begin() { return iterator(this, 0); }
+	iterator end() { return iterator(this, size_); }
+	const_iterator begin() const { return const_iterator(this, 0); }
+	const_iterator end() const { return const_iterator(this, size_); }
+
+	void push_back(const T& value) { emplace_back(value); }
+	void push_back(T&& value) { emplace_back(std::move(value)); }
+	void push_front(const T& value) { emplace_front(value); }
+	void push_front(T&& value) { emplace_front(std::move(value)); }
+
+	template <typename... Args>
+	void emplace_back(Args&&... args)
+	{
+		if (size_ == capacity_)
+		{
+			// |args| may refer to an element, it is built before Grow()
+			// moves them.
+			T value(std::forward<Args>(args)...);
+			Grow();
+			new (&buffer_[Slot(size_)]) T(std::move(value));
+		}
+		else
+		{
+			new (&buffer_[Slot(size_)]) T(std::forward<Args>(args)...);
+		}
+		++size_;
+	}
+
+	template <typename... Args>
+	void emplace_front(Args&&... args)
+	{
+		if (size_ == capacity_)
+		{
+			// See emplace_back().
+			T value(std::forward<Args>(args)...);
+			Grow();
+			new (&buffer_[capacity_ - 1]) T(std::move(value));
+			begin_ = capacity_ - 1;
+		}
+		else
+		{
+			size_t slot = begin_ == 0 ? capacity_ - 1 : begin_ - 1;
+			new (&buffer_[slot]) T(std::forward<Args>(args)...);
+			begin_ = slot;
+		}
+		++size_;
+	}
+
+	void pop_front()
+	{
+		buffer_[begin_].~T();
+		if (++begin_ == capacity_)
+			begin_ = 0;
+		--size_;
+	}
+
+	void pop_back()
+	{
+		buffer_[Slot(size_ - 1)].~T();
+		--size_;
+	}
+
+	// Destroys the elements, the capacity is kept.
+	void clear()
+	{
+		while (size_)
+			pop_back();
+		begin_ = 0;
+	}
+
+	void reserve(size_t new_capacity)
+	{
+		if (new_capacity > capacity_)
+			Reallocate(new_capacity);
+	}
+
+	void shrink_to_fit()
+	{
+		if (size_ == 0)
+		{
+			::operator delete(buffer_);
+			buffer_ = NULL;
+			capacity_ = 0;
+			begin_ = 0;
+		}
+		else if (size_ < capacity_)
+		{
+			Reallocate(size_);
+		}
+	}
+
+	void swap(circular_deque& other)
+	{
+		std::swap(buffer_, other.buffer_);
+		std::swap(capacity_, other.capacity_);
+		std::swap(begin_, other.begin_);
+		std::swap(size_, other.size_);
+	}
+
+private:
+	enum { kMinCapacity = 4 };
+
+	size_t Slot(size_t i) const
+	{
+		size_t slot = begin_ + i;
+		return slot >= capacity_ ? slot - capacity_ : slot;
+	}
+
+	void Grow()
+	{
+		size_t new_capacity = capacity_ * 2;
+		if (new_capacity < kMinCapacity)
+			new_capacity = kMinCapacity;
+		Reallocate(new_capacity);
+	}
+
+	// Moves the elements to a new buffer of |new_capacity|, front at slot 0.
+	void Reallocate(size_t new_capacity)
+	{
+		T* new_buffer = static_cast<T*>(::operator new(new_capacity * sizeof(T)));
+		for (size_t i = 0; i < size_; ++i)
+		{
+			T& element = buffer_[Slot(i)];
+			new (&new_buffer[i]) T(std::move(element));
+			element.~T();
+		}
+
+		::operator delete(buffer_);
+		buffer_ = new_buffer;
+		capacity_ = new_capacity;
+		begin_ = 0;
+	}
+
+	T* buffer_;
+	size_t capacity_;
+
+	// Slot of the front element.
+	size_t begin_;
+	size_t size_;
+};
+
+template <typename T>
+inline void swap(circular_deque<T>& a, circular_deque<T>& b)
+{
+	a.swap(b);
+}
+
+}  // namespace base
+
+#endif // CIRCULAR_DEQUE_H__
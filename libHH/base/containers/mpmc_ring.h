@@ -0,0 +1,211 @@
+#ifndef MPMC_RING_H__
+#define MPMC_RING_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <utility>
+
+#include "base/atomicops.h"
+#include "base/bits.h"
+#include "base/macros.h"
+
+namespace base {
+
+// Bounded lock-free ring for any number of producers and consumers, after
+// Dmitry Vyukov's bounded MPMC queue. Every cell carries a sequence number
+// telling whether it is ready for the producer or the consumer of a given
+// lap, so a push or a pop costs one compare-and-swap on the shared position
+// and no lock. The capacity is rounded up to a power of two and all the cells
+// are allocated up front. T must be default constructible and assignable.
+template <typename T>
+class MpmcRing
+{
+public:
+	explicit MpmcRing(size_t capacity)
+		: capacity_(size_t(1) << bits::Log2Ceiling(static_cast<uint32_t>(capacity > 1 ? capacity : 2))),
+		  mask_(capacity_ - 1),
+		  cells_(new Cell[capacity_]),
+		  enqueue_pos_(0),
+		  dequeue_pos_(0)
+	{
+		for (size_t i = 0; i < capacity_; ++i)
+			subtle::NoBarrier_Store(&cells_[i].sequence, static_cast<subtle::AtomicWord>(i));
+	}
+
+	~MpmcRing()
+	{
+		delete[] cells_;
+	}
+
+	// Returns false if the ring is full.
+	bool Push(const T& value)
+	{
+		subtle::AtomicWord pos;
+		if (!ClaimEnqueue(1, &pos))
+			return false;
+
+		Cell& cell = cells_[pos & mask_];
+		cell.data = value;
+		subtle::Release_Store(&cell.sequence, pos + 1);
+		return true;
+	}
+
+	bool Push(T&& value)
+	{
+		subtle::AtomicWord pos;
+		if (!ClaimEnqueue(1, &pos))
+			return false;
+
+		Cell& cell = cells_[pos & mask_];
+		cell.data = std::move(value);
+		subtle::Release_Store(&cell.sequence, pos + 1);
+		return true;
+	}
+
+	// Claims up to |count| consecutive cells with one compare-and-swap and
+	// fills them. Returns the number pushed.
+	size_t PushBatch(const T* values, size_t count)
+	{
+		subtle::AtomicWord pos;
+		count = ClaimEnqueue(count, &pos);
+		for (size_t i = 0; i < count; ++i)
+		{
+			Cell& cell = cells_[(pos + i) & mask_];
+			cell.data = values[i];
+			subtle::Release_Store(&cell.sequence, pos + static_cast<subtle::AtomicWord>(i) + 1);
+		}
+		return count;
+	}
+
+	// Returns false if the ring is empty.
+	bool Pop(T* value)
+	{
+		subtle::AtomicWord pos;
+		if (!ClaimDequeue(1, &pos))
+			return false;
+
+		Cell& cell = cells_[pos & mask_];
+		*value = std::move(cell.data);
+		subtle::Release_Store(&cell.sequence, pos + static_cast<subtle::AtomicWord>(capacity_));
+		return true;
+	}
+
+	// Pops up to |max_count| consecutive values, returns the number popped.
+	size_t PopBatch(T* values, size_t max_count)
+	{
+		subtle::AtomicWord pos;
+		size_t count = ClaimDequeue(max_count, &pos);
+		for (size_t i = 0; i < count; ++i)
+		{
+			subtle::AtomicWord cell_pos = pos + static_cast<subtle::AtomicWord>(i);
+			Cell& cell = cells_[cell_pos & mask_];
+			values[i] = std::move(cell.data);
+			subtle::Release_Store(&cell.sequence, cell_pos + static_cast<subtle::AtomicWord>(capacity_));
+		}
+		return count;
+	}
+
+	// Approximate while other threads are pushing or popping.
+	bool IsEmpty() const
+	{
+		return size() == 0;
+	}
+
+	size_t size() const
+	{
+		subtle::AtomicWord dequeue_pos = subtle::Acquire_Load(&dequeue_pos_);
+		subtle::AtomicWord enqueue_pos = subtle::Acquire_Load(&enqueue_pos_);
+		return enqueue_pos > dequeue_pos ? static_cast<size_t>(enqueue_pos - dequeue_pos) : 0;
+	}
+
+	size_t capacity() const { return capacity_; }
+
+private:
+	enum { kCacheLineSize = 64 };
+
+	struct Cell
+	{
+		volatile subtle::AtomicWord sequence;
+		T data;
+	};
+
+	// Claims up to |count| cells starting at |*pos| for a producer. A cell is
+	// free for position p when its sequence equals p. Returns the number of
+	// cells claimed, 0 when the ring is full.
+	size_t ClaimEnqueue(size_t count, subtle::AtomicWord* pos)
+	{
+		return Claim(&enqueue_pos_, 0, count, pos);
+	}
+
+	// Same for a consumer, a cell holds the value of position p when its
+	// sequence equals p + 1.
+	size_t ClaimDequeue(size_t count, subtle::AtomicWord* pos)
+	{
+		return Claim(&dequeue_pos_, 1, count, pos);
+	}
+
+	size_t Claim(volatile subtle::AtomicWord* position, subtle::AtomicWord ready_offset,
+		size_t count, subtle::AtomicWord* pos)
+	{
+		if (count == 0)
+			return 0;
+
+		subtle::AtomicWord current = subtle::NoBarrier_Load(position);
+		for (;;)
+		{
+			subtle::AtomicWord seq = subtle::Acquire_Load(&cells_[current & mask_].sequence);
+			subtle::AtomicWord diff = seq - (current + ready_offset);
+			if (diff < 0)
+				return 0;
+
+			if (diff > 0)
+			{
+				// Another thread claimed |current| already.
+				current = subtle::NoBarrier_Load(position);
+				continue;
+			}
+
+			// The first cell is ready, see how many of the following ones are.
+			// Cells past |current| cannot be claimed by anyone else before
+			// |position| moves, so they stay ready once the CAS succeeds.
+			size_t ready = 1;
+			while (ready < count && ready < capacity_)
+			{
+				subtle::AtomicWord next = current + static_cast<subtle::AtomicWord>(ready);
+				if (subtle::Acquire_Load(&cells_[next & mask_].sequence) != next + ready_offset)
+					break;
+				++ready;
+			}
+
+			subtle::AtomicWord desired = current + static_cast<subtle::AtomicWord>(ready);
+			subtle::AtomicWord previous = subtle::NoBarrier_CompareAndSwap(position, current, desired);
+			if (previous == current)
+			{
+				*pos = current;
+				return ready;
+			}
+			current = previous;
+		}
+	}
+
+	const size_t capacity_;
+	const size_t mask_;
+	Cell* const cells_;
+
+	char pad0_[kCacheLineSize];
+
+	volatile subtle::AtomicWord enqueue_pos_;
+
+	char pad1_[kCacheLineSize - sizeof(subtle::AtomicWord)];
+
+	volatile subtle::AtomicWord dequeue_pos_;
+
+	char pad2_[kCacheLineSize - sizeof(subtle::AtomicWord)];
+
+	DISALLOW_COPY_AND_ASSIGN(MpmcRing);
+};
+
+}  // namespace base
+
+#endif // MPMC_RING_H__
@@ -0,0 +1,69 @@
+#ifndef SPAN_H__
+#define SPAN_H__
+
+#include <stddef.h>
+
+#include <vector>
+
+namespace base {
+
+// Non-owning view of |size| contiguous T, in the spirit of StringPiece. The
+// viewed memory must outlive the span. Used to hand out parts of a message
+// payload without copying them.
+template <typename T>
+class span
+{
+public:
+	typedef T element_type;
+	typedef T* iterator;
+
+	span() : data_(NULL), size_(0) {}
+	span(T* data, size_t size) : data_(data), size_(size) {}
+
+	template <size_t N>
+	span(T (&array)[N]) : data_(array), size_(N) {}
+
+	// span<const T> from span<T>.
+	template <typename U>
+	span(const span<U>& other) : data_(other.data()), size_(other.size()) {}
+
+	template <typename U, typename A>
+	span(std::vector<U, A>& v) : data_(v.empty() ? NULL : &v[0]), size_(v.size()) {}
+
+	template <typename U, typename A>
+	span(const std::vector<U, A>& v) : data_(v.empty() ? NULL : &v[0]), size_(v.size()) {}
+
+	T* data() const { return data_; }
+	size_t size() const { return size_; }
+	size_t size_bytes() const { return size_ * sizeof(T); }
+	bool empty() const { return size_ == 0; }
+
+	T& operator[](size_t i) const { return data_[i]; }
+
+	iterator begin() const { return data_; }
+	iterator end() const { return data_ + size_; }
+
+	// Returns at most |count| elements starting at |offset|.
+	span subspan(size_t offset, size_t count = static_cast<size_t>(-1)) const
+	{
+		if (offset > size_)
+			offset = size_;
+		if (count > size_ - offset)
+			count = size_ - offset;
+		return span(data_ + offset, count);
+	}
+
+private:
+	T* data_;
+	size_t size_;
+};
+
+template <typename T>
+inline span<T> make_span(T* data, size_t size)
+{
+	return span<T>(data, size);
+}
+
+}  // namespace base
+
+#endif // SPAN_H__
@@ -0,0 +1,178 @@
+#ifndef SPSC_RING_H__
+#define SPSC_RING_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <utility>
+
+#include "base/atomicops.h"
+#include "base/bits.h"
+#include "base/macros.h"
+
+namespace base {
+
+// Bounded lock-free ring for exactly one producer thread and one consumer
+// thread. The capacity is rounded up to a power of two and all the slots are
+// allocated up front, Push() and Pop() never allocate. T must be default
+// constructible and assignable, a popped slot keeps a moved-from T until it
+// is overwritten.
+//
+// The producer and consumer indices live on separate cache lines, and each
+// side keeps a cached copy of the other index so the shared line is only read
+// when the ring looks full (or empty).
+template <typename T>
+class SpscRing
+{
+public:
+	explicit SpscRing(size_t capacity)
+		: capacity_(size_t(1) << bits::Log2Ceiling(static_cast<uint32_t>(capacity > 1 ? capacity : 2))),
+		  mask_(capacity_ - 1),
+		  slots_(new T[capacity_]),
+		  tail_(0),
+		  cached_head_(0),
+		  head_(0),
+		  cached_tail_(0)
+	{
+	}
+
+	~SpscRing()
+	{
+		delete[] slots_;
+	}
+
+	// Producer side. Returns false if the ring is full.
+	bool Push(const T& value)
+	{
+		subtle::AtomicWord tail = tail_;
+		if (!HasRoom(tail, 1))
+			return false;
+
+		slots_[tail & mask_] = value;
+		subtle::Release_Store(&tail_, tail + 1);
+		return true;
+	}
+
+	bool Push(T&& value)
+	{
+		subtle::AtomicWord tail = tail_;
+		if (!HasRoom(tail, 1))
+			return false;
+
+		slots_[tail & mask_] = std::move(value);
+		subtle::Release_Store(&tail_, tail + 1);
+		return true;
+	}
+
+	// Producer side. Pushes up to |count| values with a single publication,
+	// returns the number pushed.
+	size_t PushBatch(const T* values, size_t count)
+	{
+		subtle::AtomicWord tail = tail_;
+		size_t room = capacity_ - static_cast<size_t>(tail - cached_head_);
+		if (room < count)
+		{
+			cached_head_ = subtle::Acquire_Load(&head_);
+			room = capacity_ - static_cast<size_t>(tail - cached_head_);
+			if (count > room)
+				count = room;
+		}
+
+		for (size_t i = 0; i < count; ++i)
+			slots_[(tail + i) & mask_] = values[i];
+
+		if (count)
+			subtle::Release_Store(&tail_, tail + static_cast<subtle::AtomicWord>(count));
+		return count;
+	}
+
+	// Consumer side. Returns false if the ring is empty.
+	bool Pop(T* value)
+	{
+		subtle::AtomicWord head = head_;
+		if (!HasData(head, 1))
+			return false;
+
+		*value = std::move(slots_[head & mask_]);
+		subtle::Release_Store(&head_, head + 1);
+		return true;
+	}
+
+	// Consumer side. Pops up to |max_count| values, returns the number popped.
+	size_t PopBatch(T* values, size_t max_count)
+	{
+		subtle::AtomicWord head = head_;
+		size_t available = static_cast<size_t>(cached_tail_ - head);
+		if (available < max_count)
+		{
+			cached_tail_ = subtle::Acquire_Load(&tail_);
+			available = static_cast<size_t>(cached_tail_ - head);
+		}
+
+		size_t count = available < max_count ? available : max_count;
+		for (size_t i = 0; i < count; ++i)
+			values[i] = std::move(slots_[(head + i) & mask_]);
+
+		if (count)
+			subtle::Release_Store(&head_, head + static_cast<subtle::AtomicWord>(count));
+		return count;
+	}
+
+	// Approximate when called while the other side is running.
+	bool IsEmpty() const
+	{
+		return subtle::Acquire_Load(&head_) == subtle::Acquire_Load(&tail_);
+	}
+
+	size_t size() const
+	{
+		return static_cast<size_t>(subtle::Acquire_Load(&tail_) - subtle::Acquire_Load(&head_));
+	}
+
+	size_t capacity() const { return capacity_; }
+
+private:
+	enum { kCacheLineSize = 64 };
+
+	bool HasRoom(subtle::AtomicWord tail, size_t count)
+	{
+		if (static_cast<size_t>(tail - cached_head_) + count <= capacity_)
+			return true;
+
+		cached_head_ = subtle::Acquire_Load(&head_);
+		return static_cast<size_t>(tail - cached_head_) + count <= capacity_;
+	}
+
+	bool HasData(subtle::AtomicWord head, size_t count)
+	{
+		if (static_cast<size_t>(cached_tail_ - head) >= count)
+			return true;
+
+		cached_tail_ = subtle::Acquire_Load(&tail_);
+		return static_cast<size_t>(cached_tail_ - head) >= count;
+	}
+
+	const size_t capacity_;
+	const size_t mask_;
+	T* const slots_;
+
+	char pad0_[kCacheLineSize];
+
+	// Written by the producer only.
+	volatile subtle::AtomicWord tail_;
+	subtle::AtomicWord cached_head_;
+
+	char pad1_[kCacheLineSize - 2 * sizeof(subtle::AtomicWord)];
+
+	// Written by the consumer only.
+	volatile subtle::AtomicWord head_;
+	subtle::AtomicWord cached_tail_;
+
+	char pad2_[kCacheLineSize - 2 * sizeof(subtle::AtomicWord)];
+
+	DISALLOW_COPY_AND_ASSIGN(SpscRing);
+};
+
+}  // namespace base
+
+#endif // SPSC_RING_H__
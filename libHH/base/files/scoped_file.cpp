@@ -0,0 +1,14 @@
+#include "base/files/scoped_file.h"
+
+#include <unistd.h>
+
+namespace base {
+
+void ScopedFD::reset(int fd)
+{
+	if (fd_ != -1 && fd_ != fd)
+		close(fd_);
+	fd_ = fd;
+}
+
+}  // namespace base
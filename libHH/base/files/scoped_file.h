@@ -0,0 +1,49 @@
+#ifndef SCOPED_FILE_H__
+#define SCOPED_FILE_H__
+
+#include "base/base_export.h"
+#include "base/macros.h"
+
+namespace base {
+
+// Owns a POSIX file descriptor and closes it when it goes away. Move only,
+// like base::win::ScopedHandle.
+class BASE_EXPORT ScopedFD
+{
+public:
+	ScopedFD() : fd_(-1) {}
+	explicit ScopedFD(int fd) : fd_(fd) {}
+
+	ScopedFD(ScopedFD&& other) : fd_(other.release()) {}
+
+	ScopedFD& operator=(ScopedFD&& other)
+	{
+		reset(other.release());
+		return *this;
+	}
+
+	~ScopedFD() { reset(); }
+
+	int get() const { return fd_; }
+	bool is_valid() const { return fd_ != -1; }
+
+	// Closes the descriptor owned so far and takes |fd|.
+	void reset(int fd = -1);
+
+	// Gives up ownership, the caller closes the descriptor.
+	int release()
+	{
+		int fd = fd_;
+		fd_ = -1;
+		return fd;
+	}
+
+private:
+	int fd_;
+
+	DISALLOW_COPY_AND_ASSIGN(ScopedFD);
+};
+
+}  // namespace base
+
+#endif // SCOPED_FILE_H__
@@ -0,0 +1,270 @@
+#include "base/memory/buffer_pool.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+
+#include "base/bits.h"
+#include "base/lazy_instance.h"
+
+namespace base {
+
+namespace {
+
+// Blocks a thread cache keeps per size class at most.
+const int kMaxThreadCacheSlots = 16;
+
+// Bytes a thread cache aims to keep per size class.
+const size_t kThreadCacheClassBytes = 64 * 1024;
+
+const size_t kDefaultMaxCachedBytes = 4 * 1024 * 1024;
+
+LazyInstance<BufferPool>::Leaky g_buffer_pool = LAZY_INSTANCE_INITIALIZER;
+
+}  // namespace
+
+struct BufferPool::ThreadCache
+{
+	explicit ThreadCache(BufferPool* pool)
+		: pool(pool)
+	{
+		memset(counts, 0, sizeof(counts));
+	}
+
+	BufferPool* const pool;
+
+	// blocks[c][0] is the oldest block of class c.
+	int counts[kNumSizeClasses];
+	void* blocks[kNumSizeClasses][kMaxThreadCacheSlots];
+};
+
+
+BufferPool::Stats::Stats()
+	: depot_bytes(0),
+	  max_cached_bytes(0),
+	  depot_hits(0),
+	  system_allocations(0),
+	  system_frees(0)
+{
+
+}
+
+
+BufferPool::BufferPool()
+	: thread_cache_slot_(&BufferPool::OnThreadExit),
+	  depot_bytes_(0),
+	  max_cached_bytes_(kDefaultMaxCachedBytes),
+	  depot_hits_(0),
+	  system_allocations_(0),
+	  system_frees_(0)
+{
+
+}
+
+// static
+BufferPool* BufferPool::GetInstance()
+{
+	return g_buffer_pool.Pointer();
+}
+
+void* BufferPool::Allocate(size_t size, size_t* capacity)
+{
+	int size_class = SizeClass(size);
+	if (size_class < 0)
+	{
+		*capacity = size;
+		subtle::NoBarrier_AtomicIncrement(&system_allocations_, 1);
+		return malloc(size);
+	}
+
+	*capacity = ClassSize(size_class);
+
+	ThreadCache* cache = GetThreadCache();
+	if (cache->counts[size_class] == 0)
+		FillFromDepot(cache, size_class, ThreadCacheSlots(size_class) / 2);
+	if (cache->counts[size_class] > 0)
+		return cache->blocks[size_class][--cache->counts[size_class]];
+
+	subtle::NoBarrier_AtomicIncrement(&system_allocations_, 1);
+	return malloc(*capacity);
+}
+
+void* BufferPool::Reallocate(void* block, size_t capacity, size_t used_size, size_t new_size, size_t* new_capacity)
+{
+	if (block && new_size <= capacity)
+	{
+		*new_capacity = capacity;
+		return block;
+	}
+
+	// Blocks above the size classes never come back to the pool, realloc
+	// may grow them in place.
+	if (block && SizeClass(capacity) < 0)
+	{
+		*new_capacity = new_size;
+		return realloc(block, new_size);
+	}
+
+	void* new_block = Allocate(new_size, new_capacity);
+	if (block)
+	{
+		memcpy(new_block, block, std::min(used_size, new_size));
+		Free(block, capacity);
+	}
+	return new_block;
+}
+
+void BufferPool::Free(void* block, size_t capacity)
+{
+	if (!block)
+		return;
+
+	int size_class = SizeClass(capacity);
+	if (size_class < 0 || ClassSize(size_class) != capacity)
+	{
+		subtle::NoBarrier_AtomicIncrement(&system_frees_, 1);
+		free(block);
+		return;
+	}
+
+	ThreadCache* cache = GetThreadCache();
+	int slots = ThreadCacheSlots(size_class);
+	if (cache->counts[size_class] == slots)
+		FlushToDepot(cache, size_class, slots / 2);
+	cache->blocks[size_class][cache->counts[size_class]++] = block;
+}
+
+void BufferPool::SetMaxCachedBytes(size_t max_cached_bytes)
+{
+	AutoLock lock(lock_);
+	max_cached_bytes_ = max_cached_bytes;
+	TrimDepotLocked(max_cached_bytes_);
+}
+
+size_t BufferPool::max_cached_bytes() const
+{
+	AutoLock lock(lock_);
+	return max_cached_bytes_;
+}
+
+void BufferPool::Trim()
+{
+	ThreadCache* cache = static_cast<ThreadCache*>(thread_cache_slot_.Get());
+	if (cache)
+	{
+		for (int i = 0; i < kNumSizeClasses; ++i)
+		{
+			for (int j = 0; j < cache->counts[i]; ++j)
+				free(cache->blocks[i][j]);
+			subtle::NoBarrier_AtomicIncrement(&system_frees_, cache->counts[i]);
+			cache->counts[i] = 0;
+		}
+	}
+
+	AutoLock lock(lock_);
+	TrimDepotLocked(0);
+}
+
+BufferPool::Stats BufferPool::GetStats() const
+{
+	Stats stats;
+	{
+		AutoLock lock(lock_);
+		stats.depot_bytes = depot_bytes_;
+		stats.max_cached_bytes = max_cached_bytes_;
+		stats.depot_hits = depot_hits_;
+	}
+	stats.system_allocations = subtle::NoBarrier_Load(&system_allocations_);
+	stats.system_frees = subtle::NoBarrier_Load(&system_frees_);
+	return stats;
+}
+
+// static
+int BufferPool::SizeClass(size_t size)
+{
+	if (size > static_cast<size_t>(kMaxBlockSize))
+		return -1;
+	if (size <= static_cast<size_t>(kMinBlockSize))
+		return 0;
+	return bits::Log2Ceiling(static_cast<uint32_t>(size)) - bits::Log2Ceiling(kMinBlockSize);
+}
+
+// static
+int BufferPool::ThreadCacheSlots(int size_class)
+{
+	size_t slots = kThreadCacheClassBytes / ClassSize(size_class);
+	return static_cast<int>(std::min<size_t>(std::max<size_t>(slots, 2), kMaxThreadCacheSlots));
+}
+
+BufferPool::ThreadCache* BufferPool::GetThreadCache()
+{
+	ThreadCache* cache = static_cast<ThreadCache*>(thread_cache_slot_.Get());
+	if (!cache)
+	{
+		cache = new ThreadCache(this);
+		thread_cache_slot_.Set(cache);
+	}
+	return cache;
+}
+
+int BufferPool::FillFromDepot(ThreadCache* cache, int size_class, int count)
+{
+	AutoLock lock(lock_);
+	std::vector<void*>& depot = depot_[size_class];
+	int moved = std::min(count, static_cast<int>(depot.size()));
+	for (int i = 0; i < moved; ++i)
+	{
+		cache->blocks[size_class][cache->counts[size_class]++] = depot.back();
+		depot.pop_back();
+	}
+
+	depot_bytes_ -= static_cast<size_t>(moved) * ClassSize(size_class);
+	depot_hits_ += moved;
+	return moved;
+}
+
+void BufferPool::FlushToDepot(ThreadCache* cache, int size_class, int count)
+{
+	void** blocks = cache->blocks[size_class];
+	{
+		AutoLock lock(lock_);
+		depot_[size_class].insert(depot_[size_class].end(), blocks, blocks + count);
+		depot_bytes_ += static_cast<size_t>(count) * ClassSize(size_class);
+		if (depot_bytes_ > max_cached_bytes_)
+			TrimDepotLocked(max_cached_bytes_);
+	}
+
+	// The newest blocks stay, they are more likely to be in the CPU cache.
+	cache->counts[size_class] -= count;
+	memmove(blocks, blocks + count, static_cast<size_t>(cache->counts[size_class]) * sizeof(void*));
+}
+
+void BufferPool::TrimDepotLocked(size_t max_bytes)
+{
+	for (int i = kNumSizeClasses - 1; i >= 0 && depot_bytes_ > max_bytes; --i)
+	{
+		std::vector<void*>& depot = depot_[i];
+		while (!depot.empty() && depot_bytes_ > max_bytes)
+		{
+			free(depot.back());
+			depot.pop_back();
+			depot_bytes_ -= ClassSize(i);
+			subtle::NoBarrier_AtomicIncrement(&system_frees_, 1);
+		}
+	}
+}
+
+// static
+void BufferPool::OnThreadExit(void* value)
+{
+	ThreadCache* cache = static_cast<ThreadCache*>(value);
+	for (int i = 0; i < kNumSizeClasses; ++i)
+	{
+		if (cache->counts[i])
+			cache->pool->FlushToDepot(cache, i, cache->counts[i]);
+	}
+	delete cache;
+}
+
+}  // namespace base
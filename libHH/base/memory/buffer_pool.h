@@ -0,0 +1,121 @@
+#ifndef BUFFER_POOL_H__
+#define BUFFER_POOL_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <vector>
+
+#include "base/atomicops.h"
+#include "base/base_export.h"
+#include "base/macros.h"
+#include "base/synchronization/lock.h"
+#include "base/threading/thread_local_storage.h"
+
+namespace base {
+
+// Recycles the heap buffers of Pickle and IPC::Message. Requests are rounded
+// up to a power of two size class between kMinBlockSize and kMaxBlockSize,
+// bigger ones go straight to malloc. Freed blocks first go to a small cache
+// of the calling thread, which needs no lock, and overflow in batches to a
+// global depot shared by all threads. A block freed by the listener thread
+// can so be reused by the IO thread for the next message it reads.
+//
+// The depot holds at most max_cached_bytes(), extra blocks are given back to
+// the system. Trim() empties the depot and the cache of the calling thread.
+class BASE_EXPORT BufferPool
+{
+public:
+	enum
+	{
+		kMinBlockSize = 512,
+		kMaxBlockSize = 256 * 1024,
+		kNumSizeClasses = 10,
+	};
+
+	struct Stats
+	{
+		Stats();
+
+		// Bytes waiting in the depot, the thread caches are not included.
+		size_t depot_bytes;
+		size_t max_cached_bytes;
+
+		// Blocks taken from the depot, and blocks taken from or given back to
+		// the system.
+		int64_t depot_hits;
+		int64_t system_allocations;
+		int64_t system_frees;
+	};
+
+	BufferPool();
+
+	// The pool used by Pickle.
+	static BufferPool* GetInstance();
+
+	// Returns a block of at least |size| bytes, |*capacity| receives its
+	// real size which must be handed back to Free().
+	void* Allocate(size_t size, size_t* capacity);
+
+	// Returns a block of at least |new_size| bytes holding the first
+	// |used_size| bytes of |block|. |block| may be NULL.
+	void* Reallocate(void* block, size_t capacity, size_t used_size, size_t new_size, size_t* new_capacity);
+
+	void Free(void* block, size_t capacity);
+
+	// Caps the bytes kept in the depot, the depot is trimmed right away if
+	// it holds more.
+	void SetMaxCachedBytes(size_t max_cached_bytes);
+	size_t max_cached_bytes() const;
+
+	// Gives the depot and the cache of the calling thread back to the system.
+	void Trim();
+
+	Stats GetStats() const;
+
+private:
+	struct ThreadCache;
+
+	// Index of the smallest class holding |size| bytes, -1 if |size| is
+	// above kMaxBlockSize.
+	static int SizeClass(size_t size);
+
+	static size_t ClassSize(int size_class) { return static_cast<size_t>(kMinBlockSize) << size_class; }
+
+	// Number of blocks of |size_class| a thread cache keeps.
+	static int ThreadCacheSlots(int size_class);
+
+	ThreadCache* GetThreadCache();
+
+	// Moves up to |count| blocks of |size_class| from the depot to |cache|.
+	// Returns the number moved.
+	int FillFromDepot(ThreadCache* cache, int size_class, int count);
+
+	// Moves the |count| oldest blocks of |size_class| from |cache| to the
+	// depot.
+	void FlushToDepot(ThreadCache* cache, int size_class, int count);
+
+	// Frees depot blocks until the depot holds at most |max_bytes|. |lock_|
+	// must be held.
+	void TrimDepotLocked(size_t max_bytes);
+
+	static void OnThreadExit(void* value);
+
+	ThreadLocalStorage::Slot thread_cache_slot_;
+
+	mutable Lock lock_;
+	std::vector<void*> depot_[kNumSizeClasses];
+	size_t depot_bytes_;
+	size_t max_cached_bytes_;
+	int64_t depot_hits_;
+
+	// Updated outside |lock_|.
+	volatile subtle::AtomicWord system_allocations_;
+	volatile subtle::AtomicWord system_frees_;
+
+	DISALLOW_COPY_AND_ASSIGN(BufferPool);
+};
+
+}  // namespace base
+
+#endif // BUFFER_POOL_H__
@@ -22,11 +22,11 @@ protected:
 	RefCountedBase() : ref_count_(0) {}
 	~RefCountedBase() {}
 
-	void AddRef() {
+	void AddRef() const {
 		++ref_count_;
 	}
 
-	bool Release() {
+	bool Release() const {
 		if (--ref_count_ == 0)
 			return true;
 
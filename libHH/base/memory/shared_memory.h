@@ -0,0 +1,77 @@
+#ifndef SHARED_MEMORY_H__
+#define SHARED_MEMORY_H__
+
+#include <stddef.h>
+
+#include "base/base_export.h"
+#include "base/macros.h"
+#include "base/memory/shared_memory_handle.h"
+
+namespace base {
+
+// A region of memory other processes can map, handed to them as a
+// SharedMemoryHandle in a message. Large payloads go this way instead of
+// through the channel: the sender writes them once, the receiver maps them.
+// Implemented on POSIX (memfd) only so far.
+//
+//   base::SharedMemory memory;
+//   if (memory.CreateAndMapAnonymous(size)) {
+//     memcpy(memory.memory(), pixels, size);
+//     Send(new ViewMsg_Frame(memory.handle()));
+//   }
+//
+//   // The receiver owns the handle it read.
+//   base::SharedMemory memory(handle, true);
+//   if (memory.Map(handle.GetSize()))
+//     Draw(memory.memory());
+class BASE_EXPORT SharedMemory
+{
+public:
+	SharedMemory();
+
+	// Takes ownership of |handle|. A |read_only| region is mapped read only.
+	SharedMemory(const SharedMemoryHandle& handle, bool read_only);
+
+	// Unmaps and closes the region.
+	~SharedMemory();
+
+	// Creates a new region of |size| bytes, zero filled. Returns false on
+	// failure or if the object already has a region.
+	bool Create(size_t size);
+
+	// Maps |bytes| from the start of the region. Returns false on failure or
+	// if it is mapped already.
+	bool Map(size_t bytes);
+	bool Unmap();
+
+	bool CreateAndMapAnonymous(size_t size)
+	{
+		return Create(size) && Map(size);
+	}
+
+	// The mapped bytes, NULL if not mapped.
+	void* memory() const { return memory_; }
+	size_t mapped_size() const { return mapped_size_; }
+
+	// The region, still owned by this object. Mappings stay valid after
+	// Close().
+	SharedMemoryHandle handle() const { return handle_; }
+
+	// Gives up ownership of the region, mappings stay valid.
+	SharedMemoryHandle TakeHandle();
+
+	// Closes the region, not the mapping.
+	void Close();
+
+private:
+	SharedMemoryHandle handle_;
+	bool read_only_;
+	void* memory_;
+	size_t mapped_size_;
+
+	DISALLOW_COPY_AND_ASSIGN(SharedMemory);
+};
+
+}  // namespace base
+
+#endif // SHARED_MEMORY_H__
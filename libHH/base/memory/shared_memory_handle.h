@@ -0,0 +1,44 @@
+#ifndef SHARED_MEMORY_HANDLE_H__
+#define SHARED_MEMORY_HANDLE_H__
+
+#include <stddef.h>
+
+#include "base/base_export.h"
+#include "build/build_config.h"
+
+namespace base {
+
+// Names a shared memory region, the descriptor of a memfd on POSIX. It is a
+// plain value and owns nothing, SharedMemory does. Sent in a message it is
+// duplicated, the receiver owns the copy it reads.
+class BASE_EXPORT SharedMemoryHandle
+{
+public:
+	SharedMemoryHandle() : fd_(-1), size_(0) {}
+
+#if defined(OS_POSIX)
+	SharedMemoryHandle(int fd, size_t size) : fd_(fd), size_(size) {}
+
+	int GetHandle() const { return fd_; }
+#endif
+
+	bool IsValid() const { return fd_ != -1; }
+
+	// Bytes of the region.
+	size_t GetSize() const { return size_; }
+
+	// Closes the descriptor, for a handle nobody took ownership of.
+	void Close();
+
+	// A handle of the same region with a descriptor of its own, invalid on
+	// failure.
+	SharedMemoryHandle Duplicate() const;
+
+private:
+	int fd_;
+	size_t size_;
+};
+
+}  // namespace base
+
+#endif // SHARED_MEMORY_HANDLE_H__
@@ -0,0 +1,117 @@
+#include "base/memory/shared_memory.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace base {
+
+void SharedMemoryHandle::Close()
+{
+	if (fd_ != -1)
+	{
+		close(fd_);
+		fd_ = -1;
+	}
+}
+
+SharedMemoryHandle SharedMemoryHandle::Duplicate() const
+{
+	if (fd_ == -1)
+		return SharedMemoryHandle();
+
+	int fd = fcntl(fd_, F_DUPFD_CLOEXEC, 0);
+	if (fd == -1)
+		return SharedMemoryHandle();
+	return SharedMemoryHandle(fd, size_);
+}
+
+
+SharedMemory::SharedMemory()
+	: read_only_(false),
+	  memory_(NULL),
+	  mapped_size_(0)
+{
+
+}
+
+SharedMemory::SharedMemory(const SharedMemoryHandle& handle, bool read_only)
+	: handle_(handle),
+	  read_only_(read_only),
+	  memory_(NULL),
+	  mapped_size_(0)
+{
+
+}
+
+SharedMemory::~SharedMemory()
+{
+	Unmap();
+	Close();
+}
+
+bool SharedMemory::Create(size_t size)
+{
+	if (handle_.IsValid() || !size)
+		return false;
+
+	int fd = memfd_create("libHH.shmem", MFD_CLOEXEC);
+	if (fd == -1)
+		return false;
+
+	if (ftruncate(fd, size) != 0)
+	{
+		close(fd);
+		return false;
+	}
+
+	handle_ = SharedMemoryHandle(fd, size);
+	return true;
+}
+
+bool SharedMemory::Map(size_t bytes)
+{
+	if (!handle_.IsValid() || memory_ || !bytes)
+		return false;
+
+	// The size in a handle comes from the other process, the region must
+	// really be that large or touching the mapping would fault.
+	struct stat info;
+	if (fstat(handle_.GetHandle(), &info) != 0 || static_cast<size_t>(info.st_size) < bytes)
+		return false;
+
+	int protection = read_only_ ? PROT_READ : PROT_READ | PROT_WRITE;
+	void* memory = mmap(NULL, bytes, protection, MAP_SHARED, handle_.GetHandle(), 0);
+	if (memory == MAP_FAILED)
+		return false;
+
+	memory_ = memory;
+	mapped_size_ = bytes;
+	return true;
+}
+
+bool SharedMemory::Unmap()
+{
+	if (!memory_)
+		return false;
+
+	munmap(memory_, mapped_size_);
+	memory_ = NULL;
+	mapped_size_ = 0;
+	return true;
+}
+
+SharedMemoryHandle SharedMemory::TakeHandle()
+{
+	SharedMemoryHandle handle = handle_;
+	handle_ = SharedMemoryHandle();
+	return handle;
+}
+
+void SharedMemory::Close()
+{
+	handle_.Close();
+}
+
+}  // namespace base
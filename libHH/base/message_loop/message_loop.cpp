@@ -307,6 +307,7 @@ bool MessageLoop::DoIdleWork()
 
 
 //MessageLoopForIO methods
+#if defined(OS_WIN)
 void MessageLoopForIO::RegisterIOHandler(HANDLE file, IOHandler* handler)
 {
     return ToPumpIO(pump_.get())->RegisterIOHandler(file, handler);
@@ -321,6 +322,13 @@ bool MessageLoopForIO::WaitForIOCompletion(DWORD timeout, IOHandler* filter)
 {
     return ToPumpIO(pump_.get())->WaitForIOCompletion(timeout, filter);
 }
+#elif defined(OS_LINUX)
+bool MessageLoopForIO::WatchFileDescriptor(int fd, bool persistent, int mode,
+                                           FileDescriptorWatcher* controller, Watcher* watcher)
+{
+    return ToPumpIO(pump_.get())->WatchFileDescriptor(fd, persistent, mode, controller, watcher);
+}
+#endif
 
 
 }
@@ -4,13 +4,18 @@
 #include <memory>
 
 #include "base/base_export.h"
+#include "build/build_config.h"
 #include "base/pending_task.h"
 #include "base/memory/ref_counted.h"
 #include "base/threading/thread_task_runner_handle.h"
 #include "base/message_loop/message_pump.h"
 #include "base/message_loop/incoming_task_queue.h"
 #include "base/message_loop/message_loop_task_runner.h"
+#if defined(OS_WIN)
 #include "base/message_loop/message_pump_win.h"
+#elif defined(OS_LINUX)
+#include "base/message_loop/message_pump_epoll.h"
+#endif
 
 namespace base{
 
@@ -221,6 +226,7 @@ public:
         return loop && loop->type() == MessageLoop::TYPE_IO;
     }
 
+#if defined(OS_WIN)
     typedef MessagePumpForIO::IOHandler IOHandler;
     typedef MessagePumpForIO::IOContext IOContext;
 
@@ -228,6 +234,21 @@ public:
     void RegisterIOHandler(HANDLE file, IOHandler* handler);
     bool RegisterJobObject(HANDLE job, IOHandler* handler);
     bool WaitForIOCompletion(DWORD timeout, IOHandler* filter);
+#elif defined(OS_LINUX)
+    typedef MessagePumpEpoll::Watcher Watcher;
+    typedef MessagePumpEpoll::FileDescriptorWatcher FileDescriptorWatcher;
+
+    enum Mode
+    {
+        WATCH_READ = MessagePumpEpoll::WATCH_READ,
+        WATCH_WRITE = MessagePumpEpoll::WATCH_WRITE,
+        WATCH_READ_WRITE = MessagePumpEpoll::WATCH_READ_WRITE
+    };
+
+    // Please see MessagePumpEpoll for the definition of this method.
+    bool WatchFileDescriptor(int fd, bool persistent, int mode,
+                             FileDescriptorWatcher* controller, Watcher* watcher);
+#endif
 
 };
 
@@ -0,0 +1,284 @@
+#include "base/message_loop/message_pump_epoll.h"
+
+#include <errno.h>
+#include <stdint.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+namespace base {
+
+namespace {
+
+uint32_t EpollEvents(int mode)
+{
+	uint32_t events = 0;
+	if (mode & MessagePumpEpoll::WATCH_READ)
+		events |= EPOLLIN;
+	if (mode & MessagePumpEpoll::WATCH_WRITE)
+		events |= EPOLLOUT;
+	return events;
+}
+
+}  // namespace
+
+
+MessagePumpEpoll::FileDescriptorWatcher::FileDescriptorWatcher()
+	: fd_(-1),
+	  watcher_(NULL),
+	  pump_(NULL),
+	  mode_(0),
+	  oneshot_mode_(0)
+{
+
+}
+
+MessagePumpEpoll::FileDescriptorWatcher::~FileDescriptorWatcher()
+{
+	StopWatchingFileDescriptor();
+}
+
+bool MessagePumpEpoll::FileDescriptorWatcher::StopWatchingFileDescriptor()
+{
+	if (!pump_)
+		return true;
+
+	MessagePumpEpoll* pump = pump_;
+	int old_mode = mode_;
+	mode_ = 0;
+	oneshot_mode_ = 0;
+	bool ok = pump->UpdateWatch(this, old_mode);
+	pump->ForgetController(this);
+
+	fd_ = -1;
+	watcher_ = NULL;
+	pump_ = NULL;
+	return ok;
+}
+
+
+MessagePumpEpoll::MessagePumpEpoll()
+	: epoll_fd_(epoll_create1(EPOLL_CLOEXEC)),
+	  wakeup_fd_(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)),
+	  keep_running_(true),
+	  delayed_work_time_(0),
+	  events_(NULL),
+	  num_events_(0)
+{
+	// The wakeup event is the one with no controller.
+	epoll_event event = {};
+	event.events = EPOLLIN;
+	event.data.ptr = NULL;
+	epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, wakeup_fd_, &event);
+}
+
+MessagePumpEpoll::~MessagePumpEpoll()
+{
+	close(wakeup_fd_);
+	close(epoll_fd_);
+}
+
+bool MessagePumpEpoll::WatchFileDescriptor(int fd, bool persistent, int mode,
+										   FileDescriptorWatcher* controller, Watcher* watcher)
+{
+	if (fd < 0 || !(mode & WATCH_READ_WRITE) || !watcher)
+		return false;
+
+	int old_mode = 0;
+	if (controller->pump_ == this && controller->fd_ == fd)
+	{
+		old_mode = controller->mode_;
+	}
+	else
+	{
+		controller->StopWatchingFileDescriptor();
+		controller->fd_ = fd;
+		controller->pump_ = this;
+	}
+
+	controller->watcher_ = watcher;
+	controller->mode_ |= mode;
+	if (persistent)
+		controller->oneshot_mode_ &= ~mode;
+	else
+		controller->oneshot_mode_ |= mode;
+
+	if (!UpdateWatch(controller, old_mode))
+	{
+		controller->mode_ = 0;
+		controller->StopWatchingFileDescriptor();
+		return false;
+	}
+	return true;
+}
+
+void MessagePumpEpoll::Run(Delegate* delegate)
+{
+	for (;;)
+	{
+		bool did_work = delegate->DoWork();
+		if (!keep_running_)
+			break;
+
+		// Ready descriptors are served between tasks, a busy task queue does
+		// not starve them.
+		did_work |= WaitForEvents(0);
+		if (!keep_running_)
+			break;
+
+		did_work |= delegate->DoDelayedWork(&delayed_work_time_);
+		if (!keep_running_)
+			break;
+
+		if (did_work)
+			continue;
+
+		did_work = delegate->DoIdleWork();
+		if (!keep_running_)
+			break;
+
+		if (did_work)
+			continue;
+
+		int timeout_ms = -1;
+		if (delayed_work_time_ != 0)
+		{
+			TimeDelta delay = delayed_work_time_ - TimeTicksNow;
+			if (delay <= 0)
+			{
+				// The delayed task is due, run it right away.
+				delayed_work_time_ = 0;
+				continue;
+			}
+			timeout_ms = delay < INT32_MAX ? static_cast<int>(delay) : INT32_MAX;
+		}
+		WaitForEvents(timeout_ms);
+	}
+
+	keep_running_ = true;
+}
+
+void MessagePumpEpoll::Quit()
+{
+	keep_running_ = false;
+}
+
+void MessagePumpEpoll::ScheduleWork()
+{
+	uint64_t one = 1;
+	ssize_t rv;
+	do
+	{
+		rv = write(wakeup_fd_, &one, sizeof(one));
+	} while (rv < 0 && errno == EINTR);
+}
+
+void MessagePumpEpoll::ScheduleDelayedWork(const TimeTicks& delayed_work_time)
+{
+	delayed_work_time_ = delayed_work_time;
+}
+
+bool MessagePumpEpoll::UpdateWatch(FileDescriptorWatcher* controller, int old_mode)
+{
+	epoll_event event = {};
+	event.events = EpollEvents(controller->mode_);
+	event.data.ptr = controller;
+
+	int op;
+	if (!old_mode)
+		op = EPOLL_CTL_ADD;
+	else if (!controller->mode_)
+		op = EPOLL_CTL_DEL;
+	else if (EpollEvents(old_mode) != event.events)
+		op = EPOLL_CTL_MOD;
+	else
+		return true;
+
+	// The descriptor may be closed already, the kernel then dropped it.
+	return epoll_ctl(epoll_fd_, op, controller->fd_, &event) == 0 ||
+		   (op == EPOLL_CTL_DEL && (errno == EBADF || errno == ENOENT));
+}
+
+void MessagePumpEpoll::ForgetController(FileDescriptorWatcher* controller)
+{
+	for (int i = 0; i < num_events_; ++i)
+	{
+		if (events_[i].data.ptr == controller)
+			events_[i].events = 0;
+	}
+}
+
+bool MessagePumpEpoll::WaitForEvents(int timeout_ms)
+{
+	epoll_event events[kMaxEvents];
+	int count;
+	do
+	{
+		count = epoll_wait(epoll_fd_, events, kMaxEvents, timeout_ms);
+	} while (count < 0 && errno == EINTR);
+	if (count <= 0)
+		return false;
+
+	// A watcher may destroy any controller, ForgetController() then clears
+	// its remaining events in |events_|.
+	epoll_event* outer_events = events_;
+	int outer_num_events = num_events_;
+	events_ = events;
+	num_events_ = count;
+
+	bool did_work = false;
+	for (int i = 0; i < count; ++i)
+	{
+		FileDescriptorWatcher* controller = static_cast<FileDescriptorWatcher*>(events[i].data.ptr);
+		if (!controller)
+		{
+			uint64_t value;
+			while (read(wakeup_fd_, &value, sizeof(value)) < 0 && errno == EINTR)
+				;
+			continue;
+		}
+
+		// Errors and hang ups go to whichever side is watched, its next read
+		// or write reports them.
+		uint32_t ready = events[i].events;
+		if (ready & (EPOLLERR | EPOLLHUP))
+			ready |= EpollEvents(controller->mode_);
+
+		int fd = controller->fd_;
+		if ((ready & EPOLLIN) && (controller->mode_ & WATCH_READ))
+		{
+			if (controller->oneshot_mode_ & WATCH_READ)
+			{
+				int old_mode = controller->mode_;
+				controller->mode_ &= ~WATCH_READ;
+				controller->oneshot_mode_ &= ~WATCH_READ;
+				UpdateWatch(controller, old_mode);
+			}
+			did_work = true;
+			controller->watcher_->OnFileCanReadWithoutBlocking(fd);
+		}
+
+		// The read callback may have destroyed the controller.
+		if (!events[i].events)
+			continue;
+
+		if ((ready & EPOLLOUT) && (controller->mode_ & WATCH_WRITE))
+		{
+			if (controller->oneshot_mode_ & WATCH_WRITE)
+			{
+				int old_mode = controller->mode_;
+				controller->mode_ &= ~WATCH_WRITE;
+				controller->oneshot_mode_ &= ~WATCH_WRITE;
+				UpdateWatch(controller, old_mode);
+			}
+			did_work = true;
+			controller->watcher_->OnFileCanWriteWithoutBlocking(fd);
+		}
+	}
+
+	events_ = outer_events;
+	num_events_ = outer_num_events;
+	return did_work;
+}
+
+}
@@ -0,0 +1,115 @@
+#ifndef MESSAGE_PUMP_EPOLL_H__
+#define MESSAGE_PUMP_EPOLL_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "base/base_export.h"
+#include "base/macros.h"
+#include "base/message_loop/message_pump.h"
+#include "base/time2.h"
+
+struct epoll_event;
+
+namespace base {
+
+// The TYPE_IO pump on Linux. Tasks and file descriptor readiness are both
+// waited for in one epoll_wait(), ScheduleWork() wakes it through an eventfd.
+// Descriptors are level triggered, a watcher that does not drain its socket
+// is called again on the next turn of the loop.
+class BASE_EXPORT MessagePumpEpoll : public MessagePump
+{
+public:
+	// Called on the thread of the pump when a watched descriptor is ready.
+	class Watcher
+	{
+	public:
+		virtual void OnFileCanReadWithoutBlocking(int fd) = 0;
+		virtual void OnFileCanWriteWithoutBlocking(int fd) = 0;
+
+	protected:
+		virtual ~Watcher() {}
+	};
+
+	enum Mode
+	{
+		WATCH_READ = 1 << 0,
+		WATCH_WRITE = 1 << 1,
+		WATCH_READ_WRITE = WATCH_READ | WATCH_WRITE
+	};
+
+	// Watch of one descriptor, given to WatchFileDescriptor(). Destroying it
+	// stops the watch, also from inside a Watcher callback.
+	class BASE_EXPORT FileDescriptorWatcher
+	{
+	public:
+		FileDescriptorWatcher();
+		~FileDescriptorWatcher();
+
+		bool StopWatchingFileDescriptor();
+
+	private:
+		friend class MessagePumpEpoll;
+
+		int fd_;
+		Watcher* watcher_;
+		MessagePumpEpoll* pump_;
+
+		// Watched modes, and the ones of them that end after one event.
+		int mode_;
+		int oneshot_mode_;
+
+		DISALLOW_COPY_AND_ASSIGN(FileDescriptorWatcher);
+	};
+
+	MessagePumpEpoll();
+	~MessagePumpEpoll() override;
+
+	// Calls |watcher| when |fd| can be read or written without blocking, as
+	// |mode| says. A watch that is not |persistent| ends after the first
+	// event. Watching again with the same |controller| adds |mode| to the
+	// watched ones. A controller watches one descriptor at a time and a
+	// descriptor is watched through one controller.
+	bool WatchFileDescriptor(int fd, bool persistent, int mode,
+							 FileDescriptorWatcher* controller, Watcher* watcher);
+
+	// MessagePump methods:
+	void Run(Delegate* delegate) override;
+	void Quit() override;
+	void ScheduleWork() override;
+	void ScheduleDelayedWork(const TimeTicks& delayed_work_time) override;
+
+private:
+	enum { kMaxEvents = 32 };
+
+	// Updates the epoll registration of |controller| to its mode.
+	bool UpdateWatch(FileDescriptorWatcher* controller, int old_mode);
+
+	// Drops the events not yet dispatched for |controller|, it is going away.
+	void ForgetController(FileDescriptorWatcher* controller);
+
+	// Waits up to |timeout_ms| (-1 forever) and calls the watchers of the
+	// ready descriptors. Returns true if a watcher was called.
+	bool WaitForEvents(int timeout_ms);
+
+	int epoll_fd_;
+	int wakeup_fd_;
+
+	// This flag is set to false when Run should return.
+	bool keep_running_;
+
+	// The time at which we should call DoDelayedWork.
+	TimeTicks delayed_work_time_;
+
+	// Events of the epoll_wait() being dispatched.
+	epoll_event* events_;
+	int num_events_;
+
+	DISALLOW_COPY_AND_ASSIGN(MessagePumpEpoll);
+};
+
+typedef MessagePumpEpoll MessagePumpForIO;
+
+}
+
+#endif // MESSAGE_PUMP_EPOLL_H__
@@ -43,7 +43,7 @@ bool PendingTask::operator<(const PendingTask& other) const
 }
 
 void TaskQueue::Swap(TaskQueue* queue) {
-	c.swap(queue->c);  // Calls std::deque::swap.
+	c.swap(queue->c);  // Calls circular_deque::swap.
 }
 
 }
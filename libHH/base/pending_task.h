@@ -5,6 +5,7 @@
 #include <queue>
 
 #include "base/base_export.h"
+#include "base/containers/circular_deque.h"
 #include "base/callback.h"
 #include "base/time2.h"
 
@@ -31,8 +32,9 @@ struct BASE_EXPORT PendingTask
 };
 
 // Wrapper around std::queue specialized for PendingTask which adds a Swap
-// helper method.
-class BASE_EXPORT TaskQueue : public std::queue<PendingTask> 
+// helper method. The circular_deque keeps its buffer when the queue is
+// drained, so a busy loop does not allocate for every few tasks.
+class BASE_EXPORT TaskQueue : public std::queue<PendingTask, circular_deque<PendingTask> > 
 {
 public:
 	void Swap(TaskQueue* queue);
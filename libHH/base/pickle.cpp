@@ -1,6 +1,9 @@
 #include "base/pickle.h"
 
+#include <string.h>
+
 #include "base/bits.h"
+#include "base/memory/buffer_pool.h"
 
 namespace base {
 
@@ -31,6 +34,11 @@ inline bool PickleIterator::ReadBuiltinType(Type* result)
 	return true;
 }
 
+void PickleIterator::AlignReadIndex()
+{
+	read_index_ = std::min(bits::Align(read_index_, sizeof(uint32_t)), end_index_);
+}
+
 void PickleIterator::Advance(size_t size)
 {
 	size_t aligned_size = bits::Align(size, sizeof(uint32_t));
@@ -43,6 +51,7 @@ void PickleIterator::Advance(size_t size)
 template<typename Type>
 const char* PickleIterator::GetReadPointerAndAdvance()
 {
+	AlignReadIndex();
 	if (sizeof(Type) > end_index_ - read_index_)
 	{
 		read_index_ = end_index_;
@@ -55,6 +64,7 @@ const char* PickleIterator::GetReadPointerAndAdvance()
 
 const char* PickleIterator::GetReadPointerAndAdvance(int num_bytes)
 {
+	AlignReadIndex();
 	if (num_bytes < 0 || end_index_ - read_index_ < static_cast<size_t>(num_bytes))
 	{
 		read_index_ = end_index_;
@@ -164,11 +174,76 @@ bool PickleIterator::ReadString16(std::wstring* result)
 	if (!ReadInt(&len))
 		return false;
 
-	const char* read_from = GetReadPointerAndAdvance(len, sizeof(wchar_t));
+	return ReadUTF16(len, result);
+}
+
+bool PickleIterator::ReadStringPiece(StringPiece* result)
+{
+	int len;
+	if (!ReadInt(&len))
+		return false;
+
+	const char* read_from = GetReadPointerAndAdvance(len);
+	if (!read_from)
+		return false;
+
+	*result = StringPiece(read_from, len);
+	return true;
+}
+
+#if defined(WCHAR_T_IS_UTF16)
+bool PickleIterator::ReadStringPiece16(StringPiece16* result)
+{
+	int len;
+	if (!ReadInt(&len))
+		return false;
+
+	const char* read_from = GetReadPointerAndAdvance(len, sizeof(char16));
+	if (!read_from)
+		return false;
+
+	*result = StringPiece16(reinterpret_cast<const char16*>(read_from), len);
+	return true;
+}
+#endif
+
+bool PickleIterator::ReadUTF16(int length, std::wstring* result)
+{
+	const char* read_from = GetReadPointerAndAdvance(length, sizeof(char16));
 	if (!read_from)
 		return false;
 
-	result->assign(reinterpret_cast<const wchar_t*>(read_from), len);
+	const char16* units = reinterpret_cast<const char16*>(read_from);
+#if defined(WCHAR_T_IS_UTF16)
+	result->assign(units, length);
+#else
+	// A string never has more characters than units.
+	result->resize(length);
+	if (!length)
+		return true;
+
+	wchar_t* out = &(*result)[0];
+	for (int i = 0; i < length; ++i)
+	{
+		uint32_t unit = units[i];
+		if (LIKELY(unit - 0xD800 >= 0x800))
+		{
+			*out++ = static_cast<wchar_t>(unit);
+		}
+		else if (unit < 0xDC00 && i + 1 < length &&
+				 static_cast<uint32_t>(units[i + 1]) - 0xDC00 < 0x400)
+		{
+			*out++ = static_cast<wchar_t>(0x10000 + ((unit - 0xD800) << 10) + (units[i + 1] - 0xDC00));
+			++i;
+		}
+		else
+		{
+			// Unpaired surrogate.
+			*out++ = 0xFFFD;
+		}
+	}
+	result->resize(out - result->data());
+#endif
 	return true;
 }
 
@@ -193,6 +268,114 @@ bool PickleIterator::ReadBytes(const char** data, int length)
 	return true;
 }
 
+bool PickleIterator::ReadVarInt32(int32_t* result)
+{
+	uint32_t value;
+	if (!ReadVarUInt32(&value))
+		return false;
+	*result = Pickle::ZigZagDecode32(value);
+	return true;
+}
+
+bool PickleIterator::ReadVarUInt32(uint32_t* result)
+{
+	uint64_t value;
+	if (!ReadVarUInt64(&value) || value > 0xffffffffu)
+		return false;
+	*result = static_cast<uint32_t>(value);
+	return true;
+}
+
+bool PickleIterator::ReadVarInt64(int64_t* result)
+{
+	uint64_t value;
+	if (!ReadVarUInt64(&value))
+		return false;
+	*result = Pickle::ZigZagDecode64(value);
+	return true;
+}
+
+bool PickleIterator::ReadVarUInt64(uint64_t* result)
+{
+	const uint8_t* read_from = reinterpret_cast<const uint8_t*>(payload_) + read_index_;
+	size_t available = end_index_ - read_index_;
+
+	// Values below 128 take one byte, they are the common case.
+	if (LIKELY(available != 0) && read_from[0] < 0x80)
+	{
+		*result = read_from[0];
+		++read_index_;
+		return true;
+	}
+
+#if defined(ARCH_CPU_LITTLE_ENDIAN)
+	// Varints of up to 8 bytes are decoded from one 64 bit load. The lowest
+	// byte without the continuation bit ends the varint, the 7 bit groups are
+	// then packed together pairwise in three steps instead of one shift per
+	// byte.
+	if (available >= sizeof(uint64_t))
+	{
+		uint64_t word;
+		memcpy(&word, read_from, sizeof(word));
+		uint64_t stops = ~word & 0x8080808080808080ull;
+		if (stops)
+		{
+			int length = bits::CountTrailingZeroBits64(stops) / 8 + 1;
+			if (length < 8)
+				word &= (1ull << (length * 8)) - 1;
+			word &= 0x7f7f7f7f7f7f7f7full;
+			word = ((word & 0x7f007f007f007f00ull) >> 1) | (word & 0x007f007f007f007full);
+			word = ((word & 0x3fff00003fff0000ull) >> 2) | (word & 0x00003fff00003fffull);
+			word = ((word & 0x0fffffff00000000ull) >> 4) | (word & 0x000000000fffffffull);
+			*result = word;
+			read_index_ += length;
+			return true;
+		}
+	}
+#endif
+
+	return ReadVarUInt64Slow(result);
+}
+
+bool PickleIterator::ReadVarUInt64Slow(uint64_t* result)
+{
+	// A 64 bit value takes at most 10 bytes, the last one holds the top bit.
+	const size_t kMaxVarIntBytes = 10;
+
+	const uint8_t* read_from = reinterpret_cast<const uint8_t*>(payload_) + read_index_;
+	size_t available = std::min(end_index_ - read_index_, kMaxVarIntBytes);
+	uint64_t value = 0;
+	for (size_t i = 0; i < available; ++i)
+	{
+		uint8_t byte = read_from[i];
+		value |= static_cast<uint64_t>(byte & 0x7f) << (7 * i);
+		if (byte & 0x80)
+			continue;
+
+		if (i == kMaxVarIntBytes - 1 && byte > 1)
+			break;
+		*result = value;
+		read_index_ += i + 1;
+		return true;
+	}
+
+	read_index_ = end_index_;
+	return false;
+}
+
+bool PickleIterator::ReadPackedBytes(const char** data, int length)
+{
+	if (length < 0 || end_index_ - read_index_ < static_cast<size_t>(length))
+	{
+		read_index_ = end_index_;
+		return false;
+	}
+
+	*data = payload_ + read_index_;
+	read_index_ += length;
+	return true;
+}
+
 
 
 
@@ -245,10 +428,18 @@ Pickle::Pickle(const Pickle& other)
 	memcpy(header_, other.header_, header_size_ + other.header_->payload_size);
 }
 
+Pickle::Pickle(Pickle&& other)
+	: header_(nullptr),
+	header_size_(other.header_size_),
+	capacity_after_header_(0),
+	write_offset_(other.write_offset_)
+{
+	MoveFrom(&other);
+}
+
 Pickle::~Pickle()
 {
-	if (capacity_after_header_ != kCapacityReadOnly)
-		free(header_);
+	FreeBuffer();
 }
 
 Pickle& Pickle::operator=(const Pickle& other)
@@ -264,8 +455,9 @@ Pickle& Pickle::operator=(const Pickle& other)
 	}
 	if (header_size_ != other.header_size_)
 	{
-		free(header_);
+		FreeBuffer();
 		header_ = nullptr;
+		capacity_after_header_ = 0;
 		header_size_ = other.header_size_;
 	}
 	Resize(other.header_->payload_size);
@@ -274,11 +466,77 @@ Pickle& Pickle::operator=(const Pickle& other)
 	return *this;
 }
 
+Pickle& Pickle::operator=(Pickle&& other)
+{
+	if (this == &other)
+		return *this;
+
+	FreeBuffer();
+	header_ = nullptr;
+	header_size_ = other.header_size_;
+	write_offset_ = other.write_offset_;
+	MoveFrom(&other);
+	return *this;
+}
+
 void Pickle::Resize(size_t new_capacity)
 {
-	capacity_after_header_ = bits::Align(new_capacity, kPayloadUnit);
-	void* p = realloc(header_, GetTotalAllocatedSize());
+	// A pickle stays inline as long as it fits, once on the heap it stays
+	// there.
+	if ((!header_ || is_inline()) && header_size_ + new_capacity <= sizeof(inline_buffer_))
+	{
+		header_ = reinterpret_cast<Header*>(inline_buffer_);
+		capacity_after_header_ = sizeof(inline_buffer_) - header_size_;
+		return;
+	}
+
+	// Heap buffers come from the pool, rounded up to its size classes.
+	BufferPool* pool = BufferPool::GetInstance();
+	size_t capacity = 0;
+	void* p;
+	if (is_inline())
+	{
+		p = pool->Allocate(header_size_ + bits::Align(new_capacity, kPayloadUnit), &capacity);
+		memcpy(p, header_, header_size_ + write_offset_);
+	}
+	else
+	{
+		size_t old_capacity = header_ ? GetTotalAllocatedSize() : 0;
+		p = pool->Reallocate(header_, old_capacity, header_size_ + write_offset_,
+							 header_size_ + bits::Align(new_capacity, kPayloadUnit), &capacity);
+	}
 	header_ = reinterpret_cast<Header*>(p);
+	capacity_after_header_ = capacity - header_size_;
+}
+
+void Pickle::FreeBuffer()
+{
+	if (capacity_after_header_ != kCapacityReadOnly && !is_inline())
+		BufferPool::GetInstance()->Free(header_, GetTotalAllocatedSize());
+}
+
+void Pickle::MoveFrom(Pickle* other)
+{
+	if (other->is_inline())
+	{
+		header_ = reinterpret_cast<Header*>(inline_buffer_);
+		memcpy(header_, other->header_, header_size_ + other->header_->payload_size);
+	}
+	else
+	{
+		// Heap buffers and read only views change hands as is.
+		header_ = other->header_;
+	}
+	capacity_after_header_ = other->capacity_after_header_;
+
+	other->header_ = nullptr;
+	other->capacity_after_header_ = 0;
+	other->write_offset_ = 0;
+	if (other->header_size_ <= sizeof(other->inline_buffer_))
+	{
+		other->Resize(0);
+		memset(other->header_, 0, other->header_size_);
+	}
 }
 
 void* Pickle::ClaimBytes(size_t num_bytes)
@@ -338,10 +596,69 @@ bool Pickle::WriteString(const std::string& value)
 }
 
 bool Pickle::WriteString16(const std::wstring& value)
+{
+	if (!WriteInt(static_cast<int>(UTF16Length(value.data(), value.size()))))
+		return false;
+	return WriteUTF16(value.data(), value.size());
+}
+
+bool Pickle::WriteStringPiece(const StringPiece& value)
 {
 	if (!WriteInt(static_cast<int>(value.size())))
 		return false;
-	return WriteBytes(value.data(), static_cast<int>(value.size()) * sizeof(wchar_t));
+	return WriteBytes(value.data(), static_cast<int>(value.size()));
+}
+
+#if defined(WCHAR_T_IS_UTF16)
+bool Pickle::WriteStringPiece16(const StringPiece16& value)
+{
+	if (!WriteInt(static_cast<int>(value.size())))
+		return false;
+	return WriteBytes(value.data(), static_cast<int>(value.size()) * sizeof(char16));
+}
+#endif
+
+bool Pickle::WriteUTF16(const wchar_t* data, size_t length)
+{
+#if defined(WCHAR_T_IS_UTF16)
+	return WriteBytes(data, static_cast<int>(length * sizeof(char16)));
+#else
+	size_t num_units = UTF16Length(data, length);
+	char16* out = static_cast<char16*>(ClaimUninitializedBytesInternal(num_units * sizeof(char16)));
+	for (size_t i = 0; i < length; ++i)
+	{
+		uint32_t c = static_cast<uint32_t>(data[i]);
+		if (LIKELY(c < 0xD800 || (c >= 0xE000 && c < 0x10000)))
+		{
+			*out++ = static_cast<char16>(c);
+		}
+		else if (c - 0x10000 < 0x100000)
+		{
+			c -= 0x10000;
+			*out++ = static_cast<char16>(0xD800 + (c >> 10));
+			*out++ = static_cast<char16>(0xDC00 + (c & 0x3FF));
+		}
+		else
+		{
+			*out++ = 0xFFFD;
+		}
+	}
+	return true;
+#endif
+}
+
+// static
+size_t Pickle::UTF16Length(const wchar_t* data, size_t length)
+{
+#if defined(WCHAR_T_IS_UTF16)
+	return length;
+#else
+	// Code points above the BMP take a surrogate pair.
+	size_t num_units = length;
+	for (size_t i = 0; i < length; ++i)
+		num_units += static_cast<uint32_t>(data[i]) - 0x10000 < 0x100000;
+	return num_units;
+#endif
 }
 
 bool Pickle::WriteData(const char* data, int length)
@@ -355,12 +672,44 @@ bool Pickle::WriteBytes(const void* data, int length)
 	return true;
 }
 
+bool Pickle::WriteVarUInt64(uint64_t value)
+{
+	if (value < 0x80)
+	{
+		*static_cast<uint8_t*>(ClaimPackedBytesInternal(1)) = static_cast<uint8_t>(value);
+		return true;
+	}
+
+	uint8_t bytes[10];
+	size_t length = 0;
+	while (value >= 0x80)
+	{
+		bytes[length++] = static_cast<uint8_t>(value) | 0x80;
+		value >>= 7;
+	}
+	bytes[length++] = static_cast<uint8_t>(value);
+	memcpy(ClaimPackedBytesInternal(length), bytes, length);
+	return true;
+}
+
+bool Pickle::WritePackedBytes(const void* data, int length)
+{
+	if (length < 0)
+		return false;
+	void* write = ClaimPackedBytesInternal(length);
+	if (length)
+		memcpy(write, data, length);
+	return true;
+}
+
 void Pickle::Reserve(size_t additional_capacity)
 {
 	size_t data_len = bits::Align(additional_capacity, sizeof(uint32_t));
-	size_t new_size = write_offset_ + data_len;
+	size_t new_size = bits::Align(write_offset_, sizeof(uint32_t)) + data_len;
+	// The caller knows the size, grow to just that. The pool rounds it up to
+	// its size class anyway.
 	if (new_size > capacity_after_header_)
-		Resize(capacity_after_header_ * 2 + new_size);
+		Resize(new_size);
 }
 
 //ַ֧ģʽ
@@ -375,9 +724,12 @@ void Pickle::Reserve(size_t additional_capacity)
 
 void* Pickle::ClaimUninitializedBytesInternal(size_t num_bytes)
 {
+	// Packed writes may have left the offset unaligned, the padding up to the
+	// boundary is already zeroed.
+	size_t write_offset = bits::Align(write_offset_, sizeof(uint32_t));
 	size_t data_len = bits::Align(num_bytes, sizeof(uint32_t));
-	size_t new_size = write_offset_ + data_len;
-	if (new_size > capacity_after_header_)
+	size_t new_size = write_offset + data_len;
+	if (UNLIKELY(new_size > capacity_after_header_))
 	{
 		size_t new_capacity = capacity_after_header_ * 2;
 		const size_t kPickleHeapAlign = 4096;
@@ -386,7 +738,7 @@ void* Pickle::ClaimUninitializedBytesInternal(size_t num_bytes)
 		Resize(std::max(new_capacity, new_size));
 	}
 
-	char* write = mutable_payload() + write_offset_;
+	char* write = mutable_payload() + write_offset;
     // ڳʼֽڶʱʵʶֽ
 	memset(write + num_bytes, 0, data_len - num_bytes);
 	header_->payload_size = static_cast<uint32_t>(new_size);
@@ -394,6 +746,20 @@ void* Pickle::ClaimUninitializedBytesInternal(size_t num_bytes)
 	return write;
 }
 
+void* Pickle::ClaimPackedBytesInternal(size_t num_bytes)
+{
+	size_t end_offset = write_offset_ + num_bytes;
+	size_t new_size = bits::Align(end_offset, sizeof(uint32_t));
+	if (UNLIKELY(new_size > capacity_after_header_))
+		Resize(std::max(capacity_after_header_ * 2, new_size));
+
+	char* write = mutable_payload() + write_offset_;
+	memset(mutable_payload() + end_offset, 0, new_size - end_offset);
+	header_->payload_size = static_cast<uint32_t>(new_size);
+	write_offset_ = end_offset;
+	return write;
+}
+
 void Pickle::WriteBytesCommon(const void* data, size_t length)
 {
 	void* write = ClaimUninitializedBytesInternal(length);
@@ -3,9 +3,19 @@
 
 #include <stdint.h>
 #include <string>
+#include <type_traits>
 
 #include "base/base_export.h"
 #include "base/compiler_specific.h"
+#include "base/containers/span.h"
+#include "base/strings/string_piece.h"
+#include "build/build_config.h"
+
+// Bytes (header included) stored inside the Pickle object itself. Pickles
+// that fit are never allocated on the heap.
+#ifndef PICKLE_INLINE_CAPACITY
+#define PICKLE_INLINE_CAPACITY 256
+#endif
 
 namespace base {
 
@@ -30,6 +40,36 @@ public:
 	bool ReadString(std::string* result);
 	bool ReadString16(std::wstring* result);
 
+	// Like ReadString() and ReadString16() but |result| points into the
+	// payload instead of holding a copy, it is valid as long as the pickle.
+	bool ReadStringPiece(StringPiece* result);
+#if defined(WCHAR_T_IS_UTF16)
+	bool ReadStringPiece16(StringPiece16* result);
+#endif
+
+	// Reads |length| UTF-16 units written by Pickle::WriteUTF16() into
+	// |result|, transcoding where wchar_t is UTF-32. The capacity of |result|
+	// is reused.
+	bool ReadUTF16(int length, std::wstring* result);
+
+	// Reads an element count followed by the elements, as written by
+	// Pickle::WriteSpan(), without copying them.
+	template <typename T>
+	bool ReadSpan(span<const T>* result) {
+		static_assert(std::is_trivially_copyable<T>::value, "ReadSpan needs a trivially copyable type");
+		static_assert(ALIGNOF(T) <= sizeof(uint32_t), "the payload is only 4 byte aligned");
+		int count;
+		if (!ReadLength(&count))
+			return false;
+
+		const char* read_from = GetReadPointerAndAdvance(count, sizeof(T));
+		if (!read_from)
+			return false;
+
+		*result = span<const T>(reinterpret_cast<const T*>(read_from), count);
+		return true;
+	}
+
 	// ִȿֵָֻ룬ϢЧ
 	bool ReadData(const char** data, int* length);
 
@@ -41,6 +81,17 @@ public:
 		return ReadInt(result) && *result >= 0;
 	}
 
+	// Reads the compact encoding written by Pickle::WriteVarInt32() and
+	// friends. Values that do not fit |result| fail the read.
+	bool ReadVarInt32(int32_t* result);
+	bool ReadVarUInt32(uint32_t* result);
+	bool ReadVarInt64(int64_t* result);
+	bool ReadVarUInt64(uint64_t* result);
+
+	// Like ReadBytes() for bytes written by Pickle::WritePackedBytes(). They
+	// are not aligned.
+	bool ReadPackedBytes(const char** data, int length);
+
 	// Skips bytes in the read buffer and returns true if there are at least
 	// num_bytes available. Otherwise, does nothing and returns false.
 	bool SkipBytes(int num_bytes) {
@@ -54,6 +105,12 @@ private:
 	//ƶȡָ룬ܳend_index_
 	void Advance(size_t size);
 
+	// Moves |read_index_| to the next 4 byte boundary, packed reads may have
+	// left it anywhere.
+	void AlignReadIndex();
+
+	bool ReadVarUInt64Slow(uint64_t* result);
+
 	// ȡǰȡָ룬ƶ´ζȡλ
 	template<typename Type>
 	const char* GetReadPointerAndAdvance();
@@ -81,9 +138,14 @@ public:
 
 	Pickle(const Pickle& other);
 
+	// Takes the buffer of |other|, which is left empty. Only the bytes in use
+	// are copied when |other| is stored inline.
+	Pickle(Pickle&& other);
+
 	virtual ~Pickle();
 
 	Pickle& operator=(const Pickle& other);
+	Pickle& operator=(Pickle&& other);
 
 	// ذܴСͷ
 	size_t size() const { return header_size_ + header_->payload_size; }
@@ -109,6 +171,30 @@ public:
 	}
 	bool WriteString(const std::string& value);
 	bool WriteString16(const std::wstring& value);
+
+	// Same wire format as WriteString() and WriteString16(), without the
+	// temporary string.
+	bool WriteStringPiece(const StringPiece& value);
+#if defined(WCHAR_T_IS_UTF16)
+	bool WriteStringPiece16(const StringPiece16& value);
+#endif
+
+	// Wide strings go on the wire as UTF-16 whatever the size of wchar_t, a
+	// Windows process and a Linux one read each other and Linux does not send
+	// 4 bytes per character. Where wchar_t is UTF-32 the characters are
+	// transcoded on the way, values that are no code point become U+FFFD.
+	// WriteUTF16() writes the units without a length, padded like
+	// WriteBytes(), and UTF16Length() counts them.
+	bool WriteUTF16(const wchar_t* data, size_t length);
+	static size_t UTF16Length(const wchar_t* data, size_t length);
+
+	// Writes the element count followed by the raw elements.
+	template <typename T>
+	bool WriteSpan(span<const T> value) {
+		static_assert(std::is_trivially_copyable<T>::value, "WriteSpan needs a trivially copyable type");
+		return WriteInt(static_cast<int>(value.size())) &&
+			WriteBytes(value.data(), static_cast<int>(value.size_bytes()));
+	}
 	// "Data" is a blob with a length. When you read it out you will be given the
 	// length. See also WriteBytes.
 	bool WriteData(const char* data, int length);
@@ -117,6 +203,34 @@ public:
 	// known size. See also WriteData.
 	bool WriteBytes(const void* data, int length);
 
+	// Compact encoding. Integers are written as LEB128 varints, 7 bits per
+	// byte with the high bit set on all but the last one. Signed values are
+	// zigzag encoded first so that small negative numbers stay short. Packed
+	// bytes are a blob like WriteBytes() but without padding. These writes
+	// start right where the previous one ended, all other writes still start
+	// on a 4 byte boundary and the payload size stays a multiple of 4.
+	//
+	// The reader has to know which encoding was used, IPC::Message tells it
+	// with a header flag.
+	bool WriteVarInt32(int32_t value) { return WriteVarUInt64(ZigZagEncode32(value)); }
+	bool WriteVarUInt32(uint32_t value) { return WriteVarUInt64(value); }
+	bool WriteVarInt64(int64_t value) { return WriteVarUInt64(ZigZagEncode64(value)); }
+	bool WriteVarUInt64(uint64_t value);
+	bool WritePackedBytes(const void* data, int length);
+
+	static uint32_t ZigZagEncode32(int32_t value) {
+		return (static_cast<uint32_t>(value) << 1) ^ static_cast<uint32_t>(value >> 31);
+	}
+	static int32_t ZigZagDecode32(uint32_t value) {
+		return static_cast<int32_t>((value >> 1) ^ (0u - (value & 1)));
+	}
+	static uint64_t ZigZagEncode64(int64_t value) {
+		return (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63);
+	}
+	static int64_t ZigZagDecode64(uint64_t value) {
+		return static_cast<int64_t>((value >> 1) ^ (0ull - (value & 1)));
+	}
+
 	// Reserves space for upcoming writes when multiple writes will be made and
 	// their sizes are computed in advance. It can be significantly faster to call
 	// Reserve() before calling WriteFoo() multiple times.
@@ -216,8 +330,26 @@ private:
 		return true;
 	}
 
+	bool is_inline() const {
+		return header_ == reinterpret_cast<const Header*>(inline_buffer_);
+	}
+
+	// Releases |header_| if it was allocated on the heap.
+	void FreeBuffer();
+
+	// Takes the buffer of |other| and leaves it empty, |header_size_| and
+	// |write_offset_| must already be copied.
+	void MoveFrom(Pickle* other);
+
+	// Used while the pickle fits in PICKLE_INLINE_CAPACITY bytes.
+	uint64_t inline_buffer_[PICKLE_INLINE_CAPACITY / sizeof(uint64_t)];
+
 	inline void* ClaimUninitializedBytesInternal(size_t num_bytes);
-	inline void WriteBytesCommon(const void* data, size_t length);
+
+	// Like ClaimUninitializedBytesInternal() without aligning the start or
+	// the end of the claimed bytes.
+	void* ClaimPackedBytesInternal(size_t num_bytes);
+	void WriteBytesCommon(const void* data, size_t length);
 
 };
 
@@ -1,9 +1,12 @@
 #include "waitable_event.h"
 
+#include "base/time2.h"
+
 namespace base {
 
 
 WaitableEvent::WaitableEvent()
+	: signaled_(false)
 {
 
 }
@@ -17,24 +20,63 @@ WaitableEvent::~WaitableEvent()
 bool WaitableEvent::Wait(unsigned long time /*= ULONG_MAX*/)
 {
 	mutex_.lock();
-	bool rt = wait_.wait(&mutex_, time);
+
+	// A wakeup without the signal set is spurious, the wait goes on for the
+	// time left.
+	bool forever = time == ULONG_MAX;
+	base::TimeTicks deadline = forever ? 0 : TimeTicksNow + static_cast<base::TimeTicks>(time);
+	while (!signaled_)
+	{
+		unsigned long left = time;
+		if (!forever)
+		{
+			base::TimeTicks now = TimeTicksNow;
+			if (now >= deadline)
+				break;
+			left = static_cast<unsigned long>(deadline - now);
+		}
+		wait_.wait(&mutex_, left);
+	}
+
+	bool signaled = signaled_;
+	signaled_ = false;
 	mutex_.unlock();
-	return rt;
+	return signaled;
 }
 
 void WaitableEvent::Wake()
 {
-	WakeOne();
+	Signal();
 }
 
-void WaitableEvent::WakeOne()
+void WaitableEvent::Signal()
 {
+	mutex_.lock();
+	signaled_ = true;
 	wait_.wakeOne();
+	mutex_.unlock();
+}
+
+bool WaitableEvent::IsSignaled()
+{
+	mutex_.lock();
+	bool signaled = signaled_;
+	mutex_.unlock();
+	return signaled;
+}
+
+void WaitableEvent::WakeOne()
+{
+	Signal();
 }
 
 void WaitableEvent::WakeAll()
 {
+	// One waiter takes the signal, the others wait on.
+	mutex_.lock();
+	signaled_ = true;
 	wait_.wakeAll();
+	mutex_.unlock();
 }
 
 }
\ No newline at end of file
@@ -16,17 +16,33 @@ public:
 	~WaitableEvent();
 
 public:
+	// Returns at once if the event was signaled since the last Wait(), the
+	// signal is consumed. Returns false on timeout, |time| is in
+	// milliseconds.
 	bool Wait(unsigned long time = ULONG_MAX);
 
+	// Same as Signal().
 	void Wake();
 
+	// Wakes one waiter. The signal is kept until the next Wait() if nobody
+	// is waiting yet, so it cannot be lost.
+	void Signal();
+
+	bool IsSignaled();
+
+	// Same as Signal().
 	void WakeOne();
+
+	// Wakes every waiter, the first to run takes the signal.
 	void WakeAll();
 
 private:
 	QWaitCondition wait_;
 	QMutex mutex_;
 
+	// Set by Signal() and WakeAll(), cleared by Wait().
+	bool signaled_;
+
 };
 
 }
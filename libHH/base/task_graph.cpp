@@ -0,0 +1,156 @@
+#include "base/task_graph.h"
+
+namespace base {
+
+TaskGraph::Node::Node(const Closure& task, const scoped_refptr<TaskRunner>& task_runner)
+	: task(task),
+	  task_runner(task_runner),
+	  num_dependencies(0),
+	  pending_dependencies(0)
+{
+
+}
+
+TaskGraph::Node::~Node()
+{
+
+}
+
+
+TaskGraph::TaskGraph()
+	: dirty_(true),
+	  pending_nodes_(0),
+	  running_(0)
+{
+
+}
+
+TaskGraph::~TaskGraph()
+{
+
+}
+
+TaskGraph::NodeId TaskGraph::AddNode(const Closure& task, const scoped_refptr<TaskRunner>& task_runner)
+{
+	if (IsRunning() || !task_runner)
+		return kInvalidNodeId;
+
+	nodes_.push_back(Node(task, task_runner));
+	dirty_ = true;
+	return static_cast<NodeId>(nodes_.size() - 1);
+}
+
+bool TaskGraph::AddDependency(NodeId node, NodeId depends_on)
+{
+	if (IsRunning())
+		return false;
+
+	int count = static_cast<int>(nodes_.size());
+	if (node < 0 || node >= count || depends_on < 0 || depends_on >= count || node == depends_on)
+		return false;
+
+	nodes_[depends_on].successors.push_back(node);
+	nodes_[node].num_dependencies++;
+	dirty_ = true;
+	return true;
+}
+
+bool TaskGraph::Run(const Closure& on_complete)
+{
+	if (nodes_.empty())
+		return false;
+
+	if (subtle::Acquire_CompareAndSwap(&running_, 0, 1) != 0)
+		return false;
+
+	if (dirty_ && !Validate())
+	{
+		subtle::Release_Store(&running_, 0);
+		return false;
+	}
+
+	on_complete_ = on_complete;
+
+	// All counters must be armed before the first root is posted, a root may
+	// finish before we get to the next one.
+	for (size_t i = 0; i < nodes_.size(); ++i)
+		subtle::NoBarrier_Store(&nodes_[i].pending_dependencies, nodes_[i].num_dependencies);
+	subtle::Release_Store(&pending_nodes_, static_cast<subtle::Atomic32>(nodes_.size()));
+
+	for (size_t i = 0; i < roots_.size(); ++i)
+		PostNode(roots_[i]);
+
+	return true;
+}
+
+bool TaskGraph::IsRunning() const
+{
+	return subtle::Acquire_Load(&running_) != 0;
+}
+
+bool TaskGraph::Validate()
+{
+	// Kahn's algorithm, every node must be reachable from a root.
+	std::vector<subtle::Atomic32> in_degree(nodes_.size());
+	roots_.clear();
+	for (size_t i = 0; i < nodes_.size(); ++i)
+	{
+		in_degree[i] = nodes_[i].num_dependencies;
+		if (in_degree[i] == 0)
+			roots_.push_back(static_cast<NodeId>(i));
+	}
+
+	std::vector<NodeId> ready(roots_);
+	size_t visited = 0;
+	while (!ready.empty())
+	{
+		NodeId id = ready.back();
+		ready.pop_back();
+		++visited;
+
+		const std::vector<NodeId>& successors = nodes_[id].successors;
+		for (size_t i = 0; i < successors.size(); ++i)
+		{
+			if (--in_degree[successors[i]] == 0)
+				ready.push_back(successors[i]);
+		}
+	}
+
+	if (visited != nodes_.size())
+		return false;
+
+	dirty_ = false;
+	return true;
+}
+
+void TaskGraph::PostNode(NodeId id)
+{
+	// The bound reference keeps the graph alive until the node has run.
+	Closure task(std::bind(&TaskGraph::RunNode, make_scoped_refptr(this), id));
+	nodes_[id].task_runner->PostTask(task);
+}
+
+void TaskGraph::RunNode(NodeId id)
+{
+	Node& node = nodes_[id];
+	node.task.Run();
+
+	for (size_t i = 0; i < node.successors.size(); ++i)
+	{
+		NodeId successor = node.successors[i];
+		if (subtle::Barrier_AtomicIncrement(&nodes_[successor].pending_dependencies, -1) == 0)
+			PostNode(successor);
+	}
+
+	if (subtle::Barrier_AtomicIncrement(&pending_nodes_, -1) != 0)
+		return;
+
+	// Last node of this run. Take the completion closure before clearing
+	// |running_|, |on_complete| may start the next run.
+	Closure on_complete = on_complete_;
+	subtle::Release_Store(&running_, 0);
+	if (!on_complete.is_null())
+		on_complete.Run();
+}
+
+}  // namespace base
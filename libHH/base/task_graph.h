@@ -0,0 +1,112 @@
+#ifndef TASK_GRAPH_H__
+#define TASK_GRAPH_H__
+
+#include <stdint.h>
+
+#include <vector>
+
+#include "base/atomicops.h"
+#include "base/base_export.h"
+#include "base/callback.h"
+#include "base/macros.h"
+#include "base/memory/ref_counted.h"
+#include "base/task_runner.h"
+
+namespace base {
+
+// TaskGraph runs a set of tasks whose ordering is described by a dependency
+// DAG. Every node is posted to its own TaskRunner as soon as all of its
+// predecessors have finished, so independent stages run concurrently instead
+// of being serialized by nested PostTask callbacks:
+//
+//   scoped_refptr<TaskGraph> graph = new TaskGraph();
+//   TaskGraph::NodeId decode   = graph->AddNode(decode_task, io_runner);
+//   TaskGraph::NodeId validate = graph->AddNode(validate_task, worker_runner);
+//   TaskGraph::NodeId stats    = graph->AddNode(stats_task, worker_runner);
+//   TaskGraph::NodeId publish  = graph->AddNode(publish_task, ui_runner);
+//   graph->AddDependency(validate, decode);
+//   graph->AddDependency(stats, decode);
+//   graph->AddDependency(publish, validate);
+//   graph->AddDependency(publish, stats);
+//   graph->Run(done_closure);
+//
+// Readiness is tracked with one atomic counter per node, no lock is taken
+// while the graph runs. The nodes are kept after a run, so Run() may be
+// called again once |on_complete| has fired without any reallocation.
+class BASE_EXPORT TaskGraph : public RefCountedThreadSafe<TaskGraph>
+{
+public:
+	typedef int NodeId;
+
+	enum { kInvalidNodeId = -1 };
+
+	TaskGraph();
+
+	// Adds a node running |task| on |task_runner|. Returns kInvalidNodeId if the
+	// graph is currently running.
+	NodeId AddNode(const Closure& task, const scoped_refptr<TaskRunner>& task_runner);
+
+	// |node| will not start before |depends_on| has finished. Returns false if
+	// either id is unknown or the graph is currently running.
+	bool AddDependency(NodeId node, NodeId depends_on);
+
+	// Starts a run of the graph. |on_complete| is run on the thread that
+	// finished the last node. Returns false if the graph is already running,
+	// is empty or contains a cycle.
+	bool Run(const Closure& on_complete);
+
+	// May be called from any thread.
+	bool IsRunning() const;
+
+	size_t node_count() const { return nodes_.size(); }
+
+private:
+	friend class RefCountedThreadSafe<TaskGraph>;
+	~TaskGraph();
+
+	struct Node
+	{
+		Node(const Closure& task, const scoped_refptr<TaskRunner>& task_runner);
+		~Node();
+
+		Closure task;
+		scoped_refptr<TaskRunner> task_runner;
+
+		// Nodes waiting on this one.
+		std::vector<NodeId> successors;
+
+		// Number of predecessors, fixed once the graph is built.
+		subtle::Atomic32 num_dependencies;
+
+		// Predecessors that have not finished yet in the current run.
+		volatile subtle::Atomic32 pending_dependencies;
+	};
+
+	// Checks that the nodes form a DAG and caches the roots.
+	bool Validate();
+
+	void PostNode(NodeId id);
+	void RunNode(NodeId id);
+
+	std::vector<Node> nodes_;
+
+	// Nodes without predecessors, recomputed by Validate().
+	std::vector<NodeId> roots_;
+
+	// True when nodes or edges changed since the last Validate().
+	bool dirty_;
+
+	// Nodes that have not finished yet in the current run.
+	volatile subtle::Atomic32 pending_nodes_;
+
+	// Non-zero while a run is in flight.
+	volatile subtle::Atomic32 running_;
+
+	Closure on_complete_;
+
+	DISALLOW_COPY_AND_ASSIGN(TaskGraph);
+};
+
+}  // namespace base
+
+#endif // TASK_GRAPH_H__
@@ -0,0 +1,19 @@
+#include "base/threading/scoped_blocking_call.h"
+
+#include "base/threading/worker_pool.h"
+
+namespace base {
+
+ScopedBlockingCall::ScopedBlockingCall(BlockingType type)
+	: pool_(WorkerPool::BlockingStarted(type == WILL_BLOCK))
+{
+
+}
+
+ScopedBlockingCall::~ScopedBlockingCall()
+{
+	if (pool_)
+		pool_->BlockingEnded();
+}
+
+}  // namespace base
@@ -0,0 +1,47 @@
+#ifndef SCOPED_BLOCKING_CALL_H__
+#define SCOPED_BLOCKING_CALL_H__
+
+#include "base/base_export.h"
+#include "base/macros.h"
+
+namespace base {
+
+class WorkerPool;
+
+// Annotates a scope that may block on I/O. When used on a WorkerPool worker
+// the worker stops counting against the pool's active limit for the lifetime
+// of the object, and the pool can start another worker to run the tasks that
+// are waiting. Nested calls only count once. Anywhere else this is a no-op.
+//
+//   void ReadConfig()
+//   {
+//       ScopedBlockingCall blocking(ScopedBlockingCall::WILL_BLOCK);
+//       file.read(...);
+//   }
+class BASE_EXPORT ScopedBlockingCall
+{
+public:
+	enum BlockingType
+	{
+		// The scope might block, e.g. reading a file that is probably cached.
+		// Capacity is only added when the next task is posted.
+		MAY_BLOCK,
+
+		// The scope will block, e.g. waiting on a socket. Capacity is added
+		// right away if tasks are waiting.
+		WILL_BLOCK,
+	};
+
+	explicit ScopedBlockingCall(BlockingType type);
+	~ScopedBlockingCall();
+
+private:
+	// Pool of the current worker, NULL when not running on a WorkerPool.
+	WorkerPool* pool_;
+
+	DISALLOW_COPY_AND_ASSIGN(ScopedBlockingCall);
+};
+
+}  // namespace base
+
+#endif // SCOPED_BLOCKING_CALL_H__
@@ -0,0 +1,321 @@
+#include "base/threading/worker_pool.h"
+
+#include <algorithm>
+
+#include <QThread>
+
+#include "base/lazy_instance.h"
+#include "base/threading/thread_local.h"
+
+namespace base {
+
+class WorkerPool::Worker : public QThread
+{
+public:
+	explicit Worker(WorkerPool* pool)
+		: pool(pool),
+		  blocking_depth(0)
+	{
+	}
+
+	WorkerPool* const pool;
+
+	// Nesting level of ScopedBlockingCall on this worker, only touched by
+	// the worker itself.
+	int blocking_depth;
+
+protected:
+	virtual void run() override
+	{
+		pool->RunWorker(this);
+	}
+};
+
+
+WorkerPool::Stats::Stats()
+	: num_workers(0),
+	  num_idle_workers(0),
+	  num_blocked_workers(0),
+	  peak_workers(0),
+	  num_pending_tasks(0),
+	  peak_pending_tasks(0),
+	  num_delayed_tasks(0),
+	  tasks_run(0),
+	  workers_added(0),
+	  workers_reclaimed(0),
+	  blocking_calls(0),
+	  saturated_time(0)
+{
+
+}
+
+
+WorkerPool::WorkerPool(const std::string& name, int max_active_workers, TimeDelta reclaim_time)
+	: name_(name),
+	  max_active_workers_(max_active_workers > 0 ? max_active_workers : std::max(QThread::idealThreadCount(), 1)),
+	  reclaim_time_(std::max<TimeDelta>(reclaim_time, 1)),
+	  accepting_tasks_(false),
+	  next_sequence_num_(0),
+	  num_idle_workers_(0),
+	  num_blocked_workers_(0),
+	  saturated_since_(0)
+{
+
+}
+
+WorkerPool::~WorkerPool()
+{
+	// The workers wait on |lock_| and |work_available_|, they must be gone
+	// before those are. Does nothing if Shutdown() was called already.
+	Shutdown();
+}
+
+void WorkerPool::Start()
+{
+	QMutexLocker locker(&lock_);
+	accepting_tasks_ = true;
+}
+
+void WorkerPool::Shutdown()
+{
+	std::vector<Worker*> workers;
+	{
+		QMutexLocker locker(&lock_);
+		accepting_tasks_ = false;
+		while (!delayed_queue_.empty())
+			delayed_queue_.pop();
+		work_available_.wakeAll();
+		workers = workers_;
+	}
+
+	// The workers drain |queue_| before exiting.
+	for (size_t i = 0; i < workers.size(); ++i)
+	{
+		workers[i]->wait();
+		delete workers[i];
+	}
+
+	{
+		QMutexLocker locker(&lock_);
+		workers_.clear();
+		UpdateSaturationLocked(TimeTicksNow);
+	}
+
+	JoinRetiredWorkers();
+}
+
+WorkerPool::Stats WorkerPool::GetStats() const
+{
+	QMutexLocker locker(&lock_);
+
+	Stats stats = stats_;
+	stats.num_workers = static_cast<int>(workers_.size());
+	stats.num_idle_workers = num_idle_workers_;
+	stats.num_blocked_workers = num_blocked_workers_;
+	stats.num_pending_tasks = queue_.size();
+	stats.num_delayed_tasks = delayed_queue_.size();
+	if (saturated_since_ != 0)
+		stats.saturated_time += TimeTicksNow - saturated_since_;
+	return stats;
+}
+
+bool WorkerPool::PostDelayedTask(const Closure& task, int64_t delay)
+{
+	JoinRetiredWorkers();
+
+	QMutexLocker locker(&lock_);
+	if (!accepting_tasks_)
+		return false;
+
+	TimeTicks now = TimeTicksNow;
+	if (delay > 0)
+	{
+		PendingTask pending_task(task, now + delay);
+		pending_task.sequence_num = next_sequence_num_++;
+		delayed_queue_.push(pending_task);
+	}
+	else
+	{
+		queue_.push(PendingTask(task));
+		stats_.peak_pending_tasks = std::max(stats_.peak_pending_tasks, queue_.size());
+	}
+
+	// An idle worker also needs the wake up for a delayed task, its wait may
+	// end after the new run time.
+	if (num_idle_workers_ > 0)
+		work_available_.wakeOne();
+	else
+		AdjustCapacityLocked();
+
+	UpdateSaturationLocked(now);
+	return true;
+}
+
+// static
+ThreadLocalPointer<WorkerPool::Worker>* WorkerPool::CurrentWorkerSlot()
+{
+	static LazyInstance<ThreadLocalPointer<Worker> >::Leaky lazy_tls_ptr = LAZY_INSTANCE_INITIALIZER;
+	return lazy_tls_ptr.Pointer();
+}
+
+bool WorkerPool::RunsTasksOnCurrentThread() const
+{
+	Worker* worker = CurrentWorkerSlot()->Get();
+	return worker && worker->pool == this;
+}
+
+void WorkerPool::RunWorker(Worker* worker)
+{
+	CurrentWorkerSlot()->Set(worker);
+
+	QMutexLocker locker(&lock_);
+	TimeTicks idle_since = TimeTicksNow;
+	for (;;)
+	{
+		TimeTicks now = TimeTicksNow;
+		ReloadWorkQueueLocked(now);
+
+		if (!queue_.empty())
+		{
+			PendingTask pending_task = queue_.front();
+			queue_.pop();
+			UpdateSaturationLocked(now);
+
+			locker.unlock();
+			pending_task.task.Run();
+			locker.relock();
+
+			++stats_.tasks_run;
+			idle_since = TimeTicksNow;
+			continue;
+		}
+
+		// Shutdown() lets the workers drain the queue first.
+		if (!accepting_tasks_)
+			break;
+
+		// Only the workers above the target are reclaimed, the others wait
+		// for work forever.
+		if (now - idle_since >= reclaim_time_ && ActiveWorkersLocked() > max_active_workers_)
+		{
+			workers_.erase(std::find(workers_.begin(), workers_.end(), worker));
+			retired_workers_.push_back(worker);
+			++stats_.workers_reclaimed;
+			break;
+		}
+
+		TimeDelta wait_time = reclaim_time_ - (now - idle_since);
+		if (wait_time <= 0)
+		{
+			idle_since = now;
+			wait_time = reclaim_time_;
+		}
+		if (!delayed_queue_.empty())
+			wait_time = std::min(wait_time, delayed_queue_.top().delayed_run_time - now);
+
+		++num_idle_workers_;
+		UpdateSaturationLocked(now);
+		work_available_.wait(&lock_, static_cast<unsigned long>(wait_time));
+		--num_idle_workers_;
+	}
+
+	locker.unlock();
+	CurrentWorkerSlot()->Set(NULL);
+}
+
+// static
+WorkerPool* WorkerPool::BlockingStarted(bool will_block)
+{
+	Worker* worker = CurrentWorkerSlot()->Get();
+	if (!worker)
+		return NULL;
+
+	if (worker->blocking_depth++ > 0)
+		return worker->pool;
+
+	WorkerPool* pool = worker->pool;
+	QMutexLocker locker(&pool->lock_);
+	++pool->num_blocked_workers_;
+	++pool->stats_.blocking_calls;
+	if (will_block)
+		pool->AdjustCapacityLocked();
+	pool->UpdateSaturationLocked(TimeTicksNow);
+	return pool;
+}
+
+void WorkerPool::BlockingEnded()
+{
+	Worker* worker = CurrentWorkerSlot()->Get();
+	if (--worker->blocking_depth > 0)
+		return;
+
+	// The extra workers started meanwhile are not stopped here, they exit
+	// after |reclaim_time_| without work.
+	QMutexLocker locker(&lock_);
+	--num_blocked_workers_;
+	UpdateSaturationLocked(TimeTicksNow);
+}
+
+void WorkerPool::AdjustCapacityLocked()
+{
+	if (!accepting_tasks_ || num_idle_workers_ > 0)
+		return;
+
+	if (queue_.empty() && delayed_queue_.empty())
+		return;
+
+	if (ActiveWorkersLocked() >= max_active_workers_)
+		return;
+
+	if (static_cast<int>(workers_.size()) >= max_active_workers_)
+		++stats_.workers_added;
+
+	Worker* worker = new Worker(this);
+	worker->setObjectName(QString::fromStdString(name_));
+	workers_.push_back(worker);
+	stats_.peak_workers = std::max(stats_.peak_workers, static_cast<int>(workers_.size()));
+	worker->start();
+}
+
+void WorkerPool::ReloadWorkQueueLocked(TimeTicks now)
+{
+	while (!delayed_queue_.empty() && delayed_queue_.top().delayed_run_time <= now)
+	{
+		queue_.push(delayed_queue_.top());
+		delayed_queue_.pop();
+	}
+}
+
+void WorkerPool::UpdateSaturationLocked(TimeTicks now)
+{
+	bool saturated = !queue_.empty() && num_idle_workers_ == 0 &&
+		ActiveWorkersLocked() >= max_active_workers_;
+
+	if (saturated && saturated_since_ == 0)
+	{
+		saturated_since_ = now;
+	}
+	else if (!saturated && saturated_since_ != 0)
+	{
+		stats_.saturated_time += now - saturated_since_;
+		saturated_since_ = 0;
+	}
+}
+
+void WorkerPool::JoinRetiredWorkers()
+{
+	std::vector<Worker*> retired;
+	{
+		QMutexLocker locker(&lock_);
+		retired.swap(retired_workers_);
+	}
+
+	// A retired worker only has to return from run() at this point.
+	for (size_t i = 0; i < retired.size(); ++i)
+	{
+		retired[i]->wait();
+		delete retired[i];
+	}
+}
+
+}  // namespace base
@@ -0,0 +1,160 @@
+#ifndef WORKER_POOL_H__
+#define WORKER_POOL_H__
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#include <QMutex>
+#include <QWaitCondition>
+
+#include "base/base_export.h"
+#include "base/macros.h"
+#include "base/pending_task.h"
+#include "base/task_runner.h"
+#include "base/time2.h"
+
+namespace base {
+
+class ScopedBlockingCall;
+template <typename Type> class ThreadLocalPointer;
+
+// WorkerPool runs tasks on a set of worker threads. The pool keeps at most
+// |max_active_workers| workers running tasks at the same time. A worker that
+// enters a ScopedBlockingCall no longer counts as active, so the pool may
+// start another worker to keep the CPU busy while the first one waits on a
+// file or a socket. Workers above the target that stay idle longer than
+// |reclaim_time| exit on their own.
+//
+//   scoped_refptr<WorkerPool> pool = new WorkerPool("Worker", 4, 30 * 1000);
+//   pool->Start();
+//   pool->PostTask(task);
+//   ...
+//   pool->Shutdown();
+class BASE_EXPORT WorkerPool : public TaskRunner
+{
+public:
+	// Snapshot of the pool state, used to size the pool per machine.
+	struct Stats
+	{
+		Stats();
+
+		// Workers currently alive, running or not.
+		int num_workers;
+
+		// Workers waiting for a task.
+		int num_idle_workers;
+
+		// Workers inside a ScopedBlockingCall.
+		int num_blocked_workers;
+
+		// Highest |num_workers| seen since Start().
+		int peak_workers;
+
+		// Tasks ready to run but not picked up by a worker yet.
+		size_t num_pending_tasks;
+
+		// Highest |num_pending_tasks| seen since Start().
+		size_t peak_pending_tasks;
+
+		// Delayed tasks not due yet.
+		size_t num_delayed_tasks;
+
+		int64_t tasks_run;
+
+		// Workers started because others were blocked, and workers that
+		// exited after |reclaim_time| of idleness.
+		int64_t workers_added;
+		int64_t workers_reclaimed;
+
+		int64_t blocking_calls;
+
+		// Total time, in ms, during which every active slot was busy while
+		// tasks were waiting.
+		TimeDelta saturated_time;
+	};
+
+	// |max_active_workers| <= 0 uses the number of cores of the machine.
+	WorkerPool(const std::string& name, int max_active_workers, TimeDelta reclaim_time);
+
+	// Starts accepting tasks. Workers are created on demand.
+	void Start();
+
+	// Stops accepting tasks, runs the tasks that are already queued and joins
+	// every worker. Pending delayed tasks are dropped. Must not be called from
+	// a worker of this pool. Called again by the destructor, the last
+	// reference must not be dropped on a worker either.
+	void Shutdown();
+
+	Stats GetStats() const;
+
+	const std::string& name() const { return name_; }
+
+	// TaskRunner implementation.
+	virtual bool PostDelayedTask(const Closure& task, int64_t delay) override;
+	virtual bool RunsTasksOnCurrentThread() const override;
+
+private:
+	friend class ScopedBlockingCall;
+
+	class Worker;
+
+	virtual ~WorkerPool();
+
+	// Worker of the calling thread, NULL if it is not a pool worker.
+	static ThreadLocalPointer<Worker>* CurrentWorkerSlot();
+
+	// Main function of every worker thread.
+	void RunWorker(Worker* worker);
+
+	// Called by ScopedBlockingCall. BlockingStarted() returns the pool of the
+	// calling worker, or NULL if the calling thread is not a pool worker.
+	static WorkerPool* BlockingStarted(bool will_block);
+	void BlockingEnded();
+
+	// Starts a new worker if tasks are waiting and fewer than
+	// |max_active_workers_| workers are able to run them. |lock_| must be held.
+	void AdjustCapacityLocked();
+
+	// Moves the delayed tasks that are due to |queue_|. |lock_| must be held.
+	void ReloadWorkQueueLocked(TimeTicks now);
+
+	// Starts or stops the saturation clock. |lock_| must be held.
+	void UpdateSaturationLocked(TimeTicks now);
+
+	// Joins the workers that have exited.
+	void JoinRetiredWorkers();
+
+	int ActiveWorkersLocked() const { return static_cast<int>(workers_.size()) - num_blocked_workers_; }
+
+	const std::string name_;
+	const int max_active_workers_;
+	const TimeDelta reclaim_time_;
+
+	mutable QMutex lock_;
+	QWaitCondition work_available_;
+
+	bool accepting_tasks_;
+
+	TaskQueue queue_;
+	DelayedTaskQueue delayed_queue_;
+	int next_sequence_num_;
+
+	std::vector<Worker*> workers_;
+	std::vector<Worker*> retired_workers_;
+
+	int num_idle_workers_;
+	int num_blocked_workers_;
+
+	// Saturation clock, 0 when the pool is not saturated.
+	TimeTicks saturated_since_;
+
+	Stats stats_;
+
+	DISALLOW_COPY_AND_ASSIGN(WorkerPool);
+};
+
+}  // namespace base
+
+#endif // WORKER_POOL_H__
@@ -9,7 +9,7 @@ namespace content {
 RenderProcessHost::RenderProcessHost(const IPC::ChannelHandle& channel_handle,
     const scoped_refptr<base::SingleThreadTaskRunner>& ipc_task_runner)
 {
-	channel_ = IPC::ChannelProxy::Create(channel_handle, IPC::Channel::MODE_SERVER, this, ipc_task_runner);
+	channel_ = IPC::ChannelProxy::Create(channel_handle, IPC::Channel::MODE_SHARED_MEMORY_SERVER, this, ipc_task_runner);
 }
 
 RenderProcessHost::~RenderProcessHost()
@@ -1,5 +1,10 @@
 #include "ipc/ipc_channel.h"
 
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+
 
 namespace IPC {
 
@@ -13,15 +18,99 @@ std::unique_ptr<Channel> Channel::CreateClient(const ChannelHandle& channel_hand
 	return Channel::Create(channel_handle, Channel::MODE_CLIENT, listener);
 }
 
+bool Channel::SendBatch(std::vector<Message*>* messages)
+{
+	bool success = true;
+	for (size_t i = 0; i < messages->size(); ++i)
+	{
+		if (success)
+			success = Send((*messages)[i]);
+		else
+			delete (*messages)[i];
+	}
+	messages->clear();
+	return success;
+}
+
 
 Channel::OutputElement::OutputElement(Message* message)
-    : message_(message), buffer_(nullptr), length_(0) {}
+    : message_(message), buffer_(nullptr), size_(0),
+      high_priority_(message->is_high_priority()) {
+    message_->GetSegments(&segments_);
+    for (size_t i = 0; i < segments_.size(); ++i)
+        size_ += segments_[i].size;
+}
+
+Channel::OutputElement::OutputElement(const std::shared_ptr<Message>& message)
+    : message_(message), buffer_(nullptr), size_(0),
+      high_priority_(message->is_high_priority()) {
+    message_->GetSegments(&segments_);
+    for (size_t i = 0; i < segments_.size(); ++i)
+        size_ += segments_[i].size;
+}
 
 Channel::OutputElement::OutputElement(void* buffer, size_t length)
-    : message_(nullptr), buffer_(buffer), length_(length) {}
+    : message_(nullptr), buffer_(buffer), size_(length), high_priority_(false) {
+    Message::Segment segment = { buffer, length };
+    segments_.push_back(segment);
+}
+
+Channel::OutputElement::OutputElement(const std::shared_ptr<OutputElement>& whole,
+                                      size_t offset, size_t length)
+    : message_(nullptr), buffer_(nullptr), size_(0),
+      high_priority_(whole->high_priority_), whole_(whole) {
+    Message chunk(MSG_ROUTING_NONE, CHUNK_MESSAGE_TYPE);
+    if (high_priority_)
+        chunk.set_high_priority();
+    chunk.header()->payload_size = static_cast<uint32_t>(length);
+
+    buffer_ = malloc(sizeof(Message::Header));
+    memcpy(buffer_, chunk.header(), sizeof(Message::Header));
+    Message::Segment header = { buffer_, sizeof(Message::Header) };
+    segments_.push_back(header);
+    size_ = sizeof(Message::Header) + length;
+
+    // The segments of |whole| that overlap the chunk, cut to fit.
+    const std::vector<Message::Segment>& segments = whole->segments();
+    size_t start = 0;
+    for (size_t i = 0; i < segments.size() && length; ++i) {
+        size_t end = start + segments[i].size;
+        if (end > offset) {
+            size_t skip = offset - start;
+            size_t count = std::min(segments[i].size - skip, length);
+            Message::Segment segment = { static_cast<const char*>(segments[i].data) + skip, count };
+            segments_.push_back(segment);
+            offset += count;
+            length -= count;
+        }
+        start = end;
+    }
+}
 
 Channel::OutputElement::~OutputElement() {
     free(buffer_);
+}
+
+// static
+void Channel::OutputElement::Split(OutputElement* element,
+                                   base::circular_deque<OutputElement*>* queue) {
+    bool has_descriptors = false;
+#if defined(OS_POSIX)
+    Message* message = element->get_message();
+    has_descriptors = message && message->HasFileDescriptors();
+#endif
+    if (element->size() <= kMaximumChunkSize || has_descriptors) {
+        queue->push_back(element);
+        return;
+    }
+
+    std::shared_ptr<OutputElement> whole(element);
+    for (size_t offset = 0; offset < whole->size(); offset += kMaximumChunkSize) {
+        size_t length = whole->size() - offset;
+        if (length > kMaximumChunkSize)
+            length = kMaximumChunkSize;
+        queue->push_back(new OutputElement(whole, offset, length));
+    }
 }
 
 
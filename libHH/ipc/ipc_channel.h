@@ -4,7 +4,9 @@
 #include <stdint.h>
 
 #include <memory>
+#include <vector>
 
+#include "base/containers/circular_deque.h"
 #include "ipc/ipc_sender.h"
 #include "ipc/ipc_message.h"
 
@@ -33,6 +35,13 @@ public:
 		MODE_NONE   = 0x0,
 		MODE_SERVER = 0x1,
 		MODE_CLIENT = 0x2,
+
+		// Same-host peers exchange messages through rings in shared memory,
+		// see ChannelPosix. Both ends of the channel pass it, it is ignored
+		// where the channel has no shared memory transport.
+		MODE_SHARED_MEMORY_FLAG = 0x4,
+		MODE_SHARED_MEMORY_SERVER = MODE_SERVER | MODE_SHARED_MEMORY_FLAG,
+		MODE_SHARED_MEMORY_CLIENT = MODE_CLIENT | MODE_SHARED_MEMORY_FLAG,
 	};
 
 	enum 
@@ -43,7 +52,17 @@ public:
 		// and type (HELLO_MESSAGE_TYPE).
 		HELLO_MESSAGE_TYPE = UINT16_MAX,
 
-        CLOSE_MESSAGE_TYPE = HELLO_MESSAGE_TYPE - 1
+        CLOSE_MESSAGE_TYPE = HELLO_MESSAGE_TYPE - 1,
+
+        // Grants the peer credit for more messages, see
+        // internal::FlowControl. It contains the bytes and the number of
+        // messages the receiver took since its last one.
+        CREDIT_MESSAGE_TYPE = HELLO_MESSAGE_TYPE - 2,
+
+        // A piece of a message bigger than kMaximumChunkSize, the payload
+        // holds its next bytes. Pieces of messages of the other priority may
+        // come between them, the flags tell the priority.
+        CHUNK_MESSAGE_TYPE = HELLO_MESSAGE_TYPE - 3
     };
 
 
@@ -59,6 +78,15 @@ public:
     // value because it fits 99.9% of all messages (see issue 529940 for data).
     static const size_t kMaximumReadBufferSize = 64 * 1024;
 
+    // What a peer may send before the receiver grants more credit. Messages
+    // beyond it wait in the sending channel, see Listener::OnSendBufferFull().
+    static const size_t kReceiveWindowBytes = 1024 * 1024;
+    static const size_t kReceiveWindowMessages = 1024;
+
+    // Messages bigger than this are sent in chunks, a high priority message
+    // waits for the chunk being written at most.
+    static const size_t kMaximumChunkSize = 64 * 1024;
+
 
     static std::unique_ptr<Channel> Create(const ChannelHandle& channel_handle, Mode mode, Listener* listener);
 
@@ -75,6 +103,11 @@ public:
     // deleted once the contents of the Message have been sent.
     virtual bool Send(Message* msg) = 0;
 
+    // Sends |messages| in order like Send(), taking them all, even on
+    // failure. A channel that gathers writes writes them together, in as
+    // few system calls as it can. Clears |messages|.
+    virtual bool SendBatch(std::vector<Message*>* messages);
+
     virtual base::ProcessId GetPeerPID() const = 0;
     virtual base::ProcessId GetSelfPID() const = 0;
 
@@ -90,18 +123,38 @@ protected:
     public:
         // Takes ownership of message.
         OutputElement(Message* message);
+        // Shares |message| with the elements of other channels, a message
+        // sent to several peers is serialized once.
+        explicit OutputElement(const std::shared_ptr<Message>& message);
         // Takes ownership of the buffer. |buffer| is freed via free(), so it
         // must be malloced.
         OutputElement(void* buffer, size_t length);
         ~OutputElement();
-        size_t size() const { return message_ ? message_->size() : length_; }
-        const void* data() const { return message_ ? message_->data() : buffer_; }
+        // Bytes on the wire, external data of the message included.
+        size_t size() const { return size_; }
+        // The bytes to write in order, see Message::GetSegments().
+        const std::vector<Message::Segment>& segments() const { return segments_; }
         Message* get_message() const { return message_.get(); }
+        bool is_high_priority() const { return high_priority_; }
+
+        // Appends |element| to |queue|, split into CHUNK_MESSAGE_TYPE
+        // messages if it is bigger than kMaximumChunkSize. A message with
+        // descriptors stays whole, they arrive along with its first byte.
+        // Takes ownership of |element|.
+        static void Split(OutputElement* element, base::circular_deque<OutputElement*>* queue);
 
     private:
-        std::unique_ptr<Message> message_;
+        // |length| bytes of |whole| from |offset| on, behind a chunk header.
+        OutputElement(const std::shared_ptr<OutputElement>& whole, size_t offset, size_t length);
+
+        std::shared_ptr<Message> message_;
         void* buffer_;
-        size_t length_;
+        std::vector<Message::Segment> segments_;
+        size_t size_;
+        bool high_priority_;
+
+        // The element a chunk is cut from.
+        std::shared_ptr<OutputElement> whole_;
     };
 
 };
@@ -0,0 +1,1241 @@
+#include "ipc/ipc_channel_posix.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stddef.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <utility>
+
+#include "base/pickle.h"
+#include "ipc/ipc_listener.h"
+#include "ipc/ipc_message_attachment_set.h"
+#include "ipc/ipc_message_utils.h"
+
+
+namespace IPC {
+
+namespace {
+
+bool MakeSocketAddress(const std::string& socket_name, sockaddr_un* address)
+{
+    if (socket_name.empty() || socket_name.size() >= sizeof(address->sun_path))
+        return false;
+
+    memset(address, 0, sizeof(*address));
+    address->sun_family = AF_UNIX;
+    memcpy(address->sun_path, socket_name.c_str(), socket_name.size());
+    return true;
+}
+
+bool SetNonBlocking(int fd)
+{
+    int flags = fcntl(fd, F_GETFL);
+    return flags != -1 && fcntl(fd, F_SETFL, flags | O_NONBLOCK) != -1;
+}
+
+void CloseDescriptor(int* fd)
+{
+    if (*fd != -1)
+    {
+        close(*fd);
+        *fd = -1;
+    }
+}
+
+}  // namespace
+
+
+ChannelPosix::ChannelPosix(const IPC::ChannelHandle& channel_handle, Mode mode,
+                           Listener* listener)
+    : ChannelReader(listener),
+      pipe_(-1),
+      peer_pid_(base::kNullProcessId),
+      output_segment_(0),
+      output_offset_(0),
+      output_fds_sent_(0),
+      is_blocked_on_write_(false),
+      connect_pending_(false),
+      holding_writes_(false),
+      waiting_connect_((mode & MODE_SHARED_MEMORY_FLAG) != 0),
+      use_shared_memory_((mode & MODE_SHARED_MEMORY_FLAG) != 0),
+      shared_memory_(NULL),
+      shared_memory_size_(0),
+      peer_closed_(false)
+{
+    CreatePipe(channel_handle, mode);
+}
+
+ChannelPosix::ChannelPosix(base::ScopedFD fd, Mode mode, Listener* listener)
+    : ChannelReader(listener),
+      pipe_(fd.release()),
+      peer_pid_(base::kNullProcessId),
+      output_segment_(0),
+      output_offset_(0),
+      output_fds_sent_(0),
+      is_blocked_on_write_(false),
+      connect_pending_(false),
+      holding_writes_(false),
+      waiting_connect_(false),
+      use_shared_memory_((mode & MODE_SHARED_MEMORY_FLAG) != 0),
+      shared_memory_(NULL),
+      shared_memory_size_(0),
+      peer_closed_(false)
+{
+    // The rings go ahead of any other byte, Connect() fails without them.
+    if ((use_shared_memory_ && !CreateSharedMemory()) || !QueueHelloMessage())
+        CloseDescriptor(&pipe_);
+}
+
+ChannelPosix::~ChannelPosix()
+{
+    Close();
+}
+
+void ChannelPosix::Close()
+{
+    pipe_watcher_.StopWatchingFileDescriptor();
+    is_blocked_on_write_ = false;
+    connect_pending_ = false;
+
+    CloseDescriptor(&pipe_);
+
+    if (shared_memory_)
+    {
+        munmap(shared_memory_, shared_memory_size_);
+        shared_memory_ = NULL;
+        shared_memory_size_ = 0;
+    }
+    peer_closed_ = false;
+
+    while (!output_queue_.empty())
+    {
+        OutputElement* element = output_queue_.front();
+        output_queue_.pop_front();
+        delete element;
+    }
+    output_segment_ = 0;
+    output_offset_ = 0;
+    output_fds_sent_ = 0;
+
+    for (size_t i = 0; i < 2; ++i)
+    {
+        while (!priority_queues_[i].empty())
+        {
+            delete priority_queues_[i].front();
+            priority_queues_[i].pop_front();
+        }
+        while (!blocked_queues_[i].empty())
+        {
+            delete blocked_queues_[i].front();
+            blocked_queues_[i].pop_front();
+        }
+    }
+
+    input_fds_.clear();
+
+    while (!prelim_queue_.empty())
+    {
+        delete prelim_queue_.front();
+        prelim_queue_.pop();
+    }
+}
+
+bool ChannelPosix::Send(Message* message)
+{
+    if (!prelim_queue_.empty())
+    {
+        prelim_queue_.push(message);
+        return true;
+    }
+
+    if (peer_pid_ == base::kNullProcessId)
+    {
+        prelim_queue_.push(message);
+        return true;
+    }
+
+    return ProcessMessageForDelivery(new OutputElement(message));
+}
+
+bool ChannelPosix::SendShared(const std::shared_ptr<Message>& message)
+{
+    // Waiting for the hello message it needs a copy of its own.
+    if (!prelim_queue_.empty() || peer_pid_ == base::kNullProcessId)
+        return Send(new Message(*message));
+
+    return ProcessMessageForDelivery(new OutputElement(message));
+}
+
+bool ChannelPosix::SendBatch(std::vector<Message*>* messages)
+{
+    // Queued first, the writes then gather as many messages as they can.
+    holding_writes_ = true;
+    bool success = Channel::SendBatch(messages);
+    holding_writes_ = false;
+    if (!success)
+        return false;
+
+    if (waiting_connect_ || is_blocked_on_write_ || peer_pid_ == base::kNullProcessId)
+        return true;
+    return ProcessOutgoingMessages();
+}
+
+bool ChannelPosix::ProcessMessageForDelivery(OutputElement* element)
+{
+    bool takes_credit = internal::FlowControl::TakesCredit(*element->get_message());
+    bool high_priority = element->is_high_priority();
+
+    // Messages of a priority keep their order, the ones after a message
+    // without credit wait as well.
+    if (takes_credit &&
+        (!blocked_queues_[high_priority].empty() || !flow_control()->TakeCredit(element->size())))
+    {
+        bool was_blocked = !blocked_queues_[0].empty() || !blocked_queues_[1].empty();
+        blocked_queues_[high_priority].push_back(element);
+        if (!was_blocked)
+            listener()->OnSendBufferFull(peer_pid_);
+        return true;
+    }
+
+    OutputElement::Split(element, &priority_queues_[high_priority]);
+
+    // A blocked socket is written again from OnFileCanWriteWithoutBlocking(),
+    // the message leaves with the ones queued before it.
+    if (!waiting_connect_ && !is_blocked_on_write_ && !holding_writes_)
+    {
+        if (!ProcessOutgoingMessages())
+            return false;
+    }
+
+    return true;
+}
+
+void ChannelPosix::FlushPrelimQueue()
+{
+    std::queue<Message*, base::circular_deque<Message*> > prelim_queue;
+    prelim_queue_.swap(prelim_queue);
+
+    while (!prelim_queue.empty())
+    {
+        Message* m = prelim_queue.front();
+        bool success = ProcessMessageForDelivery(new OutputElement(m));
+        prelim_queue.pop();
+
+        if (!success)
+            break;
+    }
+
+    // Delete any unprocessed messages.
+    while (!prelim_queue.empty())
+    {
+        Message* m = prelim_queue.front();
+        delete m;
+        prelim_queue.pop();
+    }
+}
+
+
+base::ProcessId ChannelPosix::GetPeerPID() const
+{
+    return peer_pid_;
+}
+
+base::ProcessId ChannelPosix::GetSelfPID() const
+{
+    return getpid();
+}
+
+// static
+bool ChannelPosix::IsNamedServerInitialized(const std::string& channel_id)
+{
+    struct stat info;
+    return stat(SocketName(channel_id).c_str(), &info) == 0 && S_ISSOCK(info.st_mode);
+}
+
+ChannelPosix::ReadState ChannelPosix::ReadData(char* buffer,
+                                               int buffer_len,
+                                               int* bytes_read)
+{
+    if (pipe_ == -1)
+        return READ_FAILED;
+
+    if (use_shared_memory_)
+    {
+        size_t size = receive_ring_.Read(buffer, buffer_len);
+        if (!size)
+        {
+            if (receive_ring_.PrepareToWaitForData())
+                return READ_PENDING;
+
+            // Data came in meanwhile, a ring that still gives none is corrupt.
+            size = receive_ring_.Read(buffer, buffer_len);
+            if (!size)
+                return READ_FAILED;
+        }
+
+        if (receive_ring_.TakeSpaceWaiter())
+            RingDoorbell();
+
+        *bytes_read = static_cast<int>(size);
+        return READ_SUCCEEDED;
+    }
+
+    ssize_t rv = ReceiveWithDescriptors(buffer, buffer_len);
+    if (rv < 0)
+        return errno == EAGAIN || errno == EWOULDBLOCK ? READ_PENDING : READ_FAILED;
+
+    // The peer closed the socket.
+    if (rv == 0)
+        return READ_FAILED;
+
+    *bytes_read = static_cast<int>(rv);
+    return READ_SUCCEEDED;
+}
+
+
+bool ChannelPosix::GetAttachments(Message* msg)
+{
+    size_t num_fds = msg->header()->num_fds;
+    if (!num_fds)
+        return true;
+
+    // Through the rings the message may be ahead of the doorbell that
+    // carries its descriptors, they are in the socket already.
+    if (input_fds_.size() < num_fds && use_shared_memory_)
+    {
+        if (!DrainDoorbell())
+            return false;
+    }
+
+    if (input_fds_.size() < num_fds)
+        return false;
+
+    for (size_t i = 0; i < num_fds; ++i)
+    {
+        msg->attachment_set()->AddDescriptor(std::move(input_fds_.front()));
+        input_fds_.pop_front();
+    }
+    return true;
+}
+
+void ChannelPosix::HandleInternalMessage(const Message& msg)
+{
+    // The hello message contains one parameter containing the PID.
+    base::PickleIterator it(msg);
+    int32_t claimed_pid;
+    bool failed = !it.ReadInt(&claimed_pid);
+    if (failed)
+    {
+        ClosePipeOnError();
+        return;
+    }
+
+    peer_pid_ = claimed_pid;
+
+    listener()->OnChannelConnected(claimed_pid);
+
+    FlushPrelimQueue();
+}
+
+base::ProcessId ChannelPosix::GetSenderPID()
+{
+    return GetPeerPID();
+}
+
+bool ChannelPosix::SendCreditMessage(Message* msg)
+{
+    output_queue_.push_back(new OutputElement(msg));
+    if (waiting_connect_ || is_blocked_on_write_)
+        return true;
+    return ProcessOutgoingMessages();
+}
+
+bool ChannelPosix::OnSendCreditAdded()
+{
+    if (blocked_queues_[0].empty() && blocked_queues_[1].empty())
+        return true;
+
+    for (int high_priority = 1; high_priority >= 0; --high_priority)
+    {
+        base::circular_deque<OutputElement*>& blocked = blocked_queues_[high_priority];
+        while (!blocked.empty() && flow_control()->TakeCredit(blocked.front()->size()))
+        {
+            OutputElement::Split(blocked.front(), &priority_queues_[high_priority]);
+            blocked.pop_front();
+        }
+    }
+
+    if (!waiting_connect_ && !is_blocked_on_write_ && !ProcessOutgoingMessages())
+        return false;
+
+    if (blocked_queues_[0].empty() && blocked_queues_[1].empty())
+        listener()->OnSendBufferDrained(peer_pid_);
+    return true;
+}
+
+bool ChannelPosix::FillOutputQueue()
+{
+    size_t bytes = 0;
+    for (size_t i = 0; i < output_queue_.size(); ++i)
+        bytes += output_queue_[i]->size();
+
+    while (bytes < kMaximumChunkSize)
+    {
+        base::circular_deque<OutputElement*>* queue = &priority_queues_[1];
+        if (queue->empty())
+            queue = &priority_queues_[0];
+        if (queue->empty())
+            break;
+
+        bytes += queue->front()->size();
+        output_queue_.push_back(queue->front());
+        queue->pop_front();
+    }
+    return !output_queue_.empty();
+}
+
+// static
+const std::string ChannelPosix::SocketName(const std::string& channel_id)
+{
+    if (!channel_id.empty() && channel_id[0] == '/')
+        return channel_id;
+
+    std::string name("/tmp/libHH.");
+    name.append(channel_id);
+    return name;
+}
+
+bool ChannelPosix::CreatePipe(const IPC::ChannelHandle &channel_handle, Mode mode)
+{
+    // A server is a ChannelPosixServer.
+    if (!(mode & MODE_CLIENT))
+        return false;
+
+    sockaddr_un address;
+    if (!MakeSocketAddress(SocketName(channel_handle), &address))
+        return false;
+
+    // Non-blocking before the connect, the constructor never waits on the
+    // server.
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd == -1)
+        return false;
+    if (!SetNonBlocking(fd))
+    {
+        close(fd);
+        return false;
+    }
+
+    int rv;
+    do
+    {
+        rv = connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address));
+    } while (rv != 0 && errno == EINTR);
+
+    // An AF_UNIX connect completes at once, or fails with EAGAIN when the
+    // server has too many clients pending. EINPROGRESS is finished once the
+    // socket is writable, see Connect().
+    if (rv != 0 && errno != EINPROGRESS)
+    {
+        close(fd);
+        return false;
+    }
+    pipe_ = fd;
+    connect_pending_ = rv != 0;
+
+    if (!QueueHelloMessage())
+    {
+        Close();
+        return false;
+    }
+    return true;
+}
+
+bool ChannelPosix::QueueHelloMessage()
+{
+    // The hello message goes first, nothing is queued before it.
+    std::unique_ptr<Message> m(new Message(MSG_ROUTING_NONE, HELLO_MESSAGE_TYPE));
+    if (!m->WriteInt(getpid()))
+        return false;
+
+    OutputElement* element = new OutputElement(m.release());
+    output_queue_.push_back(element);
+    return true;
+}
+
+bool ChannelPosix::Connect()
+{
+    base::MessageLoopForIO* loop = base::MessageLoopForIO::current();
+
+    if (pipe_ == -1)
+        return false;
+
+    // Data already in the socket is reported on the next turn of the loop,
+    // the listener is not called from inside Connect().
+    if (!loop->WatchFileDescriptor(pipe_, true, base::MessageLoopForIO::WATCH_READ,
+                                   &pipe_watcher_, this))
+        return false;
+
+    // Nothing is written before the connect finished, as if the socket
+    // buffer was full.
+    if (connect_pending_)
+    {
+        is_blocked_on_write_ = true;
+        return loop->WatchFileDescriptor(pipe_, false, base::MessageLoopForIO::WATCH_WRITE,
+                                         &pipe_watcher_, this);
+    }
+
+    // A shared memory client sends once the rings arrived.
+    if (waiting_connect_)
+        return true;
+
+    return ProcessOutgoingMessages();
+}
+
+bool ChannelPosix::ProcessOutgoingMessages()
+{
+    if (use_shared_memory_)
+        return ProcessOutgoingMessagesToRing();
+
+    while (FillOutputQueue())
+    {
+        if (pipe_ == -1)
+            return false;
+
+        // Gather the unsent segments of as many queued messages as fit, small
+        // messages leave in one system call instead of one each.
+        iovec iov[kMaxIovecs];
+        int iov_count = 0;
+        int fds[MessageAttachmentSet::kMaxDescriptorsPerMessage];
+        size_t num_fds = 0;
+        size_t segment = output_segment_;
+        size_t offset = output_offset_;
+        size_t i = 0;
+        for (; i < output_queue_.size() && iov_count < kMaxIovecs; ++i)
+        {
+            // The descriptors of a message go along with its first bytes, a
+            // message whose descriptors do not fit waits for the next write.
+            Message* message = output_queue_[i]->get_message();
+            if (i >= output_fds_sent_ && message && message->HasFileDescriptors())
+            {
+                const MessageAttachmentSet* set = message->attachment_set();
+                if (num_fds + set->size() > MessageAttachmentSet::kMaxDescriptorsPerMessage)
+                    break;
+                for (size_t j = 0; j < set->size(); ++j)
+                    fds[num_fds++] = set->descriptor(j);
+            }
+
+            const std::vector<Message::Segment>& segments = output_queue_[i]->segments();
+            for (; segment < segments.size() && iov_count < kMaxIovecs; ++segment)
+            {
+                if (segments[segment].size == offset)
+                {
+                    offset = 0;
+                    continue;
+                }
+                iov[iov_count].iov_base = const_cast<char*>(static_cast<const char*>(segments[segment].data) + offset);
+                iov[iov_count].iov_len = segments[segment].size - offset;
+                ++iov_count;
+                offset = 0;
+            }
+            segment = 0;
+        }
+
+        ssize_t bytes_written = 0;
+        if (iov_count)
+        {
+            bytes_written = SendWithDescriptors(iov, iov_count, fds, num_fds);
+            if (bytes_written < 0)
+            {
+                if (errno != EAGAIN && errno != EWOULDBLOCK)
+                    return false;
+
+                is_blocked_on_write_ = true;
+                return base::MessageLoopForIO::current()->WatchFileDescriptor(
+                    pipe_, false, base::MessageLoopForIO::WATCH_WRITE, &pipe_watcher_, this);
+            }
+            if (i > output_fds_sent_)
+                output_fds_sent_ = i;
+        }
+
+        // Drop what was written, a partial write leaves the queue positioned
+        // in the middle of a segment.
+        size_t remaining = static_cast<size_t>(bytes_written);
+        while (!output_queue_.empty())
+        {
+            OutputElement* element = output_queue_.front();
+            const std::vector<Message::Segment>& segments = element->segments();
+            while (output_segment_ < segments.size())
+            {
+                size_t left = segments[output_segment_].size - output_offset_;
+                if (remaining < left)
+                {
+                    output_offset_ += remaining;
+                    remaining = 0;
+                    break;
+                }
+                remaining -= left;
+                ++output_segment_;
+                output_offset_ = 0;
+            }
+
+            if (output_segment_ < segments.size())
+                break;
+
+            output_queue_.pop_front();
+            delete element;
+            output_segment_ = 0;
+            if (output_fds_sent_)
+                --output_fds_sent_;
+        }
+    }
+
+    return true;
+}
+
+void ChannelPosix::ClosePipeOnError()
+{
+    // The listener may delete the channel, nothing is touched after it.
+    Close();
+    listener()->OnChannelError();
+}
+
+void ChannelPosix::OnFileCanReadWithoutBlocking(int)
+{
+    bool ok;
+    if (use_shared_memory_)
+        ok = ProcessSharedMemoryEvents();
+    else
+        ok = ProcessIncomingMessages() != DISPATCH_ERROR;
+
+    if (!ok && pipe_ != -1)
+        ClosePipeOnError();
+}
+
+void ChannelPosix::OnFileCanWriteWithoutBlocking(int)
+{
+    is_blocked_on_write_ = false;
+    if (connect_pending_)
+    {
+        connect_pending_ = false;
+        int error = 0;
+        socklen_t length = sizeof(error);
+        if (getsockopt(pipe_, SOL_SOCKET, SO_ERROR, &error, &length) != 0 || error != 0)
+        {
+            ClosePipeOnError();
+            return;
+        }
+
+        // A shared memory client sends once the rings arrived.
+        if (waiting_connect_)
+            return;
+    }
+
+    if (!ProcessOutgoingMessages() && pipe_ != -1)
+        ClosePipeOnError();
+}
+
+bool ChannelPosix::CreateSharedMemory()
+{
+    int fd = memfd_create("libHH.ipc", MFD_CLOEXEC);
+    if (fd == -1)
+        return false;
+
+    size_t size = 2 * internal::SharedRing::RegionSize(kSharedRingCapacity);
+    bool ok = ftruncate(fd, size) == 0 && MapSharedMemory(fd, size, true);
+    if (ok)
+    {
+        // The descriptor rides on the first byte of the stream, the client
+        // takes no other byte before it.
+        char byte = 0;
+        iovec iov = { &byte, 1 };
+        ok = SendWithDescriptors(&iov, 1, &fd, 1) == 1;
+    }
+
+    close(fd);
+    return ok;
+}
+
+bool ChannelPosix::ReceiveSharedMemory(bool* received)
+{
+    *received = false;
+
+    char byte;
+    iovec iov = { &byte, 1 };
+    char control[CMSG_SPACE(sizeof(int))];
+
+    msghdr msgh = {};
+    msgh.msg_iov = &iov;
+    msgh.msg_iovlen = 1;
+    msgh.msg_control = control;
+    msgh.msg_controllen = sizeof(control);
+
+    ssize_t rv;
+    do
+    {
+        rv = recvmsg(pipe_, &msgh, MSG_DONTWAIT | MSG_CMSG_CLOEXEC);
+    } while (rv < 0 && errno == EINTR);
+
+    if (rv < 0)
+        return errno == EAGAIN || errno == EWOULDBLOCK;
+    if (rv == 0)
+        return false;
+
+    // A server without MODE_SHARED_MEMORY_FLAG sends no descriptor.
+    cmsghdr* cmsg = CMSG_FIRSTHDR(&msgh);
+    if (!cmsg || cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS ||
+        cmsg->cmsg_len != CMSG_LEN(sizeof(int)))
+        return false;
+
+    int fd;
+    memcpy(&fd, CMSG_DATA(cmsg), sizeof(int));
+
+    struct stat info;
+    bool ok = fstat(fd, &info) == 0 && MapSharedMemory(fd, info.st_size, false);
+    close(fd);
+
+    *received = ok;
+    return ok;
+}
+
+bool ChannelPosix::MapSharedMemory(int fd, size_t size, bool is_server)
+{
+    size_t capacity = size % 2 ? 0 : internal::SharedRing::CapacityForRegion(size / 2);
+    if (!capacity)
+        return false;
+
+    void* memory = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (memory == MAP_FAILED)
+        return false;
+
+    shared_memory_ = memory;
+    shared_memory_size_ = size;
+
+    // The server sends through the first ring, the client through the second.
+    char* rings[2] = { static_cast<char*>(memory), static_cast<char*>(memory) + size / 2 };
+    if (is_server)
+    {
+        internal::SharedRing::InitializeRegion(rings[0]);
+        internal::SharedRing::InitializeRegion(rings[1]);
+    }
+    send_ring_.Attach(rings[is_server ? 0 : 1], capacity);
+    receive_ring_.Attach(rings[is_server ? 1 : 0], capacity);
+    return true;
+}
+
+bool ChannelPosix::ProcessOutgoingMessagesToRing()
+{
+    if (pipe_ == -1 || !shared_memory_)
+        return false;
+
+    bool wrote = false;
+    bool room_made = false;
+    while (FillOutputQueue())
+    {
+        OutputElement* element = output_queue_.front();
+
+        // The descriptors go ahead on the socket, with a doorbell.
+        Message* message = element->get_message();
+        if (!output_fds_sent_ && message && message->HasFileDescriptors())
+        {
+            const MessageAttachmentSet* set = message->attachment_set();
+            int fds[MessageAttachmentSet::kMaxDescriptorsPerMessage];
+            for (size_t j = 0; j < set->size(); ++j)
+                fds[j] = set->descriptor(j);
+
+            char byte = 0;
+            iovec iov = { &byte, 1 };
+            if (SendWithDescriptors(&iov, 1, fds, set->size()) < 0)
+            {
+                if (errno != EAGAIN && errno != EWOULDBLOCK)
+                    return false;
+
+                // The peer does not even take doorbells, wait for the socket.
+                is_blocked_on_write_ = true;
+                if (!base::MessageLoopForIO::current()->WatchFileDescriptor(
+                        pipe_, false, base::MessageLoopForIO::WATCH_WRITE, &pipe_watcher_, this))
+                    return false;
+                break;
+            }
+            output_fds_sent_ = 1;
+        }
+
+        const std::vector<Message::Segment>& segments = element->segments();
+        bool full = false;
+        while (output_segment_ < segments.size())
+        {
+            const Message::Segment& segment = segments[output_segment_];
+            size_t left = segment.size - output_offset_;
+            size_t written = send_ring_.Write(static_cast<const char*>(segment.data) + output_offset_, left);
+            if (written)
+            {
+                wrote = true;
+                room_made = false;
+            }
+            if (written < left)
+            {
+                output_offset_ += written;
+                full = true;
+                break;
+            }
+            ++output_segment_;
+            output_offset_ = 0;
+        }
+
+        if (full)
+        {
+            // A ring that takes nothing after making room is corrupt.
+            if (room_made)
+                return false;
+
+            // The consumer rings back when it made room.
+            if (send_ring_.PrepareToWaitForSpace())
+            {
+                is_blocked_on_write_ = true;
+                break;
+            }
+            room_made = true;
+            continue;
+        }
+
+        output_queue_.pop_front();
+        delete element;
+        output_segment_ = 0;
+        output_fds_sent_ = 0;
+    }
+
+    // One doorbell for all the messages written, none while the consumer
+    // is awake.
+    if (wrote && send_ring_.TakeDataWaiter())
+        RingDoorbell();
+    return true;
+}
+
+bool ChannelPosix::ProcessSharedMemoryEvents()
+{
+    if (!shared_memory_)
+    {
+        bool received;
+        if (!ReceiveSharedMemory(&received))
+            return false;
+        if (!received)
+            return true;
+
+        waiting_connect_ = false;
+        if (!ProcessOutgoingMessages())
+            return false;
+    }
+
+    if (!DrainDoorbell())
+        return false;
+
+    if (is_blocked_on_write_)
+    {
+        is_blocked_on_write_ = false;
+        if (!ProcessOutgoingMessages())
+            return false;
+    }
+
+    // What the peer wrote before closing is still dispatched.
+    if (ProcessIncomingMessages() == DISPATCH_ERROR)
+        return false;
+    return !peer_closed_;
+}
+
+void ChannelPosix::RingDoorbell()
+{
+    // A full socket holds doorbells enough, a closed one fails the next read.
+    char byte = 0;
+    while (send(pipe_, &byte, 1, MSG_DONTWAIT | MSG_NOSIGNAL) < 0 && errno == EINTR)
+        ;
+}
+
+bool ChannelPosix::DrainDoorbell()
+{
+    char buffer[64];
+    for (;;)
+    {
+        ssize_t rv = ReceiveWithDescriptors(buffer, sizeof(buffer));
+        if (rv > 0)
+            continue;
+        if (rv == 0)
+        {
+            peer_closed_ = true;
+            return true;
+        }
+        return errno == EAGAIN || errno == EWOULDBLOCK;
+    }
+}
+
+ssize_t ChannelPosix::SendWithDescriptors(iovec* iov, int iov_count, const int* fds, size_t num_fds)
+{
+    char control[CMSG_SPACE(sizeof(int) * MessageAttachmentSet::kMaxDescriptorsPerMessage)];
+
+    msghdr msgh = {};
+    msgh.msg_iov = iov;
+    msgh.msg_iovlen = iov_count;
+    if (num_fds)
+    {
+        msgh.msg_control = control;
+        msgh.msg_controllen = CMSG_SPACE(sizeof(int) * num_fds);
+
+        cmsghdr* cmsg = CMSG_FIRSTHDR(&msgh);
+        cmsg->cmsg_level = SOL_SOCKET;
+        cmsg->cmsg_type = SCM_RIGHTS;
+        cmsg->cmsg_len = CMSG_LEN(sizeof(int) * num_fds);
+        memcpy(CMSG_DATA(cmsg), fds, sizeof(int) * num_fds);
+    }
+
+    // sendmsg() is writev() with flags, a reset peer shows up as EPIPE
+    // instead of SIGPIPE.
+    ssize_t rv;
+    do
+    {
+        rv = sendmsg(pipe_, &msgh, MSG_DONTWAIT | MSG_NOSIGNAL);
+    } while (rv < 0 && errno == EINTR);
+    return rv;
+}
+
+ssize_t ChannelPosix::ReceiveWithDescriptors(char* buffer, size_t size)
+{
+    char control[CMSG_SPACE(sizeof(int) * MessageAttachmentSet::kMaxDescriptorsPerMessage)];
+    iovec iov = { buffer, size };
+
+    msghdr msgh = {};
+    msgh.msg_iov = &iov;
+    msgh.msg_iovlen = 1;
+    msgh.msg_control = control;
+    msgh.msg_controllen = sizeof(control);
+
+    ssize_t rv;
+    do
+    {
+        rv = recvmsg(pipe_, &msgh, MSG_DONTWAIT | MSG_CMSG_CLOEXEC);
+    } while (rv < 0 && errno == EINTR);
+    if (rv < 0)
+        return rv;
+
+    for (cmsghdr* cmsg = CMSG_FIRSTHDR(&msgh); cmsg; cmsg = CMSG_NXTHDR(&msgh, cmsg))
+    {
+        if (cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS)
+            continue;
+
+        size_t count = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+        const unsigned char* data = CMSG_DATA(cmsg);
+        for (size_t i = 0; i < count; ++i)
+        {
+            int fd;
+            memcpy(&fd, data + i * sizeof(int), sizeof(int));
+            input_fds_.push_back(base::ScopedFD(fd));
+        }
+    }
+
+    // Descriptors the control buffer could not hold are lost, the messages
+    // they belong to cannot be delivered. A peer that sends descriptors no
+    // message claims does not get to fill the descriptor table either.
+    if ((msgh.msg_flags & MSG_CTRUNC) || input_fds_.size() > kMaxQueuedDescriptors)
+    {
+        errno = EMSGSIZE;
+        return -1;
+    }
+    return rv;
+}
+
+//------------------------------------------------------------------------------
+// ChannelPosixServer
+
+// An accepted client. It listens to the channel of the client and passes on
+// what it hears to the listener of the server.
+class ChannelPosixServer::Connection : public Listener
+{
+public:
+    Connection(ChannelPosixServer* server, base::ScopedFD fd, Mode mode)
+        : server_(server),
+          channel_(new ChannelPosix(std::move(fd), mode, this))
+    {
+
+    }
+
+    ChannelPosix* channel() const { return channel_.get(); }
+
+    // Listener implementation
+    bool OnMessageReceived(const Message& message) override
+    {
+        return server_->listener_->OnMessageReceived(message);
+    }
+
+    bool OnMessageReceivedDeferred(const Message& message, const base::Closure& consumed) override
+    {
+        return server_->listener_->OnMessageReceivedDeferred(message, consumed);
+    }
+
+    void OnChannelConnected(int32_t) override { server_->OnConnectionHello(this); }
+
+    void OnChannelError() override { server_->OnConnectionError(this); }
+
+    void OnBadMessageReceived(const Message& message) override
+    {
+        server_->listener_->OnBadMessageReceived(message);
+    }
+
+    void OnSendBufferFull(int32_t peer_pid) override
+    {
+        server_->listener_->OnSendBufferFull(peer_pid);
+    }
+
+    void OnSendBufferDrained(int32_t peer_pid) override
+    {
+        server_->listener_->OnSendBufferDrained(peer_pid);
+    }
+
+private:
+    ChannelPosixServer* server_;
+    std::unique_ptr<ChannelPosix> channel_;
+
+    DISALLOW_COPY_AND_ASSIGN(Connection);
+};
+
+ChannelPosixServer::ChannelPosixServer(const IPC::ChannelHandle& channel_handle, Mode mode,
+                                       Listener* listener)
+    : listener_(listener),
+      mode_(mode),
+      listen_pipe_(-1)
+{
+    CreatePipe(channel_handle);
+}
+
+ChannelPosixServer::~ChannelPosixServer()
+{
+    Close();
+}
+
+bool ChannelPosixServer::CreatePipe(const IPC::ChannelHandle &channel_handle)
+{
+    sockaddr_un address;
+    std::string socket_name = ChannelPosix::SocketName(channel_handle);
+    if (!MakeSocketAddress(socket_name, &address))
+        return false;
+
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd == -1)
+        return false;
+
+    // A socket file left behind by a dead server would fail the bind.
+    unlink(socket_name.c_str());
+    if (!SetNonBlocking(fd) ||
+        bind(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 ||
+        listen(fd, SOMAXCONN) != 0)
+    {
+        close(fd);
+        return false;
+    }
+
+    listen_pipe_ = fd;
+    socket_name_ = socket_name;
+    return true;
+}
+
+bool ChannelPosixServer::Connect()
+{
+    if (listen_pipe_ == -1)
+        return false;
+
+    return base::MessageLoopForIO::current()->WatchFileDescriptor(
+        listen_pipe_, true, base::MessageLoopForIO::WATCH_READ, &listen_watcher_, this);
+}
+
+void ChannelPosixServer::Close()
+{
+    listen_watcher_.StopWatchingFileDescriptor();
+    if (listen_pipe_ != -1)
+    {
+        CloseDescriptor(&listen_pipe_);
+        unlink(socket_name_.c_str());
+    }
+
+    clients_.clear();
+    for (std::unordered_set<Connection*>::iterator it = connections_.begin();
+         it != connections_.end(); ++it)
+        delete *it;
+    connections_.clear();
+
+    for (size_t i = 0; i < closed_connections_.size(); ++i)
+        delete closed_connections_[i];
+    closed_connections_.clear();
+
+    while (!prelim_queue_.empty())
+    {
+        delete prelim_queue_.front();
+        prelim_queue_.pop();
+    }
+}
+
+bool ChannelPosixServer::Send(Message* message)
+{
+    if (clients_.empty())
+    {
+        prelim_queue_.push(message);
+        return true;
+    }
+
+    if (message->is_reply() && message->get_sender_pid() != base::kNullProcessId)
+        return SendOne(message->get_sender_pid(), message);
+
+    if (message->routing_id() == MSG_ROUTING_CONTROL)
+        return SendAll(message);
+
+    return SendOne(message->routing_id(), message);
+}
+
+base::ProcessId ChannelPosixServer::GetPeerPID() const
+{
+    return clients_.empty() ? base::kNullProcessId : clients_.begin()->first;
+}
+
+base::ProcessId ChannelPosixServer::GetSelfPID() const
+{
+    return getpid();
+}
+
+bool ChannelPosixServer::AcceptConnections()
+{
+    // No channel of a failed connection is on the stack here.
+    for (size_t i = 0; i < closed_connections_.size(); ++i)
+        delete closed_connections_[i];
+    closed_connections_.clear();
+
+    for (;;)
+    {
+        int fd = accept4(listen_pipe_, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd == -1)
+        {
+            if (errno == EINTR || errno == ECONNABORTED)
+                continue;
+            return errno == EAGAIN || errno == EWOULDBLOCK;
+        }
+
+        Connection* connection = new Connection(this, base::ScopedFD(fd), mode_);
+        connections_.insert(connection);
+        if (!connection->channel()->Connect())
+            RemoveConnection(connection);
+    }
+}
+
+void ChannelPosixServer::OnConnectionHello(Connection* connection)
+{
+    base::ProcessId pid = connection->channel()->GetPeerPID();
+    clients_[pid] = connection;
+
+    // The messages that waited for a client go ahead of the ones the
+    // listener sends when it hears of it.
+    std::queue<Message*, base::circular_deque<Message*> > prelim_queue;
+    prelim_queue_.swap(prelim_queue);
+    while (!prelim_queue.empty())
+    {
+        Send(prelim_queue.front());
+        prelim_queue.pop();
+    }
+
+    if (connections_.count(connection))
+        listener_->OnChannelConnected(pid);
+}
+
+void ChannelPosixServer::OnConnectionError(Connection* connection)
+{
+    if (RemoveConnection(connection) && clients_.empty())
+        listener_->OnChannelError();
+}
+
+bool ChannelPosixServer::RemoveConnection(Connection* connection)
+{
+    if (!connections_.erase(connection))
+        return false;
+
+    // A client reusing the pid may have replaced this one already.
+    std::unordered_map<base::ProcessId, Connection*>::iterator it =
+        clients_.find(connection->channel()->GetPeerPID());
+    bool was_client = it != clients_.end() && it->second == connection;
+    if (was_client)
+        clients_.erase(it);
+
+    connection->channel()->Close();
+    closed_connections_.push_back(connection);
+    return was_client;
+}
+
+bool ChannelPosixServer::SendAll(Message* message)
+{
+    std::shared_ptr<Message> shared(message);
+
+    std::unordered_map<base::ProcessId, Connection*>::iterator it = clients_.begin();
+    while (it != clients_.end())
+    {
+        // A client whose socket failed is dropped, the others still get it.
+        Connection* connection = it->second;
+        ++it;
+        if (!connection->channel()->SendShared(shared))
+            RemoveConnection(connection);
+    }
+    return !clients_.empty();
+}
+
+bool ChannelPosixServer::SendOne(base::ProcessId pid, Message* message)
+{
+    std::unordered_map<base::ProcessId, Connection*>::iterator it = clients_.find(pid);
+    if (it == clients_.end())
+    {
+        delete message;
+        return true;
+    }
+
+    Connection* connection = it->second;
+    if (!connection->channel()->Send(message))
+        RemoveConnection(connection);
+    return !clients_.empty();
+}
+
+void ChannelPosixServer::OnFileCanReadWithoutBlocking(int)
+{
+    // The listener may delete the channel, nothing is touched after it.
+    if (!AcceptConnections())
+    {
+        Close();
+        listener_->OnChannelError();
+    }
+}
+
+void ChannelPosixServer::OnFileCanWriteWithoutBlocking(int)
+{
+
+}
+
+//------------------------------------------------------------------------------
+// Channel's methods
+
+// static
+std::unique_ptr<Channel> Channel::Create(const IPC::ChannelHandle& channel_handle,
+                                         Mode mode,
+                                         Listener* listener)
+{
+    if (mode & MODE_SERVER)
+        return std::unique_ptr<Channel>(new ChannelPosixServer(channel_handle, mode, listener));
+
+    return std::unique_ptr<Channel>(new ChannelPosix(channel_handle, mode, listener));
+}
+
+
+// static
+bool Channel::IsNamedServerInitialized(const std::string& channel_id)
+{
+    return ChannelPosix::IsNamedServerInitialized(channel_id);
+}
+
+
+}  // namespace IPC
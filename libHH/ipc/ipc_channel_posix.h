@@ -0,0 +1,290 @@
+#ifndef IPC_IPC_CHANNEL_POSIX_H_
+#define IPC_IPC_CHANNEL_POSIX_H_
+
+#include "ipc/ipc_channel_reader.h"
+
+#include <stddef.h>
+#include <sys/types.h>
+
+#include <memory>
+#include <queue>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "base/containers/circular_deque.h"
+#include "base/files/scoped_file.h"
+#include "base/macros.h"
+#include "base/message_loop/message_loop.h"
+#include "ipc/ipc_channel.h"
+#include "ipc/ipc_shared_ring.h"
+
+
+struct iovec;
+
+namespace IPC {
+
+// Channel over an AF_UNIX stream socket, driven by the epoll pump of the
+// MessageLoopForIO it is connected on. Reads go straight into the buffer of
+// the ChannelReader, queued messages leave in gathered writes.
+//
+// With MODE_SHARED_MEMORY_FLAG the server maps two SharedRings in a memfd
+// and passes it to the client once connected. The byte stream then goes
+// through the rings and the socket only carries doorbells, one byte each,
+// sent when the other side sleeps.
+//
+// Descriptors attached to messages go through the socket as SCM_RIGHTS in
+// either case.
+//
+// A server is a ChannelPosixServer, it gives every client it accepts a
+// ChannelPosix of its own.
+class ChannelPosix : public Channel,
+                     public internal::ChannelReader,
+                     public base::MessageLoopForIO::Watcher
+{
+public:
+    ChannelPosix(const IPC::ChannelHandle& channel_handle, Mode mode,
+                 Listener* listener);
+    // Takes |fd|, the socket of a client accepted by a ChannelPosixServer.
+    ChannelPosix(base::ScopedFD fd, Mode mode, Listener* listener);
+    ~ChannelPosix();
+
+    // Channel implementation
+    bool Connect() override;
+    void Close() override;
+    bool Send(Message* message) override;
+    bool SendBatch(std::vector<Message*>* messages) override;
+    base::ProcessId GetPeerPID() const override;
+    base::ProcessId GetSelfPID() const override;
+
+    static bool IsNamedServerInitialized(const std::string& channel_id);
+
+    // Sends |message| like Send(), sharing it with the channels to other
+    // peers instead of copying it.
+    bool SendShared(const std::shared_ptr<Message>& message);
+
+private:
+    friend class ChannelPosixServer;
+
+    // ChannelReader implementation.
+    ReadState ReadData(char* buffer, int buffer_len, int* bytes_read) override;
+    bool GetAttachments(Message* msg) override;
+    void HandleInternalMessage(const Message& msg) override;
+    base::ProcessId GetSenderPID() override;
+    bool SendCreditMessage(Message* msg) override;
+    bool OnSendCreditAdded() override;
+
+    // Path of the socket of |channel_id|, an absolute |channel_id| is taken
+    // as the path itself.
+    static const std::string SocketName(const std::string& channel_id);
+    bool CreatePipe(const IPC::ChannelHandle &channel_handle, Mode mode);
+
+    // Queues the hello message, the peer takes the channel as connected when
+    // it arrives.
+    bool QueueHelloMessage();
+
+    // Writes as much of |output_queue_| as the socket takes. Returns |false|
+    // on channel error.
+    bool ProcessOutgoingMessages();
+
+    // Adds |element| to its priority queue and calls
+    // ProcessOutgoingMessages(), or to its blocked queue without credit for
+    // it. Takes ownership of |element|.
+    bool ProcessMessageForDelivery(OutputElement* element);
+
+    // Moves elements of the priority queues to |output_queue_|, high
+    // priority first, until it holds a chunk worth of bytes. Returns false
+    // if there is nothing to write.
+    bool FillOutputQueue();
+
+    // Moves all messages from |prelim_queue_| to |output_queue_| by calling
+    // ProcessMessageForDelivery().
+    void FlushPrelimQueue();
+
+    void ClosePipeOnError();
+
+    // sendmsg() of |iov| with |fds| attached to its first byte.
+    ssize_t SendWithDescriptors(iovec* iov, int iov_count, const int* fds, size_t num_fds);
+
+    // recvmsg() into |buffer|, the descriptors that come along are appended
+    // to |input_fds_|.
+    ssize_t ReceiveWithDescriptors(char* buffer, size_t size);
+
+    // Shared memory transport. The server creates the rings and passes them
+    // in the first byte it sends, the client waits for them before sending.
+    bool CreateSharedMemory();
+    bool ReceiveSharedMemory(bool* received);
+    bool MapSharedMemory(int fd, size_t size, bool is_server);
+    bool ProcessOutgoingMessagesToRing();
+    bool ProcessSharedMemoryEvents();
+    void RingDoorbell();
+
+    // Reads the pending doorbells and the descriptors that came with them.
+    // Sets |peer_closed_| at the end of the stream.
+    bool DrainDoorbell();
+
+    // MessageLoopForIO::Watcher implementation.
+    void OnFileCanReadWithoutBlocking(int fd) override;
+    void OnFileCanWriteWithoutBlocking(int fd) override;
+
+private:
+    // Segments of the queued messages gathered into one write at most.
+    enum { kMaxIovecs = 64 };
+
+    // Bytes of each ring, one per direction.
+    enum { kSharedRingCapacity = 256 * 1024 };
+
+    // Received descriptors waiting for their messages at most. Through the
+    // rings, messages can lag behind the doorbells that carried theirs.
+    enum { kMaxQueuedDescriptors = 1024 };
+
+    int pipe_;
+
+    // Reads are watched for all along, writes only while
+    // |is_blocked_on_write_|.
+    base::MessageLoopForIO::FileDescriptorWatcher pipe_watcher_;
+
+    base::ProcessId peer_pid_;
+
+    // Messages sent before the hello message of the peer arrived, see
+    // ChannelWin::prelim_queue_.
+    std::queue<Message*, base::circular_deque<Message*> > prelim_queue_;
+
+    // Messages to be sent are queued here.
+    // Held as a deque, a write gathers from several of them.
+    base::circular_deque<OutputElement*> output_queue_;
+
+    // Messages and chunks waiting for |output_queue_|, indexed by
+    // OutputElement::is_high_priority(). |output_queue_| is kept short so
+    // high priority messages get into it soon.
+    base::circular_deque<OutputElement*> priority_queues_[2];
+
+    // Messages waiting for credit of the peer, in order, indexed like
+    // |priority_queues_|. They move there as credit comes in.
+    base::circular_deque<OutputElement*> blocked_queues_[2];
+
+    // Position in the front element of |output_queue_| where the last write
+    // stopped.
+    size_t output_segment_;
+    size_t output_offset_;
+
+    // Elements at the front of |output_queue_| whose descriptors were sent.
+    // Descriptors go with the first write that has bytes of their message,
+    // or before it, so they are there when the peer reads the message.
+    size_t output_fds_sent_;
+
+    // Descriptors received and not yet taken by a message, in the order of
+    // the messages they belong to.
+    base::circular_deque<base::ScopedFD> input_fds_;
+
+    // The socket buffer is full, |pipe_watcher_| waits for room in it.
+    bool is_blocked_on_write_;
+
+    // The connect of a client has not finished, |is_blocked_on_write_| is
+    // set meanwhile.
+    bool connect_pending_;
+
+    // Set while SendBatch() queues its messages, they are written once all
+    // are queued.
+    bool holding_writes_;
+
+    // A shared memory client has no rings yet.
+    bool waiting_connect_;
+
+    bool use_shared_memory_;
+    void* shared_memory_;
+    size_t shared_memory_size_;
+    internal::SharedRing send_ring_;
+    internal::SharedRing receive_ring_;
+
+    // The peer closed the socket of a shared memory channel. The messages it
+    // put in the ring before are still dispatched, then the channel fails.
+    // Seen by whichever DrainDoorbell() read the end of the stream.
+    bool peer_closed_;
+
+    DISALLOW_COPY_AND_ASSIGN(ChannelPosix);
+};
+
+// Serves any number of ChannelPosix clients on one socket name. Every
+// accepted socket gets a ChannelPosix of its own, with its own reader and
+// output queue, found from the peer pid once its hello message arrived.
+//
+// Messages routed to MSG_ROUTING_CONTROL go to every client, serialized
+// once and shared by their output queues. Replies go to the client the
+// request came from, other messages to the client whose pid is their
+// routing id, like ChannelServer does. Messages for a client that is gone
+// are dropped, those sent while no client is connected wait for one.
+//
+// The listener hears of every client in OnChannelConnected(), and gets
+// OnChannelError() when the last one went away.
+class ChannelPosixServer : public Channel,
+                           public base::MessageLoopForIO::Watcher
+{
+public:
+    ChannelPosixServer(const IPC::ChannelHandle& channel_handle, Mode mode,
+                       Listener* listener);
+    ~ChannelPosixServer();
+
+    // Channel implementation
+    bool Connect() override;
+    void Close() override;
+    bool Send(Message* message) override;
+
+    // The pid of one of the connected clients, kNullProcessId while there is
+    // none.
+    base::ProcessId GetPeerPID() const override;
+    base::ProcessId GetSelfPID() const override;
+
+private:
+    class Connection;
+
+    bool CreatePipe(const IPC::ChannelHandle &channel_handle);
+
+    // Accepts the clients waiting on the listening socket.
+    bool AcceptConnections();
+
+    // Called by |connection| when the hello message of its peer arrived.
+    void OnConnectionHello(Connection* connection);
+
+    // Called by |connection| when its channel failed.
+    void OnConnectionError(Connection* connection);
+
+    // Closes |connection|, which is deleted with the next accepted client,
+    // its channel may still be on the stack. Returns true if its peer was a
+    // connected client, false if it said no hello or was removed before.
+    bool RemoveConnection(Connection* connection);
+
+    bool SendAll(Message* message);
+    bool SendOne(base::ProcessId pid, Message* message);
+
+    // MessageLoopForIO::Watcher implementation.
+    void OnFileCanReadWithoutBlocking(int fd) override;
+    void OnFileCanWriteWithoutBlocking(int fd) override;
+
+private:
+    Listener* listener_;
+    Mode mode_;
+
+    int listen_pipe_;
+    std::string socket_name_;
+    base::MessageLoopForIO::FileDescriptorWatcher listen_watcher_;
+
+    // Every accepted client, with or without a hello message.
+    std::unordered_set<Connection*> connections_;
+
+    // The connections whose peer said hello, by its pid.
+    std::unordered_map<base::ProcessId, Connection*> clients_;
+
+    // Connections that failed, waiting to be deleted.
+    std::vector<Connection*> closed_connections_;
+
+    // Messages sent while no client is connected.
+    std::queue<Message*, base::circular_deque<Message*> > prelim_queue_;
+
+    DISALLOW_COPY_AND_ASSIGN(ChannelPosixServer);
+};
+
+}  // namespace IPC
+
+#endif  // IPC_IPC_CHANNEL_POSIX_H_
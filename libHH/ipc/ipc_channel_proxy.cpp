@@ -6,6 +6,8 @@
 
 #include <stddef.h>
 #include <stdint.h>
+#include <string.h>
+#include <algorithm>
 #include <utility>
 
 #include "base/compiler_specific.h"
@@ -15,11 +17,33 @@
 #include "build/build_config.h"
 #include "ipc/ipc_listener.h"
 #include "ipc/ipc_message_macros.h"
+#include "ipc/ipc_sync_message.h"
 #include "ipc/message_filter.h"
 #include "ipc/message_filter_router.h"
 
 namespace IPC {
 
+namespace {
+
+void RunReplyCallback(const ChannelProxy::ReplyCallback& callback,
+                      const std::shared_ptr<const Message>& reply)
+{
+    callback(reply.get());
+}
+
+size_t GetSendBatchBucket(size_t count)
+{
+    size_t bucket = 0;
+    while (count > 1 && bucket + 1 < ChannelProxy::kSendBatchBuckets)
+    {
+        count >>= 1;
+        ++bucket;
+    }
+    return bucket;
+}
+
+}  // namespace
+
 //------------------------------------------------------------------------------
 
 ChannelProxy::Context::Context(
@@ -30,12 +54,18 @@ ChannelProxy::Context::Context(
       ipc_task_runner_(ipc_task_runner),
       channel_connected_called_(false),
       message_filter_router_(new MessageFilterRouter()),
-      peer_pid_(base::kNullProcessId)
+      peer_pid_(base::kNullProcessId),
+      reply_timer_deadline_(0),
+      pending_send_bytes_(0),
+      coalescing_window_ms_(0),
+      coalescing_max_bytes_(0),
+      flush_posted_(false)
 {
-
+    memset(send_batch_counts_, 0, sizeof(send_batch_counts_));
 }
 
 ChannelProxy::Context::~Context() {
+    CancelReplyTimer();
 }
 
 void ChannelProxy::Context::ClearIPCTaskRunner()
@@ -62,21 +92,111 @@ bool ChannelProxy::Context::TryFilters(const Message& message)
 bool ChannelProxy::Context::OnMessageReceived(const Message& message) 
 {
     // First give a chance to the filters to process this message.
-    if (!TryFilters(message))
-        OnMessageReceivedNoFilter(message);
+    if (TryFilters(message))
+        return true;
+
+    // A reply nobody waits for any more (timed out or cancelled) is dropped,
+    // the listener never sent the request.
+    if (message.is_reply())
+    {
+        TryToResolveReply(message);
+        return true;
+    }
+
+    OnMessageReceivedNoFilter(message);
     return true;
 }
 
+// Called on the IPC::Channel thread
+bool ChannelProxy::Context::OnMessageReceivedDeferred(const Message& message,
+                                                      const base::Closure& consumed)
+{
+    // The copy handed to the listener's thread takes |consumed| along, the
+    // peer gets its credit back once the listener is done with the message.
+    receive_consumed_ = consumed;
+    bool handled = OnMessageReceived(message);
+    if (!receive_consumed_.is_null())
+    {
+        // A filter took it, nothing holds on to it.
+        receive_consumed_ = base::Closure();
+        consumed.Run();
+    }
+    return handled;
+}
+
+// Called on the IPC::Channel thread
+std::shared_ptr<const Message> ChannelProxy::Context::CopyReceivedMessage(const Message& message)
+{
+    Message* copy = new Message(message);
+    if (receive_consumed_.is_null())
+        return std::shared_ptr<const Message>(copy);
+
+    base::Closure consumed = receive_consumed_;
+    receive_consumed_ = base::Closure();
+    return std::shared_ptr<const Message>(
+        copy, std::bind(&Context::DeleteReceivedMessage, ipc_task_runner_, consumed,
+                        std::placeholders::_1));
+}
+
+// static
+void ChannelProxy::Context::DeleteReceivedMessage(
+    const scoped_refptr<base::SingleThreadTaskRunner>& ipc_task_runner,
+    const base::Closure& consumed, const Message* message)
+{
+    delete message;
+    ipc_task_runner->PostTask(consumed);
+}
+
+// Called on the IPC::Channel thread
+bool ChannelProxy::Context::TryToResolveReply(const Message& reply)
+{
+    auto it = pending_replies_.find(SyncMessage::GetMessageId(reply));
+    if (it == pending_replies_.end())
+        return false;
+
+    PendingReply pending = it->second;
+    pending_replies_.erase(it);
+    if (pending.deadline)
+    {
+        reply_deadlines_.erase(std::make_pair(pending.deadline, SyncMessage::GetMessageId(reply)));
+        ScheduleReplyTimer();
+    }
+
+    PostReply(pending, CopyReceivedMessage(reply));
+    return true;
+}
+
+// static
+void ChannelProxy::Context::PostReply(const PendingReply& pending,
+                                      const std::shared_ptr<const Message>& reply)
+{
+    if (!pending.task_runner)
+    {
+        RunReplyCallback(pending.callback, reply);
+        return;
+    }
+
+    base::Closure task = std::bind(&RunReplyCallback, pending.callback, reply);
+    pending.task_runner->PostTask(task);
+}
+
 // Called on the IPC::Channel thread
 bool ChannelProxy::Context::OnMessageReceivedNoFilter(const Message& message) 
+{
+    // The message is copied once, the closure copies made while posting
+    // only share it.
+    PostDispatchMessage(CopyReceivedMessage(message));
+    return true;
+}
+
+void ChannelProxy::Context::PostDispatchMessage(const std::shared_ptr<const Message>& message)
 {
     base::Closure task = std::bind(&Context::OnDispatchMessage, this, message);
     listener_task_runner_->PostTask(task);
-    return true;
 }
 
 // Called on the IPC::Channel thread
-void ChannelProxy::Context::OnChannelConnected(int32_t peer_pid) 
+void ChannelProxy::Context::OnChannelConnected(int32_t) 
 {
     // We cache off the peer_pid so it can be safely accessed from both threads.
     peer_pid_ = channel_->GetPeerPID();
@@ -91,10 +211,26 @@ void ChannelProxy::Context::OnChannelConnected(int32_t peer_pid)
 // Called on the IPC::Channel thread
 void ChannelProxy::Context::OnChannelError() 
 {
+    CancelPendingReplies();
+
     base::Closure task = std::bind(&Context::OnDispatchError, this);
     listener_task_runner_->PostTask(task);
 }
 
+// Called on the IPC::Channel thread
+void ChannelProxy::Context::OnSendBufferFull(int32_t peer_pid)
+{
+    base::Closure task = std::bind(&Context::OnDispatchSendBufferFull, this, peer_pid);
+    listener_task_runner_->PostTask(task);
+}
+
+// Called on the IPC::Channel thread
+void ChannelProxy::Context::OnSendBufferDrained(int32_t peer_pid)
+{
+    base::Closure task = std::bind(&Context::OnDispatchSendBufferDrained, this, peer_pid);
+    listener_task_runner_->PostTask(task);
+}
+
 // Called on the IPC::Channel thread
 void ChannelProxy::Context::OnChannelOpened() 
 {
@@ -118,6 +254,8 @@ void ChannelProxy::Context::OnChannelClosed()
     if (!channel_)
         return;
 
+    CancelPendingReplies();
+
     for (size_t i = 0; i < filters_.size(); ++i) 
     {
         filters_[i]->OnFilterRemoved();
@@ -155,6 +293,158 @@ void ChannelProxy::Context::OnSendMessage(Message* message)
         OnChannelError();
 }
 
+// Called on the IPC::Channel thread
+void ChannelProxy::Context::OnSendWithReply(Message* message, const PendingReply& pending,
+                                            int64_t timeout_ms)
+{
+    if (!channel_)
+    {
+        delete message;
+        PostReply(pending, std::shared_ptr<const Message>());
+        return;
+    }
+
+    // Registered before the message leaves, the reply cannot overtake it.
+    RegisterReply(SyncMessage::GetMessageId(*message), pending, timeout_ms);
+    OnSendMessage(message);
+}
+
+// Called on the IPC::Channel thread
+void ChannelProxy::Context::RegisterReply(int request_id, const PendingReply& pending,
+                                          int64_t timeout_ms)
+{
+    PendingReply& entry = pending_replies_[request_id];
+    if (entry.deadline)
+        reply_deadlines_.erase(std::make_pair(entry.deadline, request_id));
+    entry = pending;
+    entry.deadline = 0;
+
+    if (timeout_ms > 0)
+    {
+        entry.deadline = TimeTicksNow + timeout_ms;
+        reply_deadlines_.insert(std::make_pair(entry.deadline, request_id));
+        ScheduleReplyTimer();
+    }
+}
+
+// Called on the IPC::Channel thread
+void ChannelProxy::Context::OnFlushSends()
+{
+    std::vector<PendingSend> sends;
+    {
+        base::AutoLock auto_lock(pending_sends_lock_);
+        sends.swap(pending_sends_);
+        pending_send_bytes_ = 0;
+        flush_posted_ = false;
+        if (!sends.empty())
+            ++send_batch_counts_[GetSendBatchBucket(sends.size())];
+    }
+
+    if (!channel_)
+    {
+        for (size_t i = 0; i < sends.size(); ++i)
+        {
+            if (sends[i].has_reply)
+                PostReply(sends[i].reply, std::shared_ptr<const Message>());
+            delete sends[i].message;
+        }
+        return;
+    }
+
+    std::vector<Message*> messages;
+    messages.reserve(sends.size());
+    for (size_t i = 0; i < sends.size(); ++i)
+    {
+        if (sends[i].has_reply)
+        {
+            RegisterReply(SyncMessage::GetMessageId(*sends[i].message),
+                          sends[i].reply, sends[i].timeout_ms);
+        }
+        messages.push_back(sends[i].message);
+    }
+
+    if (!messages.empty() && !channel_->SendBatch(&messages))
+        OnChannelError();
+}
+
+// static
+void ChannelProxy::Context::OnReplyTimer(const scoped_refptr<ReplyTimer>& timer)
+{
+    if (timer->context)
+        timer->context->OnReplyTimeout();
+}
+
+// Called on the IPC::Channel thread
+void ChannelProxy::Context::OnReplyTimeout()
+{
+    // This timer has fired, a new one is needed for whatever is left.
+    reply_timer_ = NULL;
+
+    base::TimeTicks now = TimeTicksNow;
+    while (!reply_deadlines_.empty() && reply_deadlines_.begin()->first <= now)
+    {
+        int request_id = reply_deadlines_.begin()->second;
+        reply_deadlines_.erase(reply_deadlines_.begin());
+
+        auto it = pending_replies_.find(request_id);
+        if (it == pending_replies_.end())
+            continue;
+
+        PendingReply pending = it->second;
+        pending_replies_.erase(it);
+        PostReply(pending, std::shared_ptr<const Message>());
+    }
+
+    ScheduleReplyTimer();
+}
+
+// Called on the IPC::Channel thread
+void ChannelProxy::Context::ScheduleReplyTimer()
+{
+    if (reply_deadlines_.empty())
+    {
+        CancelReplyTimer();
+        return;
+    }
+
+    // One timer covers every pending reply, it is only replaced when an
+    // earlier deadline comes in.
+    base::TimeTicks deadline = reply_deadlines_.begin()->first;
+    if (reply_timer_ && reply_timer_deadline_ <= deadline)
+        return;
+
+    CancelReplyTimer();
+    reply_timer_ = new ReplyTimer(this);
+    reply_timer_deadline_ = deadline;
+
+    int64_t delay_ms = std::max<int64_t>(deadline - TimeTicksNow, 0);
+    base::Closure task = std::bind(&Context::OnReplyTimer, reply_timer_);
+    ipc_task_runner_->PostDelayedTask(task, delay_ms);
+}
+
+// Called on the IPC::Channel thread
+void ChannelProxy::Context::CancelReplyTimer()
+{
+    if (!reply_timer_)
+        return;
+
+    reply_timer_->context = NULL;
+    reply_timer_ = NULL;
+    reply_timer_deadline_ = 0;
+}
+
+// Called on the IPC::Channel thread
+void ChannelProxy::Context::CancelPendingReplies()
+{
+    reply_deadlines_.clear();
+    CancelReplyTimer();
+
+    std::unordered_map<int, PendingReply> replies;
+    replies.swap(pending_replies_);
+    for (auto it = replies.begin(); it != replies.end(); ++it)
+        PostReply(it->second, std::shared_ptr<const Message>());
+}
+
 // Called on the IPC::Channel thread
 void ChannelProxy::Context::OnAddFilter()
 {
@@ -231,14 +521,14 @@ void ChannelProxy::Context::AddFilter(MessageFilter* filter)
 }
 
 // Called on the listener's thread
-void ChannelProxy::Context::OnDispatchMessage(const Message& message)
+void ChannelProxy::Context::OnDispatchMessage(const std::shared_ptr<const Message>& message)
 {
     if (!listener_)
         return;
 
     OnDispatchConnected();
 
-    listener_->OnMessageReceived(message);
+    listener_->OnMessageReceived(*message);
 }
 
 // Called on the listener's thread
@@ -266,6 +556,20 @@ void ChannelProxy::Context::OnDispatchBadMessage(const Message& message)
         listener_->OnBadMessageReceived(message);
 }
 
+// Called on the listener's thread
+void ChannelProxy::Context::OnDispatchSendBufferFull(int32_t peer_pid)
+{
+    if (listener_)
+        listener_->OnSendBufferFull(peer_pid);
+}
+
+// Called on the listener's thread
+void ChannelProxy::Context::OnDispatchSendBufferDrained(int32_t peer_pid)
+{
+    if (listener_)
+        listener_->OnSendBufferDrained(peer_pid);
+}
+
 void ChannelProxy::Context::ClearChannel()
 {
     base::AutoLock lock(channel_lifetime_lock_);
@@ -273,13 +577,112 @@ void ChannelProxy::Context::ClearChannel()
 }
 
 
+// Called on any thread
+bool ChannelProxy::Context::QueueSend(const PendingSend& send)
+{
+    bool post_timer = false;
+    int64_t window_ms = 0;
+    {
+        base::AutoLock auto_lock(pending_sends_lock_);
+
+        // With coalescing just turned off the flush on its way still takes
+        // the message along, sent directly it would overtake the ones held.
+        if (!coalescing_window_ms_ && !flush_posted_)
+            return false;
+
+        pending_sends_.push_back(send);
+        pending_send_bytes_ += send.message->size();
+        window_ms = coalescing_window_ms_;
+
+        // Nobody waits on a sync message or a reply to be sent later, the
+        // peer of a sync message sent to us is blocked until our reply comes.
+        if (!window_ms || pending_send_bytes_ >= coalescing_max_bytes_ ||
+            send.message->is_sync() || send.message->is_reply() || send.has_reply)
+            PostFlushLocked();
+        else
+            post_timer = pending_sends_.size() == 1;
+    }
+
+    if (post_timer)
+    {
+        // Not cancelled when the batch leaves earlier, the timer of a batch
+        // gone then sends the next one a little early. It posts the flush
+        // like Flush() does, the batch cannot overtake a message sent
+        // directly before it was held.
+        base::Closure task = std::bind(&Context::Flush, scoped_refptr<Context>(this));
+        ipc_task_runner()->PostDelayedTask(task, window_ms);
+    }
+    return true;
+}
+
 void ChannelProxy::Context::Send(Message* message)
 {
+    PendingSend send;
+    send.message = message;
+    send.has_reply = false;
+    send.timeout_ms = 0;
+    if (QueueSend(send))
+        return;
+
   //  std::unique_ptr<Message> msg(message);
     base::Closure task = std::bind(&ChannelProxy::Context::OnSendMessage, this, message);
     ipc_task_runner()->PostTask(task);
 }
 
+void ChannelProxy::Context::SendWithReply(SyncMessage* message, const ReplyCallback& callback,
+                                          int64_t timeout_ms)
+{
+    // The reply goes to |callback|, not into output parameters.
+    delete message->GetReplyDeserializer();
+
+    PendingReply pending;
+    pending.callback = callback;
+    if (base::ThreadTaskRunnerHandle::IsSet())
+        pending.task_runner = base::ThreadTaskRunnerHandle::Get();
+
+    PendingSend send;
+    send.message = message;
+    send.has_reply = true;
+    send.reply = pending;
+    send.timeout_ms = timeout_ms;
+    if (QueueSend(send))
+        return;
+
+    base::Closure task = std::bind(&ChannelProxy::Context::OnSendWithReply, this,
+                                   static_cast<Message*>(message), pending, timeout_ms);
+    ipc_task_runner()->PostTask(task);
+}
+
+void ChannelProxy::Context::SetSendCoalescing(int64_t window_ms, size_t max_bytes)
+{
+    base::AutoLock auto_lock(pending_sends_lock_);
+    coalescing_window_ms_ = window_ms;
+    coalescing_max_bytes_ = max_bytes;
+
+    // Sends what is held, before the messages sent without coalescing.
+    if (!window_ms && !pending_sends_.empty())
+        PostFlushLocked();
+}
+
+void ChannelProxy::Context::Flush()
+{
+    base::AutoLock auto_lock(pending_sends_lock_);
+    if (!pending_sends_.empty())
+        PostFlushLocked();
+}
+
+void ChannelProxy::Context::PostFlushLocked()
+{
+    if (flush_posted_)
+        return;
+
+    // Posted under the lock, a message sent once coalescing is off queues
+    // behind the flush and cannot overtake the ones held.
+    flush_posted_ = true;
+    base::Closure task = std::bind(&Context::OnFlushSends, this);
+    ipc_task_runner()->PostTask(task);
+}
+
 
 //-----------------------------------------------------------------------------
 
@@ -303,6 +706,12 @@ ChannelProxy::ChannelProxy(Listener* listener,
 
 }
 
+ChannelProxy::ChannelProxy(Context* context)
+    : context_(context)
+{
+
+}
+
 ChannelProxy::~ChannelProxy()
 {
     Close();
@@ -336,6 +745,28 @@ bool ChannelProxy::Send(Message* message)
     return true;
 }
 
+void ChannelProxy::SendWithReply(SyncMessage* message, const ReplyCallback& callback,
+                                 int64_t timeout_ms)
+{
+    context_->SendWithReply(message, callback, timeout_ms);
+}
+
+void ChannelProxy::SetSendCoalescing(int64_t window_ms, size_t max_bytes)
+{
+    context_->SetSendCoalescing(window_ms, max_bytes);
+}
+
+void ChannelProxy::Flush()
+{
+    context_->Flush();
+}
+
+void ChannelProxy::GetSendBatchCounts(uint64_t counts[kSendBatchBuckets]) const
+{
+    base::AutoLock auto_lock(context_->pending_sends_lock_);
+    memcpy(counts, context_->send_batch_counts_, sizeof(context_->send_batch_counts_));
+}
+
 void ChannelProxy::AddFilter(MessageFilter* filter) 
 {
     context_->AddFilter(filter);
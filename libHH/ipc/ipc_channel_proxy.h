@@ -7,10 +7,16 @@
 
 #include <stdint.h>
 
+#include <functional>
+#include <memory>
+#include <set>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 
 #include "base/memory/ref_counted.h"
 #include "base/synchronization/lock.h"
+#include "base/time2.h"
 #include "ipc/ipc_channel.h"
 #include "ipc/ipc_listener.h"
 #include "ipc/ipc_sender.h"
@@ -22,6 +28,7 @@ class SingleThreadTaskRunner;
 namespace IPC {
 class MessageFilter;
 class MessageFilterRouter;
+class SyncMessage;
 
 
 // ChannelProxy IPCϢIǪִ߳,Listenerӿڴ߳
@@ -61,6 +68,36 @@ public:
     // thread where it is passed to the IPC::Channel's Send method.
     bool Send(Message* message) override;
 
+    // Called with the reply to a message sent with SendWithReply(), or with
+    // NULL if none came in time or the channel broke.
+    typedef std::function<void(const Message* reply)> ReplyCallback;
+
+    // Sends a sync message without blocking. The reply is matched on the IO
+    // thread and |callback| runs with it on the calling thread, or on the IO
+    // thread if the calling thread has no task runner. A |timeout_ms| of 0
+    // waits as long as the channel lives. The output pointers given to the
+    // message are not used, pass NULL and read the reply with
+    // msg_class::ReadReplyParam().
+    void SendWithReply(SyncMessage* message, const ReplyCallback& callback, int64_t timeout_ms);
+
+    // Coalescing of sends, off by default. Messages are held back and handed
+    // to the channel together, |window_ms| after the first one of a batch or
+    // once |max_bytes| are held, and a channel that gathers writes then
+    // writes a batch in few system calls. Sync messages, replies and
+    // SendWithReply() go out at once with the messages held before them. A |window_ms| of 0
+    // turns it off and sends what is held.
+    void SetSendCoalescing(int64_t window_ms, size_t max_bytes);
+
+    // Hands the messages held back by coalescing to the channel now, for
+    // latency-critical sends.
+    void Flush();
+
+    // Batches handed to the channel by coalescing, by size, to tune the
+    // window with. |counts|[i] is the number of batches of 2^i to
+    // 2^(i+1) - 1 messages, the last bucket also counts the bigger ones.
+    enum { kSendBatchBuckets = 16 };
+    void GetSendBatchCounts(uint64_t counts[kSendBatchBuckets]) const;
+
     // Used to intercept messages as they are received on the background thread.
     //
     // Ordinarily, messages sent to the ChannelProxy are routed to the matching
@@ -88,6 +125,11 @@ protected:
     ChannelProxy(Listener* listener,
         const scoped_refptr<base::SingleThreadTaskRunner>& ipc_task_runner);
 
+    // For subclasses with a Context of their own.
+    explicit ChannelProxy(Context* context);
+
+    Context* context() const { return context_.get(); }
+
     // Used internally to hold state that is referenced on the IPC thread.
     class Context : public base::RefCountedThreadSafe<Context>, public Listener 
     {
@@ -104,11 +146,16 @@ protected:
         const std::string& channel_id() const { return channel_id_; }
 
         // Dispatches a message on the listener thread.
-        void OnDispatchMessage(const Message& message);
+        void OnDispatchMessage(const std::shared_ptr<const Message>& message);
 
         // Sends |message| from appropriate thread.
         void Send(Message* message);
 
+        void SendWithReply(SyncMessage* message, const ReplyCallback& callback, int64_t timeout_ms);
+
+        void SetSendCoalescing(int64_t window_ms, size_t max_bytes);
+        void Flush();
+
 
     protected:
         friend class base::RefCountedThreadSafe<Context>;
@@ -116,16 +163,32 @@ protected:
 
         // IPC::Listener methods:
         bool OnMessageReceived(const Message& message) override;
+        bool OnMessageReceivedDeferred(const Message& message,
+                                       const base::Closure& consumed) override;
         void OnChannelConnected(int32_t peer_pid) override;
         void OnChannelError() override;
+        void OnSendBufferFull(int32_t peer_pid) override;
+        void OnSendBufferDrained(int32_t peer_pid) override;
 
         // Like OnMessageReceived but doesn't try the filters.
         bool OnMessageReceivedNoFilter(const Message& message);
 
+        // Posts |message| to the listener's thread.
+        void PostDispatchMessage(const std::shared_ptr<const Message>& message);
+
+        // Copies the message being received for another thread. The peer
+        // gets credit for it back once the last copy is gone, see
+        // OnMessageReceivedDeferred().
+        std::shared_ptr<const Message> CopyReceivedMessage(const Message& message);
+
         // Gives the filters a chance at processing |message|.
         // Returns true if the message was processed, false otherwise.
         bool TryFilters(const Message& message);
 
+        // Hands |reply| to the callback of its SendWithReply(). Returns false
+        // if nobody waits for it.
+        bool TryToResolveReply(const Message& reply);
+
         // Like Open and Close, but called on the IPC thread.
         virtual void OnChannelOpened();
         virtual void OnChannelClosed();
@@ -139,19 +202,82 @@ protected:
         friend class ChannelProxy;
         friend class IpcSecurityTestUtil;
 
+        // A message sent with SendWithReply() waiting for its reply.
+        struct PendingReply
+        {
+            ReplyCallback callback;
+            scoped_refptr<base::SingleThreadTaskRunner> task_runner;
+            // 0 without a timeout.
+            base::TimeTicks deadline;
+        };
+
+        // The task posted for the earliest reply deadline holds this instead
+        // of the context. Cancelling clears |context|, the task then does
+        // nothing and the context is not kept alive until it runs.
+        struct ReplyTimer : public base::RefCountedThreadSafe<ReplyTimer>
+        {
+            explicit ReplyTimer(Context* context) : context(context) {}
+
+            // Only touched on the IPC thread.
+            Context* context;
+
+        private:
+            friend class base::RefCountedThreadSafe<ReplyTimer>;
+            ~ReplyTimer() {}
+        };
+
+        // A message held back by send coalescing.
+        struct PendingSend
+        {
+            Message* message;
+            // Set for SendWithReply().
+            bool has_reply;
+            PendingReply reply;
+            int64_t timeout_ms;
+        };
+
+        // Runs the callback of |pending| on its thread, |reply| is NULL on
+        // failure.
+        static void PostReply(const PendingReply& pending,
+                              const std::shared_ptr<const Message>& reply);
+
+        // Deletes a copy made by CopyReceivedMessage(), runs |consumed| on the
+        // IPC thread.
+        static void DeleteReceivedMessage(
+            const scoped_refptr<base::SingleThreadTaskRunner>& ipc_task_runner,
+            const base::Closure& consumed, const Message* message);
+
         // Create the Channel
         void CreateChannel(const IPC::ChannelHandle& channel_handle, Channel::Mode mode);
 
         // Methods called on the IO thread.
         void OnSendMessage(Message* message);
+        void OnSendWithReply(Message* message, const PendingReply& pending, int64_t timeout_ms);
+        void RegisterReply(int request_id, const PendingReply& pending, int64_t timeout_ms);
+        void OnFlushSends();
+        static void OnReplyTimer(const scoped_refptr<ReplyTimer>& timer);
+        void OnReplyTimeout();
+        void ScheduleReplyTimer();
+        void CancelReplyTimer();
+        void CancelPendingReplies();
         void OnAddFilter();
         void OnRemoveFilter(MessageFilter* filter);
 
+        // Holds |send| back if coalescing is on, called on any thread.
+        // Returns false if it is off.
+        bool QueueSend(const PendingSend& send);
+
+        // Posts OnFlushSends() unless it is already. |pending_sends_lock_|
+        // must be held.
+        void PostFlushLocked();
+
         // Methods called on the listener thread.
         void AddFilter(MessageFilter* filter);
         void OnDispatchConnected();
         void OnDispatchError();
         void OnDispatchBadMessage(const Message& message);
+        void OnDispatchSendBufferFull(int32_t peer_pid);
+        void OnDispatchSendBufferDrained(int32_t peer_pid);
 
         void ClearChannel();
 
@@ -187,6 +313,34 @@ protected:
         // Cached copy of the peer process ID. Set on IPC but read on both IPC and
         // listener threads.
         base::ProcessId peer_pid_;
+
+        // The |consumed| of the message being received, until a copy of the
+        // message takes it along. Only accessed on the IPC thread.
+        base::Closure receive_consumed_;
+
+        // By request id. Only accessed on the IPC thread, a message is
+        // registered there right before it is sent.
+        std::unordered_map<int, PendingReply> pending_replies_;
+
+        // The deadlines of |pending_replies_| with a timeout, earliest first,
+        // and the timer armed for the first of them. Only accessed on the IPC
+        // thread.
+        std::set<std::pair<base::TimeTicks, int> > reply_deadlines_;
+        scoped_refptr<ReplyTimer> reply_timer_;
+        base::TimeTicks reply_timer_deadline_;
+
+        // Send coalescing, guarded by |pending_sends_lock_|. Messages are only
+        // held while |coalescing_window_ms_| is not 0. All of them go through
+        // |pending_sends_| then, so whichever flush task runs first sends
+        // them in order.
+        std::vector<PendingSend> pending_sends_;
+        size_t pending_send_bytes_;
+        int64_t coalescing_window_ms_;
+        size_t coalescing_max_bytes_;
+        // An immediate flush is posted and has not run yet.
+        bool flush_posted_;
+        uint64_t send_batch_counts_[kSendBatchBuckets];
+        mutable base::Lock pending_sends_lock_;
     };
 
 private:
@@ -4,7 +4,13 @@
 #include <QLocalSocket>
 #include <QCoreApplication>
 
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "base/containers/circular_deque.h"
 #include "base/memory/ptr_util.h"
+#include "base/memory/ref_counted_memory.h"
 #include "ipc/ipc_message.h"
 #include "ipc/ipc_listener.h"
 #include "build/build_config.h"
@@ -12,10 +18,186 @@
 
 namespace IPC{
 
+namespace {
+
+// Writes the segments of a message, external data goes to the socket buffer
+// straight from where the sender keeps it.
+void WriteSegments(QLocalSocket* socket, const std::vector<Message::Segment>& segments)
+{
+    for (size_t i = 0; i < segments.size(); ++i)
+        socket->write(static_cast<const char*>(segments[i].data), segments[i].size);
+}
+
+// The wire bytes of |msg| in one buffer, to be queued by any number of
+// connections.
+scoped_refptr<base::RefCountedMemory> SerializeMessage(Message* msg)
+{
+    std::vector<Message::Segment> segments;
+    msg->GetSegments(&segments);
+
+    size_t size = 0;
+    for (size_t i = 0; i < segments.size(); ++i)
+        size += segments[i].size;
+
+    std::string bytes;
+    bytes.reserve(size);
+    for (size_t i = 0; i < segments.size(); ++i)
+        bytes.append(static_cast<const char*>(segments[i].data), segments[i].size);
+    return base::RefCountedString::TakeString(&bytes);
+}
+
+}  // namespace
+
+// One accepted client. Partial messages wait in the buffer of its own
+// reader, never interleaved with bytes of other clients. Messages to send
+// wait in its output queue as shared buffers, a broadcast is queued by every
+// connection but serialized once. The socket copies only what it is about
+// to write. Messages the client has not granted credit for wait in a queue
+// of their own.
+class ChannelServer::Connection : public QObject,
+                                  public internal::ChannelReader
+{
+public:
+    Connection(ChannelServer* server, QLocalSocket* socket, Listener* listener)
+        : QObject(server),
+          ChannelReader(listener),
+          server_(server),
+          socket_(socket),
+          peer_pid_(0),
+          output_offset_(0)
+    {
+        socket_->setParent(this);
+    }
+
+    QLocalSocket* socket() const { return socket_; }
+
+    // 0 until the hello message arrived.
+    qint64 peer_pid() const { return peer_pid_; }
+
+    // |takes_credit| tells whether the message in |buffer| counts against
+    // the window, see FlowControl::TakesCredit().
+    void Write(const scoped_refptr<base::RefCountedMemory>& buffer, bool takes_credit)
+    {
+        // Messages keep their order, the ones after a message without credit
+        // wait as well.
+        if (takes_credit &&
+            (!blocked_queue_.empty() || !flow_control()->TakeCredit(buffer->size())))
+        {
+            blocked_queue_.push_back(buffer);
+            if (blocked_queue_.size() == 1)
+                listener()->OnSendBufferFull(peer_pid_);
+            return;
+        }
+
+        output_queue_.push_back(buffer);
+        ProcessOutgoingMessages();
+    }
+
+    // Hands the socket bytes of the queue until it holds kMaxSocketBuffer.
+    void ProcessOutgoingMessages()
+    {
+        while (!output_queue_.empty())
+        {
+            qint64 buffered = socket_->bytesToWrite();
+            if (buffered >= kMaxSocketBuffer)
+                return;
+
+            const base::RefCountedMemory* buffer = output_queue_.front().get();
+            qint64 count = std::min<qint64>(buffer->size() - output_offset_, kMaxSocketBuffer - buffered);
+            count = socket_->write(buffer->front_as<char>() + output_offset_, count);
+            if (count < 0)
+            {
+                socket_->abort();
+                return;
+            }
+
+            output_offset_ += static_cast<size_t>(count);
+            if (output_offset_ == buffer->size())
+            {
+                output_queue_.pop_front();
+                output_offset_ = 0;
+            }
+        }
+    }
+
+protected:
+    // ChannelReader implementation
+    virtual ReadState ReadData(char* buffer, int buffer_len, int* bytes_read)
+    {
+        qint64 count = socket_->read(buffer, buffer_len);
+        if (count < 0)
+            return READ_FAILED;
+        if (count == 0)
+            return READ_PENDING;
+
+        *bytes_read = static_cast<int>(count);
+        return READ_SUCCEEDED;
+    }
+
+    virtual base::ProcessId GetSenderPID() { return peer_pid_; }
+
+    virtual void HandleInternalMessage(const Message& msg)
+    {
+        // The hello message contains one parameter containing the PID. A
+        // client says hello once.
+        base::PickleIterator iterator(msg);
+        int32_t pid = 0;
+        if (peer_pid_ != 0 || !iterator.ReadInt32(&pid) || pid <= 0)
+        {
+            socket_->abort();
+            return;
+        }
+
+        peer_pid_ = pid;
+        server_->OnConnectionHello(this);
+    }
+
+    virtual bool SendCreditMessage(Message* msg)
+    {
+        std::unique_ptr<Message> m(msg);
+        output_queue_.push_back(SerializeMessage(m.get()));
+        ProcessOutgoingMessages();
+        return true;
+    }
+
+    virtual bool OnSendCreditAdded()
+    {
+        if (blocked_queue_.empty())
+            return true;
+
+        while (!blocked_queue_.empty() && flow_control()->TakeCredit(blocked_queue_.front()->size()))
+        {
+            output_queue_.push_back(blocked_queue_.front());
+            blocked_queue_.pop_front();
+        }
+        ProcessOutgoingMessages();
+
+        if (blocked_queue_.empty())
+            listener()->OnSendBufferDrained(peer_pid_);
+        return true;
+    }
+
+private:
+    enum { kMaxSocketBuffer = 64 * 1024 };
+
+    ChannelServer* server_;
+    QLocalSocket* socket_;
+    qint64 peer_pid_;
+
+    base::circular_deque<scoped_refptr<base::RefCountedMemory> > output_queue_;
+
+    // Bytes of the front of |output_queue_| the socket has.
+    size_t output_offset_;
+
+    // Messages waiting for credit of the client, they move to
+    // |output_queue_| as it grants more.
+    base::circular_deque<scoped_refptr<base::RefCountedMemory> > blocked_queue_;
+};
+
 //channel server
 ChannelServer::ChannelServer(const ChannelHandle& channel_handle, Listener* listener, QObject *parent)	
     : QObject(parent),
-      ChannelReader(listener)
+      listener_(listener)
 {
 	server_ = new QLocalServer(this);
 	server_->listen(QString::fromStdString(channel_handle));
@@ -53,52 +235,74 @@ bool ChannelServer::Send(Message* msg)
 
 void ChannelServer::OnNewConnection()
 {
-    QLocalSocket *socket = server_->nextPendingConnection();
-    connect(socket, SIGNAL(readyRead()), this, SLOT(OnReadyRead()));
-    connect(socket, SIGNAL(disconnected()), this, SLOT(OnClientDisconnected()));
-    SendHelloMessage(socket);
+    while (QLocalSocket *socket = server_->nextPendingConnection())
+    {
+        connections_.insert(socket, new Connection(this, socket, listener_));
+
+        connect(socket, SIGNAL(readyRead()), this, SLOT(OnReadyRead()));
+        connect(socket, SIGNAL(bytesWritten(qint64)), this, SLOT(OnBytesWritten()));
+        connect(socket, SIGNAL(disconnected()), this, SLOT(OnClientDisconnected()));
+        SendHelloMessage(socket);
+    }
 }
 
 void ChannelServer::OnReadyRead()
 {
     QLocalSocket *socket = qobject_cast<QLocalSocket *>(sender());
-    QByteArray data = socket->readAll();
-    InputData(data.data(), data.size());
-
-    // client must send a 'hello message type' for confirming the connection
-    int32_t pid = FindProcessId(socket);
-    if (pid == 0)
-    {
-        Message msg;
-        bool rs = GetHelloMessage(&msg);
-        if (rs)
-        {
-            base::PickleIterator iterator(msg);
-            iterator.ReadInt32(&pid);
-            if (pid > 0)
-            {
-                clients_.insert(pid, socket);
+    Connection* connection = connections_.value(socket);
+    if (!connection)
+        return;
+
+    // client must send a 'hello message type' for confirming the connection,
+    // the reader hands it to OnConnectionHello().
+    if (connection->ProcessIncomingMessages() == internal::ChannelReader::DISPATCH_ERROR)
+        socket->abort();
+}
 
-                listener()->OnChannelConnected(pid);
-            }
-        }
-    }
+void ChannelServer::OnBytesWritten()
+{
+    QLocalSocket *socket = qobject_cast<QLocalSocket *>(sender());
+    Connection* connection = connections_.value(socket);
+    if (connection)
+        connection->ProcessOutgoingMessages();
 }
 
 void ChannelServer::OnClientDisconnected()
 {
     QLocalSocket *socket = qobject_cast<QLocalSocket *>(sender());
-    qint64 pid = FindProcessId(socket);
-    clients_.remove(pid);
+    Connection* connection = connections_.take(socket);
+    if (!connection)
+        return;
+
+    // A client reusing the pid may have replaced this one already.
+    QHash<qint64, Connection*>::iterator it = clients_.find(connection->peer_pid());
+    if (it != clients_.end() && *it == connection)
+        clients_.erase(it);
+
+    // Disconnection can be signalled while the connection is reading.
+    connection->deleteLater();
+}
+
+void ChannelServer::OnConnectionHello(Connection* connection)
+{
+    clients_.insert(connection->peer_pid(), connection);
+
+    listener_->OnChannelConnected(connection->peer_pid());
 }
 
 bool ChannelServer::SendAll(Message* msg)
 {
-    QMap<qint64, QLocalSocket*>::iterator it = clients_.begin();
+    std::unique_ptr<Message> m(msg);
+    if (clients_.isEmpty())
+        return true;
+
+    scoped_refptr<base::RefCountedMemory> buffer = SerializeMessage(msg);
+    bool takes_credit = internal::FlowControl::TakesCredit(*msg);
+
+    QHash<qint64, Connection*>::iterator it = clients_.begin();
     while (it != clients_.end())
     {
-        QLocalSocket *socket = *it;
-        socket->write(reinterpret_cast<const char*>(msg->data()), msg->size());
+        (*it)->Write(buffer, takes_credit);
 
         it++;
     }
@@ -107,12 +311,13 @@ bool ChannelServer::SendAll(Message* msg)
 
 bool ChannelServer::SendOne(qint64 pid, Message* msg)
 {
-    QMap<qint64, QLocalSocket*>::iterator it = clients_.find(pid);
-    if (it == clients_.end())
+    std::unique_ptr<Message> m(msg);
+    Connection* connection = clients_.value(pid);
+    if (!connection)
         return false;
 
-    QLocalSocket *socket = *it;
-    socket->write(reinterpret_cast<const char*>(msg->data()), msg->size());
+    // Queued behind any broadcast the client has not received yet.
+    connection->Write(SerializeMessage(msg), internal::FlowControl::TakesCredit(*msg));
     return true;
 }
 
@@ -124,25 +329,12 @@ void ChannelServer::SendHelloMessage(QLocalSocket *socket)
     socket->write(reinterpret_cast<const char*>(msg.data()), msg.size());
 }
 
-qint64 ChannelServer::FindProcessId(QLocalSocket* socket)
-{
-    QMap<qint64, QLocalSocket*>::iterator it = clients_.begin();
-    while (it != clients_.end())
-    {
-        if (socket == (*it))
-        {
-            return it.key();
-        }
-        it++;
-    }
-    return 0;
-}
-
 
 //channel client
 ChannelClient::ChannelClient(const ChannelHandle& channel_handle, Listener* listener, QObject *parent /*= 0*/)
     :QObject(parent),
-    ChannelReader(listener)
+    ChannelReader(listener),
+    peer_pid_(0)
 {
     client_ = new QLocalSocket(this);
     client_->setServerName(QString::fromStdString(channel_handle));
@@ -169,39 +361,97 @@ void ChannelClient::Close()
 
 bool ChannelClient::Send(Message* msg)
 {
-    client_->write(reinterpret_cast<const char*>(msg->data()), msg->size());
+    std::unique_ptr<Message> m(msg);
+    std::vector<Message::Segment> segments;
+    msg->GetSegments(&segments);
+
+    size_t size = 0;
+    for (size_t i = 0; i < segments.size(); ++i)
+        size += segments[i].size;
+
+    // Without credit the message waits in one buffer, the ones after it
+    // wait as well.
+    if (internal::FlowControl::TakesCredit(*msg) &&
+        (!blocked_queue_.empty() || !flow_control()->TakeCredit(size)))
+    {
+        blocked_queue_.push_back(SerializeMessage(msg));
+        if (blocked_queue_.size() == 1)
+            listener()->OnSendBufferFull(peer_pid_);
+        return true;
+    }
+
+    WriteSegments(client_, segments);
+    return true;
+}
+
+bool ChannelClient::SendCreditMessage(Message* msg)
+{
+    std::unique_ptr<Message> m(msg);
+    client_->write(reinterpret_cast<const char*>(m->data()), m->size());
+    return true;
+}
+
+bool ChannelClient::OnSendCreditAdded()
+{
+    if (blocked_queue_.empty())
+        return true;
+
+    while (!blocked_queue_.empty() && flow_control()->TakeCredit(blocked_queue_.front()->size()))
+    {
+        const base::RefCountedMemory* buffer = blocked_queue_.front().get();
+        client_->write(buffer->front_as<char>(), buffer->size());
+        blocked_queue_.pop_front();
+    }
+
+    if (blocked_queue_.empty())
+        listener()->OnSendBufferDrained(peer_pid_);
     return true;
 }
 
 void ChannelClient::OnReadyRead()
 {
-    QByteArray data = client_->readAll();
-    InputData(data.data(), data.size());
+    if (ProcessIncomingMessages() == DISPATCH_ERROR)
+    {
+        client_->abort();
+        listener()->OnChannelError();
+    }
+}
+
+ChannelClient::ReadState ChannelClient::ReadData(char* buffer, int buffer_len, int* bytes_read)
+{
+    qint64 count = client_->read(buffer, buffer_len);
+    if (count < 0)
+        return READ_FAILED;
+    if (count == 0)
+        return READ_PENDING;
+
+    *bytes_read = static_cast<int>(count);
+    return READ_SUCCEEDED;
+}
 
+void ChannelClient::HandleInternalMessage(const Message& msg)
+{
+    base::PickleIterator iterator(msg);
     int32_t pid;
-    Message msg;
-    bool rs = GetHelloMessage(&msg);
-    if (rs)
+    if (iterator.ReadInt32(&pid) && pid > 0)
     {
-        base::PickleIterator iterator(msg);
-        iterator.ReadInt32(&pid);
-        if (pid > 0)
-        {
-            listener()->OnChannelConnected(pid);
-        }
+        peer_pid_ = pid;
+        listener()->OnChannelConnected(pid);
     }
 }
 
 void ChannelClient::OnConnected()
 {
+    // The hello message takes no credit, it does not go through Send().
     qint64 pid = QCoreApplication::applicationPid();
     IPC::Message msg(MSG_ROUTING_NONE, IPC::Channel::HELLO_MESSAGE_TYPE);
     msg.WriteInt32(pid);
-    Send(&msg);
+    client_->write(reinterpret_cast<const char*>(msg.data()), msg.size());
 }
 
 
-#ifndef OS_WIN
+// Linux has ChannelPosix, see ipc_channel_posix.cpp.
+#if !defined(OS_WIN) && !defined(OS_LINUX)
 
 // Channel's static methods
 std::unique_ptr<Channel> Channel::Create(const ChannelHandle& channel_handle, Mode mode, Listener* listener)
@@ -217,6 +467,6 @@ std::unique_ptr<Channel> Channel::Create(const ChannelHandle& channel_handle, Mo
     return base::WrapUnique<Channel>(nullptr);
 }
 
-#endif // OS_WIN
+#endif // !OS_WIN && !OS_LINUX
 
 }
\ No newline at end of file
@@ -2,8 +2,10 @@
 #define IPC_CHANNEL_IMPL_H
 
 #include <QObject>
-#include <QMap>
+#include <QHash>
 
+#include "base/containers/circular_deque.h"
+#include "base/memory/ref_counted_memory.h"
 #include "ipc/ipc_channel.h"
 #include "ipc/ipc_channel_reader.h"
 
@@ -12,9 +14,11 @@ class QLocalSocket;
 
 namespace IPC {
 
+// Serves any number of ChannelClients. Every accepted socket gets a
+// Connection with a reader of its own, found from the socket or, once its
+// hello message arrived, from the peer pid in constant time.
 class ChannelServer : public QObject, 
-					  public Channel, 
-                      public internal::ChannelReader
+					  public Channel
 {
     Q_OBJECT
 
@@ -28,26 +32,34 @@ public:
     virtual void Close();
     virtual bool Send(Message* msg);
 
-    virtual base::ProcessId GetPeerPID() const { return 1; }
+    virtual base::ProcessId GetPeerPID() const { return 1; }
     virtual base::ProcessId GetSelfPID() const { return 1; }
-    virtual ReadState ReadData(char* buffer, int buffer_len, int* bytes_read) { return READ_FAILED; }
-    virtual base::ProcessId GetSenderPID() { return 1; }
-    virtual void HandleInternalMessage(const Message& msg) {}
 
 private slots:
     void OnNewConnection();
     void OnReadyRead();
+    void OnBytesWritten();
     void OnClientDisconnected();
 
 private:
-    qint64 FindProcessId(QLocalSocket* socket);
+    class Connection;
+
+    // Called by |connection| when the hello message of its peer arrives.
+    void OnConnectionHello(Connection* connection);
+
     bool SendAll(Message* msg);
     bool SendOne(qint64 pid, Message* msg);
     void SendHelloMessage(QLocalSocket *socket);
 
 private:
     QLocalServer* server_;
-    QMap<qint64, QLocalSocket*> clients_;
+    Listener* listener_;
+
+    // Every accepted socket, with or without a hello message.
+    QHash<QLocalSocket*, Connection*> connections_;
+
+    // The connections whose peer said hello, by its pid.
+    QHash<qint64, Connection*> clients_;
 };
 
 
@@ -68,11 +80,16 @@ public:
     virtual void Close();
     virtual bool Send(Message* msg);
 
-    virtual base::ProcessId GetPeerPID() const { return 1; }
+    virtual base::ProcessId GetPeerPID() const { return 1; }
     virtual base::ProcessId GetSelfPID() const { return 1; }
-    virtual ReadState ReadData(char* buffer, int buffer_len, int* bytes_read) { return READ_FAILED; }
-    virtual base::ProcessId GetSenderPID() { return 1; }
-    virtual void HandleInternalMessage(const Message& msg) {}
+
+protected:
+    // ChannelReader implementation
+    virtual ReadState ReadData(char* buffer, int buffer_len, int* bytes_read);
+    virtual base::ProcessId GetSenderPID() { return peer_pid_; }
+    virtual void HandleInternalMessage(const Message& msg);
+    virtual bool SendCreditMessage(Message* msg);
+    virtual bool OnSendCreditAdded();
 
 private slots:
     void OnReadyRead();
@@ -80,6 +97,10 @@ private slots:
 
 private:
     QLocalSocket* client_;
+    qint64 peer_pid_;
+
+    // Messages waiting for credit of the server, written as it grants more.
+    base::circular_deque<scoped_refptr<base::RefCountedMemory> > blocked_queue_;
 
 };
 
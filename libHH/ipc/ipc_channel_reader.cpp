@@ -1,4 +1,7 @@
 #include "ipc/ipc_channel_reader.h"
+
+#include <functional>
+
 #include "ipc/ipc_listener.h"
 #include "ipc/ipc_message.h"
 
@@ -8,7 +11,9 @@ namespace internal {
 
 ChannelReader::ChannelReader(Listener* listener)
 	: listener_(listener),
-	  max_input_buffer_size_(Channel::kMaximumReadBufferSize)
+	  max_input_buffer_size_(Channel::kMaximumReadBufferSize),
+	  credit_token_(new CreditToken(this)),
+	  credit_error_(false)
 {
 	memset(input_buf_, 0, sizeof(input_buf_));
 }
@@ -16,6 +21,7 @@ ChannelReader::ChannelReader(Listener* listener)
 
 ChannelReader::~ChannelReader()
 {
+	credit_token_->reader = NULL;
 }
 
 ChannelReader::DispatchState ChannelReader::ProcessIncomingMessages()
@@ -144,25 +150,107 @@ bool ChannelReader::HandleTranslatedMessage(Message* translated_message)
 		return true;
 	}
 
+	if (FlowControl::IsCreditMessage(*translated_message))
+	{
+		return flow_control_.HandleCreditMessage(*translated_message) &&
+			   OnSendCreditAdded();
+	}
+
+	if (translated_message->routing_id() == MSG_ROUTING_NONE &&
+		translated_message->type() == Channel::CHUNK_MESSAGE_TYPE)
+	{
+		return HandleChunk(*translated_message);
+	}
+
     translated_message->set_sender_pid(GetSenderPID());
 
 	std::unique_ptr<Message> m(new Message(*translated_message));
-	queued_messages_.push_back(m.release());
+	if (!GetAttachments(m.get()))
+		return false;
+
+	queued_messages_.push_back(std::move(m));
 	return true;
 }
 
+bool ChannelReader::HandleChunk(const Message& chunk)
+{
+	std::string& buf = chunk_bufs_[chunk.is_high_priority() ? 1 : 0];
+	if (!CheckMessageSize(buf.size() + chunk.payload_size()))
+		return false;
+
+	buf.append(chunk.payload(), chunk.payload_size());
+
+	Message::NextMessageInfo info;
+	Message::FindNext(buf.data(), buf.data() + buf.size(), &info);
+	if (!info.message_found)
+	{
+		// The header of the message came with the first chunk, the buffer
+		// grows once.
+		if (info.message_size)
+		{
+			if (!CheckMessageSize(info.message_size))
+				return false;
+			if (buf.capacity() < info.message_size)
+				buf.reserve(info.message_size);
+		}
+		return true;
+	}
+
+	// The chunks carry one message, and no chunks of their own.
+	Message message(buf.data(), static_cast<int>(buf.size()));
+	bool ok = info.message_end == buf.data() + buf.size() &&
+			  message.type() != Channel::CHUNK_MESSAGE_TYPE &&
+			  HandleTranslatedMessage(&message);
+
+	std::string().swap(buf);
+	return ok;
+}
+
+bool ChannelReader::GetAttachments(Message* msg)
+{
+#if defined(OS_POSIX)
+	return msg->header()->num_fds == 0;
+#else
+	return true;
+#endif
+}
+
 void ChannelReader::DispatchMessage(Message* msg)
 {
-	listener_->OnMessageReceived(*msg);
+	if (!FlowControl::TakesCredit(*msg))
+	{
+		listener_->OnMessageReceived(*msg);
+		return;
+	}
+
+	// The peer may send as much again once the listener is done with it,
+	// which may be on another thread after this returns.
+	base::Closure consumed = std::bind(&ChannelReader::OnMessageConsumed,
+									   credit_token_, msg->size());
+	listener_->OnMessageReceivedDeferred(*msg, consumed);
+}
+
+// static
+void ChannelReader::OnMessageConsumed(const scoped_refptr<CreditToken>& token, size_t size)
+{
+	ChannelReader* reader = token->reader;
+	if (!reader)
+		return;
+
+	std::unique_ptr<Message> credit = reader->flow_control_.OnMessageConsumed(size);
+	if (credit && !reader->SendCreditMessage(credit.release()))
+		reader->credit_error_ = true;
 }
 
 ChannelReader::DispatchState ChannelReader::DispatchMessages()
 {
 	while (!queued_messages_.empty())
 	{
-		Message *m = queued_messages_.front();
-		DispatchMessage(m);
-        queued_messages_.erase(queued_messages_.begin());
+		std::unique_ptr<Message> m(std::move(queued_messages_.front()));
+		queued_messages_.pop_front();
+		DispatchMessage(m.get());
+		if (credit_error_)
+			return DISPATCH_ERROR;
 	}
     return DISPATCH_FINISHED;
 }
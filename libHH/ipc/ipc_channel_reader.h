@@ -1,11 +1,14 @@
 #ifndef ipc_channel_reader_h__
 #define ipc_channel_reader_h__
 
+#include <memory>
 #include <string>
 #include <vector>
 
-#include "base/memory/scoped_vector.h"
+#include "base/containers/circular_deque.h"
+#include "base/memory/ref_counted.h"
 #include "ipc/ipc_channel.h"
+#include "ipc/ipc_flow_control.h"
 #include "ipc/ipc_message.h"
 
 
@@ -73,19 +76,58 @@ protected:
 
 	virtual void HandleInternalMessage(const Message& msg) = 0;
 
+    // Gives |msg| the descriptors its header says it carries. Returns false
+    // if they did not arrive, the channel is then broken. Channels that pass
+    // no descriptors keep the default, which only takes messages without.
+    virtual bool GetAttachments(Message* msg);
+
     virtual void DispatchMessage(Message* msg);
 
     virtual base::ProcessId GetSenderPID() = 0;
 
+    // Sends the credit message |msg| ahead of the messages waiting for
+    // credit, it takes none itself. Returns false on channel error.
+    virtual bool SendCreditMessage(Message* msg) = 0;
+
+    // Called when the peer granted credit, sends the messages that waited
+    // for it. Returns false on channel error.
+    virtual bool OnSendCreditAdded() = 0;
+
+    // Credit of both directions, the channel takes credit for each message
+    // it sends. The reader accounts the received ones.
+    FlowControl* flow_control() { return &flow_control_; }
+
 private:
 	bool TranslateInputData(const char* input_data, int input_data_len);
 	
     bool HandleTranslatedMessage(Message* translated_message);
+
+    // Adds |chunk| to the message it is a piece of, handles the message
+    // once complete.
+    bool HandleChunk(const Message& chunk);
 	
     DispatchState DispatchMessages();
 	
 	bool CheckMessageSize(size_t size);
 
+    // The callbacks that report dispatched messages consumed hold this
+    // instead of the reader. It is cleared when the reader goes away, a
+    // report coming in later does nothing.
+    struct CreditToken : public base::RefCountedThreadSafe<CreditToken>
+    {
+        explicit CreditToken(ChannelReader* reader) : reader(reader) {}
+
+        ChannelReader* reader;
+
+    private:
+        friend class base::RefCountedThreadSafe<CreditToken>;
+        ~CreditToken() {}
+    };
+
+    // Accounts a message of |size| bytes the listener is done with, grants
+    // the peer credit once enough was. Called on the channel's thread.
+    static void OnMessageConsumed(const scoped_refptr<CreditToken>& token, size_t size);
+
 private:
 	Listener* listener_;
 
@@ -95,7 +137,17 @@ private:
 
 	size_t max_input_buffer_size_;
 
-	ScopedVector<Message> queued_messages_;
+	base::circular_deque<std::unique_ptr<Message> > queued_messages_;
+
+	FlowControl flow_control_;
+
+	scoped_refptr<CreditToken> credit_token_;
+
+	// Sending a credit message failed, the next dispatch reports the error.
+	bool credit_error_;
+
+	// The message being received in chunks, of normal and of high priority.
+	std::string chunk_bufs_[2];
 
 };
 
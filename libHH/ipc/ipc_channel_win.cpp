@@ -34,6 +34,7 @@ ChannelWin::ChannelWin(const IPC::ChannelHandle& channel_handle, Mode mode,
       input_state_(this),
       output_state_(this),
       peer_pid_(base::kNullProcessId),
+      output_segment_(0),
       waiting_connect_(mode & MODE_SERVER),
       weak_factory_(this) 
 {
@@ -67,6 +68,20 @@ void ChannelWin::Close()
         output_queue_.pop();
         delete element;
     }
+
+    for (size_t i = 0; i < 2; ++i)
+    {
+        while (!priority_queues_[i].empty())
+        {
+            delete priority_queues_[i].front();
+            priority_queues_[i].pop_front();
+        }
+        while (!blocked_queues_[i].empty())
+        {
+            delete blocked_queues_[i].front();
+            blocked_queues_[i].pop_front();
+        }
+    }
 }
 
 bool ChannelWin::Send(Message* message) 
@@ -88,9 +103,25 @@ bool ChannelWin::Send(Message* message)
 
 bool ChannelWin::ProcessMessageForDelivery(Message* message)
 {
+    bool takes_credit = internal::FlowControl::TakesCredit(*message);
+
     // OutputElement  Message 
     OutputElement* element = new OutputElement(message);
-    output_queue_.push(element);
+    bool high_priority = element->is_high_priority();
+
+    // Messages of a priority keep their order, the ones after a message
+    // without credit wait as well.
+    if (takes_credit &&
+        (!blocked_queues_[high_priority].empty() || !flow_control()->TakeCredit(element->size())))
+    {
+        bool was_blocked = !blocked_queues_[0].empty() || !blocked_queues_[1].empty();
+        blocked_queues_[high_priority].push_back(element);
+        if (!was_blocked)
+            listener()->OnSendBufferFull(peer_pid_);
+        return true;
+    }
+
+    OutputElement::Split(element, &priority_queues_[high_priority]);
 
     // ensure waiting to write
     if (!waiting_connect_) 
@@ -108,7 +139,7 @@ bool ChannelWin::ProcessMessageForDelivery(Message* message)
 void ChannelWin::FlushPrelimQueue() 
 {
     // չܵû֮ǰ淢͵Message
-    std::queue<Message*> prelim_queue;
+    std::queue<Message*, base::circular_deque<Message*> > prelim_queue;
     prelim_queue_.swap(prelim_queue);
 
     while (!prelim_queue.empty()) 
@@ -202,6 +233,53 @@ base::ProcessId ChannelWin::GetSenderPID()
     return GetPeerPID();
 }
 
+bool ChannelWin::SendCreditMessage(Message* msg)
+{
+    output_queue_.push(new OutputElement(msg));
+    if (waiting_connect_ || output_state_.is_pending)
+        return true;
+    return ProcessOutgoingMessages(NULL, 0);
+}
+
+bool ChannelWin::OnSendCreditAdded()
+{
+    if (blocked_queues_[0].empty() && blocked_queues_[1].empty())
+        return true;
+
+    for (int high_priority = 1; high_priority >= 0; --high_priority)
+    {
+        base::circular_deque<OutputElement*>& blocked = blocked_queues_[high_priority];
+        while (!blocked.empty() && flow_control()->TakeCredit(blocked.front()->size()))
+        {
+            OutputElement::Split(blocked.front(), &priority_queues_[high_priority]);
+            blocked.pop_front();
+        }
+    }
+
+    if (!waiting_connect_ && !output_state_.is_pending && !ProcessOutgoingMessages(NULL, 0))
+        return false;
+
+    if (blocked_queues_[0].empty() && blocked_queues_[1].empty())
+        listener()->OnSendBufferDrained(peer_pid_);
+    return true;
+}
+
+bool ChannelWin::FillOutputQueue()
+{
+    if (output_queue_.empty())
+    {
+        base::circular_deque<OutputElement*>* queue = &priority_queues_[1];
+        if (queue->empty())
+            queue = &priority_queues_[0];
+        if (!queue->empty())
+        {
+            output_queue_.push(queue->front());
+            queue->pop_front();
+        }
+    }
+    return !output_queue_.empty();
+}
+
 // static
 const std::string ChannelWin::PipeName(const std::string& channel_id) 
 {
@@ -336,22 +414,26 @@ bool ChannelWin::ProcessOutgoingMessages(base::MessageLoopForIO::IOContext* cont
 
         // ɾһѾ͵ element
         OutputElement* element = output_queue_.front();
-        output_queue_.pop();
-        delete element;
+        if (++output_segment_ == element->segments().size())
+        {
+            output_queue_.pop();
+            delete element;
+            output_segment_ = 0;
+        }
     }
 
-    if (output_queue_.empty())
+    if (!FillOutputQueue())
         return true;
 
     if (!pipe_.IsValid())
         return false;
 
     // Write to pipe...
-    OutputElement* element = output_queue_.front();
+    const Message::Segment& segment = output_queue_.front()->segments()[output_segment_];
 
     BOOL ok = WriteFile(pipe_.Get(),
-                        element->data(),
-                        static_cast<uint32_t>(element->size()),
+                        segment.data,
+                        static_cast<uint32_t>(segment.size),
                         NULL,
                         &output_state_.context.overlapped);
     if (!ok) 
@@ -384,7 +466,7 @@ void ChannelWin::OnIOCompleted(base::MessageLoopForIO::IOContext* context,
                 return;
 
             // We may have some messages queued up to send...
-            if (!output_queue_.empty() && !output_state_.is_pending)
+            if (!output_state_.is_pending)
                 ProcessOutgoingMessages(NULL, 0);
 
             if (input_state_.is_pending)
@@ -8,6 +8,7 @@
 #include <queue>
 #include <string>
 
+#include "base/containers/circular_deque.h"
 #include "base/macros.h"
 #include "base/memory/weak_ptr.h"
 #include "base/win/scoped_handle.h"
@@ -41,6 +42,8 @@ private:
     ReadState ReadData(char* buffer, int buffer_len, int* bytes_read) override;
     void HandleInternalMessage(const Message& msg) override;
     base::ProcessId GetSenderPID() override;
+    bool SendCreditMessage(Message* msg) override;
+    bool OnSendCreditAdded() override;
 
     static const std::string PipeName(const std::string& channel_id);
     bool CreatePipe(const IPC::ChannelHandle &channel_handle, Mode mode);
@@ -53,9 +56,16 @@ private:
     // If |message| has brokerable attachments, those attachments are passed to
     // the AttachmentBroker (which in turn invokes Send()), so this method must
     // be re-entrant.
-    // Adds |message| to |output_queue_| and calls ProcessOutgoingMessages().
+    // Adds |message| to its priority queue and calls
+    // ProcessOutgoingMessages(), or to its blocked queue without credit for
+    // it.
     bool ProcessMessageForDelivery(Message* message);
 
+    // Moves the next element of the priority queues, high priority first,
+    // to |output_queue_| once it is empty. Returns false if there is
+    // nothing to write.
+    bool FillOutputQueue();
+
     // Moves all messages from |prelim_queue_| to |output_queue_| by calling
     // ProcessMessageForDelivery().
     void FlushPrelimQueue();
@@ -88,10 +98,24 @@ private:
     // configured.
     // As soon as |peer_pid| has been configured, there is no longer any need for
     // |prelim_queue_|. All messages are flushed, and no new messages are added.
-    std::queue<Message*> prelim_queue_;
+    std::queue<Message*, base::circular_deque<Message*> > prelim_queue_;
 
     // Messages to be sent are queued here.
-    std::queue<OutputElement*> output_queue_;
+    std::queue<OutputElement*, base::circular_deque<OutputElement*> > output_queue_;
+
+    // Messages and chunks waiting for |output_queue_|, indexed by
+    // OutputElement::is_high_priority(). A pipe write takes one segment, the
+    // next element is picked when the one before is written.
+    base::circular_deque<OutputElement*> priority_queues_[2];
+
+    // Messages waiting for credit of the peer, in order, indexed like
+    // |priority_queues_|. They move there as credit comes in.
+    base::circular_deque<OutputElement*> blocked_queues_[2];
+
+    // Segment of the front element of |output_queue_| being written. Pipes
+    // have no gather write, a message with external data takes one WriteFile
+    // per segment.
+    size_t output_segment_;
 
     // In server-mode, we have to wait for the client to connect before we
     // can begin reading.  We make use of the input_state_ when performing
@@ -0,0 +1,97 @@
+#include "ipc/ipc_flow_control.h"
+
+#include <algorithm>
+
+#include "ipc/ipc_channel.h"
+#include "ipc/ipc_message.h"
+
+namespace IPC {
+
+namespace internal {
+
+namespace {
+
+// What a message of |size| bytes costs, the same on both sides.
+uint32_t GetCharge(size_t size)
+{
+    return static_cast<uint32_t>(std::min<size_t>(size, Channel::kReceiveWindowBytes / 2));
+}
+
+}  // namespace
+
+FlowControl::FlowControl()
+    : send_bytes_(Channel::kReceiveWindowBytes),
+      send_messages_(Channel::kReceiveWindowMessages),
+      consumed_bytes_(0),
+      consumed_messages_(0)
+{
+
+}
+
+FlowControl::~FlowControl()
+{
+
+}
+
+bool FlowControl::TakeCredit(size_t size)
+{
+    uint32_t charge = GetCharge(size);
+    if (send_bytes_ < charge || send_messages_ < 1)
+        return false;
+
+    send_bytes_ -= charge;
+    --send_messages_;
+    return true;
+}
+
+bool FlowControl::HandleCreditMessage(const Message& msg)
+{
+    base::PickleIterator iter(msg);
+    uint32_t bytes = 0;
+    uint32_t messages = 0;
+    if (!iter.ReadUInt32(&bytes) || !iter.ReadUInt32(&messages))
+        return false;
+
+    // The peer returns what was sent, never more than the window.
+    if (send_bytes_ + bytes > static_cast<int64_t>(Channel::kReceiveWindowBytes) ||
+        send_messages_ + messages > static_cast<int64_t>(Channel::kReceiveWindowMessages))
+        return false;
+
+    send_bytes_ += bytes;
+    send_messages_ += messages;
+    return true;
+}
+
+std::unique_ptr<Message> FlowControl::OnMessageConsumed(size_t size)
+{
+    consumed_bytes_ += GetCharge(size);
+    ++consumed_messages_;
+
+    if (consumed_bytes_ < Channel::kReceiveWindowBytes / 2 &&
+        consumed_messages_ < Channel::kReceiveWindowMessages / 2)
+        return std::unique_ptr<Message>();
+
+    std::unique_ptr<Message> credit(new Message(MSG_ROUTING_NONE, Channel::CREDIT_MESSAGE_TYPE));
+    credit->WriteUInt32(consumed_bytes_);
+    credit->WriteUInt32(consumed_messages_);
+    consumed_bytes_ = 0;
+    consumed_messages_ = 0;
+    return credit;
+}
+
+// static
+bool FlowControl::IsCreditMessage(const Message& msg)
+{
+    return msg.routing_id() == MSG_ROUTING_NONE &&
+           msg.type() == Channel::CREDIT_MESSAGE_TYPE;
+}
+
+// static
+bool FlowControl::TakesCredit(const Message& msg)
+{
+    return !msg.is_sync() && !msg.is_reply();
+}
+
+}  // namespace internal
+
+}  // namespace IPC
@@ -0,0 +1,69 @@
+#ifndef IPC_IPC_FLOW_CONTROL_H_
+#define IPC_IPC_FLOW_CONTROL_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <memory>
+
+#include "base/macros.h"
+#include "ipc/ipc_export.h"
+
+namespace IPC {
+
+class Message;
+
+namespace internal {
+
+// Credit based flow control of one connection, both directions. A sender
+// may have Channel::kReceiveWindowBytes and kReceiveWindowMessages in flight,
+// the receiver grants credit back in a CREDIT_MESSAGE_TYPE message once its
+// listener has taken half a window. Messages without credit wait in the
+// sending channel, which tells its listener through OnSendBufferFull() and
+// OnSendBufferDrained().
+//
+// A message counts half a window at most, so the receiver always gets to
+// grant before a big message could wait forever. Internal messages do not
+// count at all, nor do sync messages and replies, see TakesCredit().
+class IPC_EXPORT FlowControl
+{
+public:
+    FlowControl();
+    ~FlowControl();
+
+    // Takes credit for a message of |size| bytes on the wire. Returns false
+    // if the peer did not grant enough, the message waits until it does.
+    bool TakeCredit(size_t size);
+
+    // Adds the credit |msg| grants. Returns false if it is malformed.
+    bool HandleCreditMessage(const Message& msg);
+
+    // Accounts a message of |size| bytes the listener is done with. Returns
+    // the credit message to send back once enough was, NULL otherwise.
+    std::unique_ptr<Message> OnMessageConsumed(size_t size);
+
+    static bool IsCreditMessage(const Message& msg);
+
+    // Whether |msg| counts against the window. A listener blocked in
+    // SyncChannel::Send() takes nothing until its reply arrives, so sync
+    // messages and replies go without credit, ahead of the messages waiting
+    // for it.
+    static bool TakesCredit(const Message& msg);
+
+private:
+    // Credit of the peer left for sending.
+    int64_t send_bytes_;
+    int64_t send_messages_;
+
+    // Taken by the listener and not granted back yet.
+    uint32_t consumed_bytes_;
+    uint32_t consumed_messages_;
+
+    DISALLOW_COPY_AND_ASSIGN(FlowControl);
+};
+
+}  // namespace internal
+
+}  // namespace IPC
+
+#endif  // IPC_IPC_FLOW_CONTROL_H_
@@ -3,6 +3,7 @@
 
 #include <stdint.h>
 
+#include "base/callback.h"
 #include "ipc/ipc_export.h"
 
 namespace IPC 
@@ -18,12 +19,32 @@ public:
 
 public:
 	virtual bool OnMessageReceived(const Message& message) = 0;
+
+	// Called by the channel instead of OnMessageReceived(). The peer gets
+	// credit for |message| back once |consumed| runs, see
+	// Channel::kReceiveWindowBytes. A listener that hands messages on to
+	// another thread runs it later, on the channel's thread, once that thread
+	// is done with the message.
+	virtual bool OnMessageReceivedDeferred(const Message& message, const base::Closure& consumed)
+	{
+		bool handled = OnMessageReceived(message);
+		consumed.Run();
+		return handled;
+	}
 	
-	virtual void OnChannelConnected(int32_t peer_pid) {}
+	virtual void OnChannelConnected(int32_t /*peer_pid*/) {}
 
 	virtual void OnChannelError() {}
 	
-	virtual void OnBadMessageReceived(const Message& message) {}
+	virtual void OnBadMessageReceived(const Message& /*message*/) {}
+
+	// Called when messages to the peer start to wait in the channel for
+	// credit, the peer reads slower than they are sent. May be called from
+	// inside Send().
+	virtual void OnSendBufferFull(int32_t) {}
+
+	// Called when the messages that waited for credit are on their way.
+	virtual void OnSendBufferDrained(int32_t) {}
 	  
 };
 	
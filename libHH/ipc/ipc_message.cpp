@@ -1,5 +1,13 @@
 #include "ipc_message.h"
 
+#include <limits.h>
+
+#include "base/bits.h"
+
+#if defined(OS_POSIX)
+#include "ipc/ipc_message_attachment_set.h"
+#endif
+
 
 namespace IPC {
 
@@ -9,8 +17,13 @@ Message::Message()
 	header()->routing = 0;
 	header()->type = 0;
 	header()->flags = 0;
+#if defined(OS_POSIX)
+	header()->num_fds = 0;
+	header()->pad = 0;
+#endif
 
 	sender_pid_ = 0;
+	external_size_ = 0;
 }
 
 Message::Message(int32_t routing_id, uint32_t type)
@@ -19,25 +32,69 @@ Message::Message(int32_t routing_id, uint32_t type)
 	header()->routing = routing_id;
 	header()->type = type;
 	header()->flags = 0;
+#if defined(OS_POSIX)
+	header()->num_fds = 0;
+	header()->pad = 0;
+#endif
 
 	sender_pid_ = 0;
+	external_size_ = 0;
 }
 
 Message::Message(const char* data, int data_len)
 	: base::Pickle(data, data_len)
 {
 	sender_pid_ = 0;
+	external_size_ = 0;
 }
 
 Message::Message(const Message& other)
-	: base::Pickle(other)
+	: base::Pickle(other),
+	  external_data_(other.external_data_)
+#if defined(OS_POSIX)
+	, attachment_set_(other.attachment_set_)
+#endif
 {
 	sender_pid_ = other.sender_pid_;
+	external_size_ = other.external_size_;
 }
 
 Message& Message::operator=(const Message& other)
 {
 	*static_cast<base::Pickle*>(this) = other;
+	sender_pid_ = other.sender_pid_;
+	external_data_ = other.external_data_;
+	external_size_ = other.external_size_;
+#if defined(OS_POSIX)
+	attachment_set_ = other.attachment_set_;
+#endif
+	return *this;
+}
+
+Message::Message(Message&& other)
+	: base::Pickle(std::move(other)),
+	  external_data_(std::move(other.external_data_))
+#if defined(OS_POSIX)
+	, attachment_set_(std::move(other.attachment_set_))
+#endif
+{
+	sender_pid_ = other.sender_pid_;
+	external_size_ = other.external_size_;
+	other.external_data_.clear();
+	other.external_size_ = 0;
+}
+
+Message& Message::operator=(Message&& other)
+{
+	*static_cast<base::Pickle*>(this) = std::move(other);
+	sender_pid_ = other.sender_pid_;
+	external_data_ = std::move(other.external_data_);
+	external_size_ = other.external_size_;
+	other.external_data_.clear();
+	other.external_size_ = 0;
+#if defined(OS_POSIX)
+	attachment_set_ = std::move(other.attachment_set_);
+#endif
 	return *this;
 }
 
@@ -52,6 +109,99 @@ void Message::SetHeaderValues(int32_t routing, uint32_t type, uint32_t flags)
 	header()->flags = flags;
 }
 
+bool Message::WriteExternalData(const scoped_refptr<base::RefCountedMemory>& data)
+{
+	size_t size = data ? data->size() : 0;
+	if (size > static_cast<size_t>(INT_MAX) - external_size_ || !WriteInt(static_cast<int>(size)))
+		return false;
+	if (!size)
+		return true;
+
+	ExternalData external = { payload_size(), data };
+	external_data_.push_back(external);
+	external_size_ += base::bits::Align(size, sizeof(uint32_t));
+	return true;
+}
+
+void Message::GetSegments(std::vector<Segment>* segments)
+{
+	if (external_data_.empty())
+	{
+		Segment segment = { data(), size() };
+		segments->push_back(segment);
+		return;
+	}
+
+	static const char kZeroPadding[sizeof(uint32_t)] = { 0 };
+
+	wire_header_ = *header();
+	wire_header_.payload_size = static_cast<uint32_t>(payload_size() + external_size_);
+	Segment header_segment = { &wire_header_, sizeof(Header) };
+	segments->push_back(header_segment);
+
+	size_t offset = 0;
+	for (size_t i = 0; i < external_data_.size(); ++i)
+	{
+		const ExternalData& external = external_data_[i];
+		if (external.offset > offset)
+		{
+			Segment segment = { payload() + offset, external.offset - offset };
+			segments->push_back(segment);
+			offset = external.offset;
+		}
+
+		size_t size = external.data->size();
+		Segment segment = { external.data->front(), size };
+		segments->push_back(segment);
+
+		size_t padding = base::bits::Align(size, sizeof(uint32_t)) - size;
+		if (padding)
+		{
+			Segment padding_segment = { kZeroPadding, padding };
+			segments->push_back(padding_segment);
+		}
+	}
+
+	if (payload_size() > offset)
+	{
+		Segment segment = { payload() + offset, payload_size() - offset };
+		segments->push_back(segment);
+	}
+}
+
+#if defined(OS_POSIX)
+bool Message::WriteFileDescriptor(base::ScopedFD fd)
+{
+	if (!attachment_set()->AddDescriptor(std::move(fd)))
+		return false;
+
+	header()->num_fds = static_cast<uint16_t>(attachment_set_->size());
+	return WriteInt(static_cast<int>(attachment_set_->size() - 1));
+}
+
+bool Message::ReadFileDescriptor(base::PickleIterator* iter, base::ScopedFD* fd) const
+{
+	int index;
+	if (!iter->ReadInt(&index) || index < 0 || !attachment_set_)
+		return false;
+
+	*fd = attachment_set_->TakeDescriptor(index);
+	return fd->is_valid();
+}
+
+bool Message::HasFileDescriptors() const
+{
+	return attachment_set_ && !attachment_set_->empty();
+}
+
+MessageAttachmentSet* Message::attachment_set()
+{
+	if (!attachment_set_)
+		attachment_set_ = new MessageAttachmentSet;
+	return attachment_set_.get();
+}
+#endif
+
 void Message::FindNext(const char* range_start, const char* range_end, NextMessageInfo* info)
 {
 	info->message_found = false;
@@ -1,11 +1,22 @@
 #ifndef IPC_MESSAGE_H__
 #define IPC_MESSAGE_H__
 
+#include <vector>
+
+#include "base/memory/ref_counted.h"
+#include "base/memory/ref_counted_memory.h"
 #include "base/pickle.h"
+#include "build/build_config.h"
 #include "ipc/ipc_export.h"
 
+#if defined(OS_POSIX)
+#include "base/files/scoped_file.h"
+#endif
+
 namespace IPC {
 
+class MessageAttachmentSet;
+
 class IPC_EXPORT Message : public base::Pickle
 {
 public:
@@ -13,6 +24,13 @@ public:
 	{
 		SYNC_BIT      = 0x01,
 		REPLY_BIT     = 0x02,
+		// Parameters use the compact encoding, see Pickle::WriteVarUInt64().
+		COMPACT_BIT   = 0x04,
+		// The receiver of a sync message could not read it, the reply has
+		// no parameters.
+		REPLY_ERROR_BIT = 0x08,
+		// Sent ahead of the messages without it, see Channel::kMaximumChunkSize.
+		HIGH_PRIORITY_BIT = 0x10,
 	};
 
 public:
@@ -26,6 +44,10 @@ public:
 	Message(const Message& other);
 	Message& operator=(const Message& other);
 
+	// Moves never allocate, prefer them when the source is not needed anymore.
+	Message(Message&& other);
+	Message& operator=(Message&& other);
+
 	virtual ~Message();
 
 	void set_sync() {
@@ -39,9 +61,33 @@ public:
 		header()->flags |= REPLY_BIT;
 	}
 	bool is_reply() const {
-		return (header()->flags * REPLY_BIT) != 0;
+		return (header()->flags & REPLY_BIT) != 0;
+	}
+
+	void set_reply_error() {
+		header()->flags |= REPLY_ERROR_BIT;
+	}
+	bool is_reply_error() const {
+		return (header()->flags & REPLY_ERROR_BIT) != 0;
 	}
 
+	// Must be set before the first parameter is written.
+	void set_compact() {
+		header()->flags |= COMPACT_BIT;
+	}
+	bool is_compact() const {
+		return (header()->flags & COMPACT_BIT) != 0;
+	}
+
+	// For control messages that must not wait for bulk traffic. The order of
+	// messages is kept among the ones of the same priority only.
+	void set_high_priority() {
+		header()->flags |= HIGH_PRIORITY_BIT;
+	}
+	bool is_high_priority() const {
+		return (header()->flags & HIGH_PRIORITY_BIT) != 0;
+	}
+
 	uint32_t type() const {
 		return header()->type;
 	}
@@ -60,6 +106,44 @@ public:
 	// Sets all the given header values. The message should be empty at this call .
 	void SetHeaderValues(int32_t routing, uint32_t type, uint32_t flags);
 
+	// Writes |data| like WriteData() without copying it. The message keeps a
+	// reference and the channel sends the bytes straight from |data|, which
+	// must not change until the message is sent. Meant for blobs of some
+	// kilobytes and more. The receiver gets an ordinary message, read it
+	// back with ReadData(). Before it went through a channel the message
+	// itself only holds the length, not the bytes.
+	bool WriteExternalData(const scoped_refptr<base::RefCountedMemory>& data);
+
+	bool has_external_data() const { return !external_data_.empty(); }
+
+	// One contiguous piece of the bytes of the message on the wire.
+	struct Segment
+	{
+		const void* data;
+		size_t size;
+	};
+
+	// Appends the wire bytes of the message to |segments|, in order. That is
+	// data() and size() unless the message has external data, then the
+	// header, the inline pieces and the external blobs take turns. The
+	// segments are valid until the message changes.
+	void GetSegments(std::vector<Segment>* segments);
+
+#if defined(OS_POSIX)
+	// Passes |fd| along with the message and writes its index to the
+	// payload. |fd| is closed when this fails.
+	bool WriteFileDescriptor(base::ScopedFD fd);
+
+	// Reads an index written by WriteFileDescriptor() and takes the
+	// descriptor out of the message.
+	bool ReadFileDescriptor(base::PickleIterator* iter, base::ScopedFD* fd) const;
+
+	bool HasFileDescriptors() const;
+
+	// The descriptors of the message, created on first use.
+	MessageAttachmentSet* attachment_set();
+#endif
+
 	template<class T, class S, class P>
 	static bool Dispatch(const Message* msg, T* obj, S* sender, P* parameter, void (T::*func)()) 
 	{
@@ -100,6 +184,10 @@ public:
 		int32_t routing;	//process id
 		uint32_t type;		//message type
 		uint32_t flags;
+#if defined(OS_POSIX)
+		uint16_t num_fds;	// descriptors passed along with the message
+		uint16_t pad;
+#endif
 	};
 #pragma pack(pop)
 
@@ -111,8 +199,30 @@ public:
 	}
 
 private:
+	// A blob written by WriteExternalData(), sent before the inline payload
+	// bytes from |offset| on.
+	struct ExternalData
+	{
+		size_t offset;
+		scoped_refptr<base::RefCountedMemory> data;
+	};
+
 	int32_t sender_pid_;
 
+	std::vector<ExternalData> external_data_;
+
+	// Bytes the external data adds to the payload, padding included.
+	size_t external_size_;
+
+	// Copy of the header with the payload size on the wire, used by
+	// GetSegments().
+	Header wire_header_;
+
+#if defined(OS_POSIX)
+	// Shared by the copies of the message.
+	scoped_refptr<MessageAttachmentSet> attachment_set_;
+#endif
+
 };
 
 }  //namespace IPC
@@ -0,0 +1,33 @@
+#include "ipc/ipc_message_attachment_set.h"
+
+#include <utility>
+
+namespace IPC {
+
+MessageAttachmentSet::MessageAttachmentSet()
+{
+
+}
+
+MessageAttachmentSet::~MessageAttachmentSet()
+{
+
+}
+
+bool MessageAttachmentSet::AddDescriptor(base::ScopedFD fd)
+{
+	if (descriptors_.size() >= kMaxDescriptorsPerMessage)
+		return false;
+
+	descriptors_.push_back(std::move(fd));
+	return true;
+}
+
+base::ScopedFD MessageAttachmentSet::TakeDescriptor(size_t index)
+{
+	if (index >= descriptors_.size())
+		return base::ScopedFD();
+	return std::move(descriptors_[index]);
+}
+
+}  // namespace IPC
@@ -0,0 +1,52 @@
+#ifndef IPC_IPC_MESSAGE_ATTACHMENT_SET_H_
+#define IPC_IPC_MESSAGE_ATTACHMENT_SET_H_
+
+#include <stddef.h>
+
+#include <vector>
+
+#include "base/files/scoped_file.h"
+#include "base/macros.h"
+#include "base/memory/ref_counted.h"
+#include "ipc/ipc_export.h"
+
+namespace IPC {
+
+// File descriptors passed along with a message, POSIX only. The payload
+// holds their index in the set. The set owns them until they are taken out
+// of it, copies of a message share the set.
+class IPC_EXPORT MessageAttachmentSet
+	: public base::RefCountedThreadSafe<MessageAttachmentSet>
+{
+public:
+	// Kept well below the SCM_RIGHTS limit of one sendmsg().
+	static const size_t kMaxDescriptorsPerMessage = 64;
+
+	MessageAttachmentSet();
+
+	// Adds |fd|, its index is size() before the call. Returns false and
+	// closes |fd| if the set is full.
+	bool AddDescriptor(base::ScopedFD fd);
+
+	// Takes the descriptor at |index| out of the set. Returns an invalid one
+	// if there is none or it was taken already.
+	base::ScopedFD TakeDescriptor(size_t index);
+
+	// The descriptor at |index| to send, still owned by the set.
+	int descriptor(size_t index) const { return descriptors_[index].get(); }
+
+	size_t size() const { return descriptors_.size(); }
+	bool empty() const { return descriptors_.empty(); }
+
+private:
+	friend class base::RefCountedThreadSafe<MessageAttachmentSet>;
+	~MessageAttachmentSet();
+
+	std::vector<base::ScopedFD> descriptors_;
+
+	DISALLOW_COPY_AND_ASSIGN(MessageAttachmentSet);
+};
+
+}  // namespace IPC
+
+#endif  // IPC_IPC_MESSAGE_ATTACHMENT_SET_H_
@@ -73,89 +73,296 @@
 #define IPC_MESSAGE_ROUTED5(msg_class, type1, type2, type3, type4, type5) \
 	IPC_MESSAGE_DECL(ASYNC, ROUTED, msg_class, 5, 0, (type1, type2, type3, type4, type5), ())
 
+// Same as above, the parameters use the compact encoding (varints, no
+// padding). Meant for messages made mostly of small integers. Receivers
+// read both encodings, but a peer built before the encoding existed cannot
+// read these.
+#define IPC_COMPACT_MESSAGE_CONTROL1(msg_class, type1) \
+	IPC_MESSAGE_DECL(COMPACT, CONTROL, msg_class, 1, 0, (type1), ())
+
+#define IPC_COMPACT_MESSAGE_CONTROL2(msg_class, type1, type2) \
+	IPC_MESSAGE_DECL(COMPACT, CONTROL, msg_class, 2, 0, (type1, type2), ())
+
+#define IPC_COMPACT_MESSAGE_CONTROL3(msg_class, type1, type2, type3) \
+	IPC_MESSAGE_DECL(COMPACT, CONTROL, msg_class, 3, 0, (type1, type2, type3), ())
+
+#define IPC_COMPACT_MESSAGE_CONTROL4(msg_class, type1, type2, type3, type4) \
+	IPC_MESSAGE_DECL(COMPACT, CONTROL, msg_class, 4, 0, (type1, type2, type3, type4), ())
+
+#define IPC_COMPACT_MESSAGE_CONTROL5(msg_class, type1, type2, type3, type4, type5) \
+	IPC_MESSAGE_DECL(COMPACT, CONTROL, msg_class, 5, 0, (type1, type2, type3, type4, type5), ())
+
+#define IPC_COMPACT_MESSAGE_ROUTED1(msg_class, type1) \
+	IPC_MESSAGE_DECL(COMPACT, ROUTED, msg_class, 1, 0, (type1), ())
+
+#define IPC_COMPACT_MESSAGE_ROUTED2(msg_class, type1, type2) \
+	IPC_MESSAGE_DECL(COMPACT, ROUTED, msg_class, 2, 0, (type1, type2), ())
+
+#define IPC_COMPACT_MESSAGE_ROUTED3(msg_class, type1, type2, type3) \
+	IPC_MESSAGE_DECL(COMPACT, ROUTED, msg_class, 3, 0, (type1, type2, type3), ())
+
+#define IPC_COMPACT_MESSAGE_ROUTED4(msg_class, type1, type2, type3, type4) \
+	IPC_MESSAGE_DECL(COMPACT, ROUTED, msg_class, 4, 0, (type1, type2, type3, type4), ())
+
+#define IPC_COMPACT_MESSAGE_ROUTED5(msg_class, type1, type2, type3, type4, type5) \
+	IPC_MESSAGE_DECL(COMPACT, ROUTED, msg_class, 5, 0, (type1, type2, type3, type4, type5), ())
+
+// Sync messages: the sender blocks in SyncChannel::Send() until the
+// receiver's handler filled in the output parameters and they came back in
+// the reply. The handler takes the inputs and pointers to the outputs:
+//   IPC_SYNC_MESSAGE_CONTROL1_1(ViewHostMsg_GetCookie, std::string, std::string)
+//   void OnGetCookie(const std::string& url, std::string* cookie);
+// ChannelProxy::SendWithReply() sends them without blocking, the output
+// pointers are then NULL and the callback reads the reply with
+// msg_class::ReadReplyParam().
+#define IPC_SYNC_MESSAGE_CONTROL0_0(msg_class) \
+	IPC_MESSAGE_DECL(SYNC, CONTROL, msg_class, 0, 0, (), ())
+
+#define IPC_SYNC_MESSAGE_CONTROL0_1(msg_class, type1_out) \
+	IPC_MESSAGE_DECL(SYNC, CONTROL, msg_class, 0, 1, (), (type1_out))
+
+#define IPC_SYNC_MESSAGE_CONTROL0_2(msg_class, type1_out, type2_out) \
+	IPC_MESSAGE_DECL(SYNC, CONTROL, msg_class, 0, 2, (), (type1_out, type2_out))
+
+#define IPC_SYNC_MESSAGE_CONTROL0_3(msg_class, type1_out, type2_out, type3_out) \
+	IPC_MESSAGE_DECL(SYNC, CONTROL, msg_class, 0, 3, (), (type1_out, type2_out, type3_out))
+
+#define IPC_SYNC_MESSAGE_CONTROL0_4(msg_class, type1_out, type2_out, type3_out, type4_out) \
+	IPC_MESSAGE_DECL(SYNC, CONTROL, msg_class, 0, 4, (), (type1_out, type2_out, type3_out, type4_out))
+
+#define IPC_SYNC_MESSAGE_CONTROL1_0(msg_class, type1_in) \
+	IPC_MESSAGE_DECL(SYNC, CONTROL, msg_class, 1, 0, (type1_in), ())
+
+#define IPC_SYNC_MESSAGE_CONTROL1_1(msg_class, type1_in, type1_out) \
+	IPC_MESSAGE_DECL(SYNC, CONTROL, msg_class, 1, 1, (type1_in), (type1_out))
+
+#define IPC_SYNC_MESSAGE_CONTROL1_2(msg_class, type1_in, type1_out, type2_out) \
+	IPC_MESSAGE_DECL(SYNC, CONTROL, msg_class, 1, 2, (type1_in), (type1_out, type2_out))
+
+#define IPC_SYNC_MESSAGE_CONTROL1_3(msg_class, type1_in, type1_out, type2_out, type3_out) \
+	IPC_MESSAGE_DECL(SYNC, CONTROL, msg_class, 1, 3, (type1_in), (type1_out, type2_out, type3_out))
+
+#define IPC_SYNC_MESSAGE_CONTROL1_4(msg_class, type1_in, type1_out, type2_out, type3_out, type4_out) \
+	IPC_MESSAGE_DECL(SYNC, CONTROL, msg_class, 1, 4, (type1_in), (type1_out, type2_out, type3_out, type4_out))
+
+#define IPC_SYNC_MESSAGE_CONTROL2_0(msg_class, type1_in, type2_in) \
+	IPC_MESSAGE_DECL(SYNC, CONTROL, msg_class, 2, 0, (type1_in, type2_in), ())
+
+#define IPC_SYNC_MESSAGE_CONTROL2_1(msg_class, type1_in, type2_in, type1_out) \
+	IPC_MESSAGE_DECL(SYNC, CONTROL, msg_class, 2, 1, (type1_in, type2_in), (type1_out))
+
+#define IPC_SYNC_MESSAGE_CONTROL2_2(msg_class, type1_in, type2_in, type1_out, type2_out) \
+	IPC_MESSAGE_DECL(SYNC, CONTROL, msg_class, 2, 2, (type1_in, type2_in), (type1_out, type2_out))
+
+#define IPC_SYNC_MESSAGE_CONTROL2_3(msg_class, type1_in, type2_in, type1_out, type2_out, type3_out) \
+	IPC_MESSAGE_DECL(SYNC, CONTROL, msg_class, 2, 3, (type1_in, type2_in), (type1_out, type2_out, type3_out))
+
+#define IPC_SYNC_MESSAGE_CONTROL2_4(msg_class, type1_in, type2_in, type1_out, type2_out, type3_out, type4_out) \
+	IPC_MESSAGE_DECL(SYNC, CONTROL, msg_class, 2, 4, (type1_in, type2_in), (type1_out, type2_out, type3_out, type4_out))
+
+#define IPC_SYNC_MESSAGE_CONTROL3_0(msg_class, type1_in, type2_in, type3_in) \
+	IPC_MESSAGE_DECL(SYNC, CONTROL, msg_class, 3, 0, (type1_in, type2_in, type3_in), ())
+
+#define IPC_SYNC_MESSAGE_CONTROL3_1(msg_class, type1_in, type2_in, type3_in, type1_out) \
+	IPC_MESSAGE_DECL(SYNC, CONTROL, msg_class, 3, 1, (type1_in, type2_in, type3_in), (type1_out))
+
+#define IPC_SYNC_MESSAGE_CONTROL3_2(msg_class, type1_in, type2_in, type3_in, type1_out, type2_out) \
+	IPC_MESSAGE_DECL(SYNC, CONTROL, msg_class, 3, 2, (type1_in, type2_in, type3_in), (type1_out, type2_out))
+
+#define IPC_SYNC_MESSAGE_CONTROL3_3(msg_class, type1_in, type2_in, type3_in, type1_out, type2_out, type3_out) \
+	IPC_MESSAGE_DECL(SYNC, CONTROL, msg_class, 3, 3, (type1_in, type2_in, type3_in), (type1_out, type2_out, type3_out))
+
+#define IPC_SYNC_MESSAGE_CONTROL3_4(msg_class, type1_in, type2_in, type3_in, type1_out, type2_out, type3_out, type4_out) \
+	IPC_MESSAGE_DECL(SYNC, CONTROL, msg_class, 3, 4, (type1_in, type2_in, type3_in), (type1_out, type2_out, type3_out, type4_out))
+
+#define IPC_SYNC_MESSAGE_CONTROL4_0(msg_class, type1_in, type2_in, type3_in, type4_in) \
+	IPC_MESSAGE_DECL(SYNC, CONTROL, msg_class, 4, 0, (type1_in, type2_in, type3_in, type4_in), ())
+
+#define IPC_SYNC_MESSAGE_CONTROL4_1(msg_class, type1_in, type2_in, type3_in, type4_in, type1_out) \
+	IPC_MESSAGE_DECL(SYNC, CONTROL, msg_class, 4, 1, (type1_in, type2_in, type3_in, type4_in), (type1_out))
+
+#define IPC_SYNC_MESSAGE_CONTROL4_2(msg_class, type1_in, type2_in, type3_in, type4_in, type1_out, type2_out) \
+	IPC_MESSAGE_DECL(SYNC, CONTROL, msg_class, 4, 2, (type1_in, type2_in, type3_in, type4_in), (type1_out, type2_out))
+
+#define IPC_SYNC_MESSAGE_CONTROL4_3(msg_class, type1_in, type2_in, type3_in, type4_in, type1_out, type2_out, type3_out) \
+	IPC_MESSAGE_DECL(SYNC, CONTROL, msg_class, 4, 3, (type1_in, type2_in, type3_in, type4_in), (type1_out, type2_out, type3_out))
+
+#define IPC_SYNC_MESSAGE_CONTROL4_4(msg_class, type1_in, type2_in, type3_in, type4_in, type1_out, type2_out, type3_out, type4_out) \
+	IPC_MESSAGE_DECL(SYNC, CONTROL, msg_class, 4, 4, (type1_in, type2_in, type3_in, type4_in), (type1_out, type2_out, type3_out, type4_out))
+
+#define IPC_SYNC_MESSAGE_CONTROL5_0(msg_class, type1_in, type2_in, type3_in, type4_in, type5_in) \
+	IPC_MESSAGE_DECL(SYNC, CONTROL, msg_class, 5, 0, (type1_in, type2_in, type3_in, type4_in, type5_in), ())
+
+#define IPC_SYNC_MESSAGE_CONTROL5_1(msg_class, type1_in, type2_in, type3_in, type4_in, type5_in, type1_out) \
+	IPC_MESSAGE_DECL(SYNC, CONTROL, msg_class, 5, 1, (type1_in, type2_in, type3_in, type4_in, type5_in), (type1_out))
+
+#define IPC_SYNC_MESSAGE_CONTROL5_2(msg_class, type1_in, type2_in, type3_in, type4_in, type5_in, type1_out, type2_out) \
+	IPC_MESSAGE_DECL(SYNC, CONTROL, msg_class, 5, 2, (type1_in, type2_in, type3_in, type4_in, type5_in), (type1_out, type2_out))
+
+#define IPC_SYNC_MESSAGE_CONTROL5_3(msg_class, type1_in, type2_in, type3_in, type4_in, type5_in, type1_out, type2_out, type3_out) \
+	IPC_MESSAGE_DECL(SYNC, CONTROL, msg_class, 5, 3, (type1_in, type2_in, type3_in, type4_in, type5_in), (type1_out, type2_out, type3_out))
+
+#define IPC_SYNC_MESSAGE_CONTROL5_4(msg_class, type1_in, type2_in, type3_in, type4_in, type5_in, type1_out, type2_out, type3_out, type4_out) \
+	IPC_MESSAGE_DECL(SYNC, CONTROL, msg_class, 5, 4, (type1_in, type2_in, type3_in, type4_in, type5_in), (type1_out, type2_out, type3_out, type4_out))
+
+#define IPC_SYNC_MESSAGE_ROUTED0_0(msg_class) \
+	IPC_MESSAGE_DECL(SYNC, ROUTED, msg_class, 0, 0, (), ())
+
+#define IPC_SYNC_MESSAGE_ROUTED0_1(msg_class, type1_out) \
+	IPC_MESSAGE_DECL(SYNC, ROUTED, msg_class, 0, 1, (), (type1_out))
+
+#define IPC_SYNC_MESSAGE_ROUTED0_2(msg_class, type1_out, type2_out) \
+	IPC_MESSAGE_DECL(SYNC, ROUTED, msg_class, 0, 2, (), (type1_out, type2_out))
+
+#define IPC_SYNC_MESSAGE_ROUTED0_3(msg_class, type1_out, type2_out, type3_out) \
+	IPC_MESSAGE_DECL(SYNC, ROUTED, msg_class, 0, 3, (), (type1_out, type2_out, type3_out))
+
+#define IPC_SYNC_MESSAGE_ROUTED0_4(msg_class, type1_out, type2_out, type3_out, type4_out) \
+	IPC_MESSAGE_DECL(SYNC, ROUTED, msg_class, 0, 4, (), (type1_out, type2_out, type3_out, type4_out))
+
+#define IPC_SYNC_MESSAGE_ROUTED1_0(msg_class, type1_in) \
+	IPC_MESSAGE_DECL(SYNC, ROUTED, msg_class, 1, 0, (type1_in), ())
+
+#define IPC_SYNC_MESSAGE_ROUTED1_1(msg_class, type1_in, type1_out) \
+	IPC_MESSAGE_DECL(SYNC, ROUTED, msg_class, 1, 1, (type1_in), (type1_out))
+
+#define IPC_SYNC_MESSAGE_ROUTED1_2(msg_class, type1_in, type1_out, type2_out) \
+	IPC_MESSAGE_DECL(SYNC, ROUTED, msg_class, 1, 2, (type1_in), (type1_out, type2_out))
+
+#define IPC_SYNC_MESSAGE_ROUTED1_3(msg_class, type1_in, type1_out, type2_out, type3_out) \
+	IPC_MESSAGE_DECL(SYNC, ROUTED, msg_class, 1, 3, (type1_in), (type1_out, type2_out, type3_out))
+
+#define IPC_SYNC_MESSAGE_ROUTED1_4(msg_class, type1_in, type1_out, type2_out, type3_out, type4_out) \
+	IPC_MESSAGE_DECL(SYNC, ROUTED, msg_class, 1, 4, (type1_in), (type1_out, type2_out, type3_out, type4_out))
+
+#define IPC_SYNC_MESSAGE_ROUTED2_0(msg_class, type1_in, type2_in) \
+	IPC_MESSAGE_DECL(SYNC, ROUTED, msg_class, 2, 0, (type1_in, type2_in), ())
+
+#define IPC_SYNC_MESSAGE_ROUTED2_1(msg_class, type1_in, type2_in, type1_out) \
+	IPC_MESSAGE_DECL(SYNC, ROUTED, msg_class, 2, 1, (type1_in, type2_in), (type1_out))
+
+#define IPC_SYNC_MESSAGE_ROUTED2_2(msg_class, type1_in, type2_in, type1_out, type2_out) \
+	IPC_MESSAGE_DECL(SYNC, ROUTED, msg_class, 2, 2, (type1_in, type2_in), (type1_out, type2_out))
+
+#define IPC_SYNC_MESSAGE_ROUTED2_3(msg_class, type1_in, type2_in, type1_out, type2_out, type3_out) \
+	IPC_MESSAGE_DECL(SYNC, ROUTED, msg_class, 2, 3, (type1_in, type2_in), (type1_out, type2_out, type3_out))
+
+#define IPC_SYNC_MESSAGE_ROUTED2_4(msg_class, type1_in, type2_in, type1_out, type2_out, type3_out, type4_out) \
+	IPC_MESSAGE_DECL(SYNC, ROUTED, msg_class, 2, 4, (type1_in, type2_in), (type1_out, type2_out, type3_out, type4_out))
+
+#define IPC_SYNC_MESSAGE_ROUTED3_0(msg_class, type1_in, type2_in, type3_in) \
+	IPC_MESSAGE_DECL(SYNC, ROUTED, msg_class, 3, 0, (type1_in, type2_in, type3_in), ())
+
+#define IPC_SYNC_MESSAGE_ROUTED3_1(msg_class, type1_in, type2_in, type3_in, type1_out) \
+	IPC_MESSAGE_DECL(SYNC, ROUTED, msg_class, 3, 1, (type1_in, type2_in, type3_in), (type1_out))
+
+#define IPC_SYNC_MESSAGE_ROUTED3_2(msg_class, type1_in, type2_in, type3_in, type1_out, type2_out) \
+	IPC_MESSAGE_DECL(SYNC, ROUTED, msg_class, 3, 2, (type1_in, type2_in, type3_in), (type1_out, type2_out))
+
+#define IPC_SYNC_MESSAGE_ROUTED3_3(msg_class, type1_in, type2_in, type3_in, type1_out, type2_out, type3_out) \
+	IPC_MESSAGE_DECL(SYNC, ROUTED, msg_class, 3, 3, (type1_in, type2_in, type3_in), (type1_out, type2_out, type3_out))
+
+#define IPC_SYNC_MESSAGE_ROUTED3_4(msg_class, type1_in, type2_in, type3_in, type1_out, type2_out, type3_out, type4_out) \
+	IPC_MESSAGE_DECL(SYNC, ROUTED, msg_class, 3, 4, (type1_in, type2_in, type3_in), (type1_out, type2_out, type3_out, type4_out))
+
+#define IPC_SYNC_MESSAGE_ROUTED4_0(msg_class, type1_in, type2_in, type3_in, type4_in) \
+	IPC_MESSAGE_DECL(SYNC, ROUTED, msg_class, 4, 0, (type1_in, type2_in, type3_in, type4_in), ())
+
+#define IPC_SYNC_MESSAGE_ROUTED4_1(msg_class, type1_in, type2_in, type3_in, type4_in, type1_out) \
+	IPC_MESSAGE_DECL(SYNC, ROUTED, msg_class, 4, 1, (type1_in, type2_in, type3_in, type4_in), (type1_out))
+
+#define IPC_SYNC_MESSAGE_ROUTED4_2(msg_class, type1_in, type2_in, type3_in, type4_in, type1_out, type2_out) \
+	IPC_MESSAGE_DECL(SYNC, ROUTED, msg_class, 4, 2, (type1_in, type2_in, type3_in, type4_in), (type1_out, type2_out))
+
+#define IPC_SYNC_MESSAGE_ROUTED4_3(msg_class, type1_in, type2_in, type3_in, type4_in, type1_out, type2_out, type3_out) \
+	IPC_MESSAGE_DECL(SYNC, ROUTED, msg_class, 4, 3, (type1_in, type2_in, type3_in, type4_in), (type1_out, type2_out, type3_out))
+
+#define IPC_SYNC_MESSAGE_ROUTED4_4(msg_class, type1_in, type2_in, type3_in, type4_in, type1_out, type2_out, type3_out, type4_out) \
+	IPC_MESSAGE_DECL(SYNC, ROUTED, msg_class, 4, 4, (type1_in, type2_in, type3_in, type4_in), (type1_out, type2_out, type3_out, type4_out))
+
+#define IPC_SYNC_MESSAGE_ROUTED5_0(msg_class, type1_in, type2_in, type3_in, type4_in, type5_in) \
+	IPC_MESSAGE_DECL(SYNC, ROUTED, msg_class, 5, 0, (type1_in, type2_in, type3_in, type4_in, type5_in), ())
+
+#define IPC_SYNC_MESSAGE_ROUTED5_1(msg_class, type1_in, type2_in, type3_in, type4_in, type5_in, type1_out) \
+	IPC_MESSAGE_DECL(SYNC, ROUTED, msg_class, 5, 1, (type1_in, type2_in, type3_in, type4_in, type5_in), (type1_out))
+
+#define IPC_SYNC_MESSAGE_ROUTED5_2(msg_class, type1_in, type2_in, type3_in, type4_in, type5_in, type1_out, type2_out) \
+	IPC_MESSAGE_DECL(SYNC, ROUTED, msg_class, 5, 2, (type1_in, type2_in, type3_in, type4_in, type5_in), (type1_out, type2_out))
+
+#define IPC_SYNC_MESSAGE_ROUTED5_3(msg_class, type1_in, type2_in, type3_in, type4_in, type5_in, type1_out, type2_out, type3_out) \
+	IPC_MESSAGE_DECL(SYNC, ROUTED, msg_class, 5, 3, (type1_in, type2_in, type3_in, type4_in, type5_in), (type1_out, type2_out, type3_out))
+
+#define IPC_SYNC_MESSAGE_ROUTED5_4(msg_class, type1_in, type2_in, type3_in, type4_in, type5_in, type1_out, type2_out, type3_out, type4_out) \
+	IPC_MESSAGE_DECL(SYNC, ROUTED, msg_class, 5, 4, (type1_in, type2_in, type3_in, type4_in, type5_in), (type1_out, type2_out, type3_out, type4_out))
+
 
 // The following macros define the common set of methods provided by ASYNC
 // message classes.
 // This macro is for all the async IPCs that don't pass an extra parameter using
-// IPC_BEGIN_MESSAGE_MAP_WITH_PARAM.
+// IPC_BEGIN_MESSAGE_MAP_WITH_PARAM. The decoded parameters are moved into the
+// handler, which may take them by value or by const reference.
 #define IPC_ASYNC_MESSAGE_METHODS_GENERIC                                     \
   template<class T, class S, class P, class Method>                           \
   static bool Dispatch(const Message* msg, T* obj, S* sender, P* parameter,   \
 	                   Method func) {                                         \
 	Schema::Param p;                                                          \
 	if (Read(msg, &p)) {                                                      \
-	  IPC::DispatchToMethod(obj, func, p);                                    \
+	  IPC::DispatchToMethod(obj, func, std::move(p));                         \
 	  return true;                                                            \
 	}                                                                         \
 	return false;                                                             \
-  }
-
-// The following macros are for for async IPCs which have a dispatcher with an
-// extra parameter specified using IPC_BEGIN_MESSAGE_MAP_WITH_PARAM.
-#define IPC_ASYNC_MESSAGE_METHODS_1                                           \
-  IPC_ASYNC_MESSAGE_METHODS_GENERIC                                           \
-  template<class T, class S, class P, typename TA>                            \
-  static bool Dispatch(const Message* msg, T* obj, S* sender, P* parameter,   \
-	                   void (T::*func)(P*, TA)) {                             \
-	Schema::Param p;                                                          \
-	if (Read(msg, &p)) {                                                      \
-	  (obj->*func)(parameter, std::get<0>(p));                                \
-	  return true;                                                            \
-	}                                                                         \
-	return false;                                                             \
-  }
-#define IPC_ASYNC_MESSAGE_METHODS_2                                           \
-  IPC_ASYNC_MESSAGE_METHODS_GENERIC                                           \
-  template<class T, class S, class P, typename TA, typename TB>               \
-  static bool Dispatch(const Message* msg, T* obj, S* sender, P* parameter,   \
-	                   void (T::*func)(P*, TA, TB)) {                         \
-	Schema::Param p;                                                          \
-	if (Read(msg, &p)) {                                                      \
-	  (obj->*func)(parameter, std::get<0>(p), std::get<1>(p));                \
+  }                                                                           \
+  template<class T, class S, class P, class Method>                           \
+  static bool DispatchWithScratch(const Message* msg, T* obj, S* sender,      \
+	                              P* parameter, Method func,                  \
+	                              Schema::Param* scratch) {                   \
+	if (Read(msg, scratch)) {                                                 \
+	  IPC::DispatchToMethod(obj, func, *scratch);                             \
 	  return true;                                                            \
 	}                                                                         \
 	return false;                                                             \
   }
-#define IPC_ASYNC_MESSAGE_METHODS_3                                           \
+
+// The following macros are for for async IPCs which have a dispatcher with an
+// extra parameter specified using IPC_BEGIN_MESSAGE_MAP_WITH_PARAM.
+#define IPC_ASYNC_MESSAGE_METHODS_WITH_PARAM                                  \
   IPC_ASYNC_MESSAGE_METHODS_GENERIC                                           \
-  template<class T, class S, class P, typename TA, typename TB, typename TC>  \
+  template<class T, class S, class P, typename... Args>                       \
   static bool Dispatch(const Message* msg, T* obj, S* sender, P* parameter,   \
-	                   void (T::*func)(P*, TA, TB, TC)) {                     \
+	                   void (T::*func)(P*, Args...)) {                        \
 	Schema::Param p;                                                          \
 	if (Read(msg, &p)) {                                                      \
-	  (obj->*func)(parameter, std::get<0>(p), std::get<1>(p),                 \
-	               std::get<2>(p));                                           \
+	  IPC::DispatchToMethodWithParam(obj, func, parameter, std::move(p));     \
 	  return true;                                                            \
 	}                                                                         \
 	return false;                                                             \
-  }
-#define IPC_ASYNC_MESSAGE_METHODS_4                                           \
-  IPC_ASYNC_MESSAGE_METHODS_GENERIC                                           \
-  template<class T, class S, class P, typename TA, typename TB, typename TC,  \
-	       typename TD>                                                       \
-  static bool Dispatch(const Message* msg, T* obj, S* sender, P* parameter,   \
-	                   void (T::*func)(P*, TA, TB, TC, TD)) {                 \
-	Schema::Param p;                                                          \
-	if (Read(msg, &p)) {                                                      \
-	  (obj->*func)(parameter, std::get<0>(p), std::get<1>(p),                 \
-	               std::get<2>(p), std::get<3>(p));                           \
+  }                                                                           \
+  template<class T, class S, class P, typename... Args>                       \
+  static bool DispatchWithScratch(const Message* msg, T* obj, S* sender,      \
+	                              P* parameter, void (T::*func)(P*, Args...), \
+	                              Schema::Param* scratch) {                   \
+	if (Read(msg, scratch)) {                                                 \
+	  IPC::DispatchToMethodWithParam(obj, func, parameter, *scratch);         \
 	  return true;                                                            \
 	}                                                                         \
 	return false;                                                             \
   }
-#define IPC_ASYNC_MESSAGE_METHODS_5                                           \
-  IPC_ASYNC_MESSAGE_METHODS_GENERIC                                           \
-  template<class T, class S, class P, typename TA, typename TB, typename TC,  \
-	       typename TD, typename TE>                                          \
+#define IPC_ASYNC_MESSAGE_METHODS_1 IPC_ASYNC_MESSAGE_METHODS_WITH_PARAM
+#define IPC_ASYNC_MESSAGE_METHODS_2 IPC_ASYNC_MESSAGE_METHODS_WITH_PARAM
+#define IPC_ASYNC_MESSAGE_METHODS_3 IPC_ASYNC_MESSAGE_METHODS_WITH_PARAM
+#define IPC_ASYNC_MESSAGE_METHODS_4 IPC_ASYNC_MESSAGE_METHODS_WITH_PARAM
+#define IPC_ASYNC_MESSAGE_METHODS_5 IPC_ASYNC_MESSAGE_METHODS_WITH_PARAM
+
+// The methods of SYNC message classes. The reply is sent through |sender|,
+// usually the handler object itself.
+#define IPC_SYNC_MESSAGE_METHODS_GENERIC                                      \
+  template<class T, class S, class P, class Method>                           \
   static bool Dispatch(const Message* msg, T* obj, S* sender, P* parameter,   \
-	                   void (T::*func)(P*, TA, TB, TC, TD, TE)) {             \
-	Schema::Param p;                                                          \
-	if (Read(msg, &p)) {                                                      \
-	  (obj->*func)(parameter, std::get<0>(p), std::get<1>(p),                 \
-	               std::get<2>(p), std::get<3>(p), std::get<4>(p));           \
-	  return true;                                                            \
-	}                                                                         \
-	return false;                                                             \
+	                   Method func) {                                         \
+	SendParam send_params;                                                    \
+	bool ok = ReadSendParam(msg, &send_params);                               \
+	return Schema::DispatchWithSendParams(ok, send_params, msg, obj, sender,  \
+	                                      func);                              \
   }
 
 
@@ -205,7 +412,47 @@
 	IPC_ASYNC_MESSAGE_METHODS_##in_cnt                                        \
 };
 
-
+// Compact messages only differ in their constructors.
+#define IPC_COMPACT_CONTROL_DECL IPC_ASYNC_CONTROL_DECL
+#define IPC_COMPACT_ROUTED_DECL IPC_ASYNC_ROUTED_DECL
+
+#define IPC_SYNC_CONTROL_DECL(msg_class, in_cnt, out_cnt, in_list, out_list)  \
+  class IPC_MESSAGE_EXPORT msg_class : public IPC::SyncMessage {              \
+   public:                                                                    \
+	typedef IPC::SyncMessageSchema<IPC_TUPLE_IN_##in_cnt in_list,             \
+	                               IPC_TUPLE_OUT_##out_cnt out_list> Schema;  \
+	typedef Schema::ReplyParam ReplyParam;                                    \
+	typedef Schema::SendParam SendParam;                                      \
+	enum { ID = IPC_MESSAGE_ID() };                                           \
+	msg_class(IPC_TYPE_IN_##in_cnt in_list                                    \
+	          IPC_COMMA_AND_##in_cnt(IPC_COMMA_OR_##out_cnt())                \
+	          IPC_TYPE_OUT_##out_cnt out_list);                               \
+	~msg_class() override;                                                    \
+	static bool ReadSendParam(const Message* msg, SendParam* p);              \
+	static bool ReadReplyParam(const Message* msg, ReplyParam* p);            \
+	IPC_SYNC_MESSAGE_METHODS_GENERIC                                          \
+};
+
+#define IPC_SYNC_ROUTED_DECL(msg_class, in_cnt, out_cnt, in_list, out_list)   \
+  class IPC_MESSAGE_EXPORT msg_class : public IPC::SyncMessage {              \
+   public:                                                                    \
+	typedef IPC::SyncMessageSchema<IPC_TUPLE_IN_##in_cnt in_list,             \
+	                               IPC_TUPLE_OUT_##out_cnt out_list> Schema;  \
+	typedef Schema::ReplyParam ReplyParam;                                    \
+	typedef Schema::SendParam SendParam;                                      \
+	enum { ID = IPC_MESSAGE_ID() };                                           \
+	msg_class(int32_t routing_id                                              \
+	          IPC_COMMA_OR_##in_cnt(IPC_COMMA_OR_##out_cnt())                 \
+	          IPC_TYPE_IN_##in_cnt in_list                                    \
+	          IPC_COMMA_AND_##in_cnt(IPC_COMMA_OR_##out_cnt())                \
+	          IPC_TYPE_OUT_##out_cnt out_list);                               \
+	~msg_class() override;                                                    \
+	static bool ReadSendParam(const Message* msg, SendParam* p);              \
+	static bool ReadReplyParam(const Message* msg, ReplyParam* p);            \
+	IPC_SYNC_MESSAGE_METHODS_GENERIC                                          \
+};
+
+
 #if defined(IPC_MESSAGE_IMPL)
 
 // "Implementation" inclusion produces constructors, destructors, and
@@ -240,6 +487,65 @@
 	return Schema::Read(msg, p);                                              \
   }
 
+#define IPC_COMPACT_CONTROL_IMPL(msg_class, in_cnt, out_cnt, in_list, out_list) \
+  msg_class::msg_class(IPC_TYPE_IN_##in_cnt in_list) :                        \
+	  IPC::Message(MSG_ROUTING_CONTROL, ID) {                                 \
+	    set_compact();                                                        \
+	    Schema::Write(this, IPC_NAME_IN_##in_cnt in_list);                    \
+	  }                                                                       \
+  msg_class::~msg_class() {}                                                  \
+  bool msg_class::Read(const Message* msg, Schema::Param* p) {                \
+	return Schema::Read(msg, p);                                              \
+  }
+
+#define IPC_COMPACT_ROUTED_IMPL(msg_class, in_cnt, out_cnt, in_list, out_list) \
+  msg_class::msg_class(int32_t routing_id IPC_COMMA_##in_cnt                  \
+	                   IPC_TYPE_IN_##in_cnt in_list) :                        \
+	  IPC::Message(routing_id, ID) {                                          \
+	    set_compact();                                                        \
+	    Schema::Write(this, IPC_NAME_IN_##in_cnt in_list);                    \
+	  }                                                                       \
+  msg_class::~msg_class() {}                                                  \
+  bool msg_class::Read(const Message* msg, Schema::Param* p) {                \
+	return Schema::Read(msg, p);                                              \
+  }
+
+#define IPC_SYNC_CONTROL_IMPL(msg_class, in_cnt, out_cnt, in_list, out_list)  \
+  msg_class::msg_class(IPC_TYPE_IN_##in_cnt in_list                           \
+	                   IPC_COMMA_AND_##in_cnt(IPC_COMMA_OR_##out_cnt())       \
+	                   IPC_TYPE_OUT_##out_cnt out_list) :                     \
+	  IPC::SyncMessage(MSG_ROUTING_CONTROL, ID,                               \
+	      new IPC::ParamDeserializer<ReplyParam>(                             \
+	          IPC_NAME_OUT_##out_cnt out_list)) {                             \
+	    Schema::Write(this, IPC_NAME_IN_##in_cnt in_list);                    \
+	  }                                                                       \
+  msg_class::~msg_class() {}                                                  \
+  bool msg_class::ReadSendParam(const Message* msg, SendParam* p) {           \
+	return Schema::ReadSendParam(msg, p);                                     \
+  }                                                                           \
+  bool msg_class::ReadReplyParam(const Message* msg, ReplyParam* p) {         \
+	return Schema::ReadReplyParam(msg, p);                                    \
+  }
+
+#define IPC_SYNC_ROUTED_IMPL(msg_class, in_cnt, out_cnt, in_list, out_list)   \
+  msg_class::msg_class(int32_t routing_id                                     \
+	                   IPC_COMMA_OR_##in_cnt(IPC_COMMA_OR_##out_cnt())        \
+	                   IPC_TYPE_IN_##in_cnt in_list                           \
+	                   IPC_COMMA_AND_##in_cnt(IPC_COMMA_OR_##out_cnt())       \
+	                   IPC_TYPE_OUT_##out_cnt out_list) :                     \
+	  IPC::SyncMessage(routing_id, ID,                                        \
+	      new IPC::ParamDeserializer<ReplyParam>(                             \
+	          IPC_NAME_OUT_##out_cnt out_list)) {                             \
+	    Schema::Write(this, IPC_NAME_IN_##in_cnt in_list);                    \
+	  }                                                                       \
+  msg_class::~msg_class() {}                                                  \
+  bool msg_class::ReadSendParam(const Message* msg, SendParam* p) {           \
+	return Schema::ReadSendParam(msg, p);                                     \
+  }                                                                           \
+  bool msg_class::ReadReplyParam(const Message* msg, ReplyParam* p) {         \
+	return Schema::ReadReplyParam(msg, p);                                    \
+  }
+
 #else
 
 // Normal inclusion produces nothing extra.
@@ -284,10 +590,10 @@
 #define IPC_NAME_IN_5(t1, t2, t3, t4, t5)   std::make_tuple(arg1, arg2, arg3, arg4, arg5)
 
 #define IPC_NAME_OUT_0()                    std::make_tuple()
-#define IPC_NAME_OUT_1(t1)                  std::make_tuple(*arg6)
-#define IPC_NAME_OUT_2(t1, t2)              std::make_tuple(*arg6, *arg7)
-#define IPC_NAME_OUT_3(t1, t2, t3)          std::make_tuple(*arg6, *arg7, *arg8)
-#define IPC_NAME_OUT_4(t1, t2, t3, t4)      std::make_tuple(*arg6, *arg7, *arg8, *arg9)
+#define IPC_NAME_OUT_1(t1)                  std::make_tuple(arg6)
+#define IPC_NAME_OUT_2(t1, t2)              std::make_tuple(arg6, arg7)
+#define IPC_NAME_OUT_3(t1, t2, t3)          std::make_tuple(arg6, arg7, arg8)
+#define IPC_NAME_OUT_4(t1, t2, t3, t4)      std::make_tuple(arg6, arg7, arg8, arg9)
 
 // There are places where the syntax requires a comma if there are input args,
 // if there are input args and output args, or if there are input args or
@@ -348,6 +654,19 @@
 #define IPC_MESSAGE_HANDLER(msg_class, member_func) \
 	IPC_MESSAGE_FORWARD(msg_class, this, _IpcMessageHandlerClass::member_func)
 
+// Same as IPC_MESSAGE_HANDLER, but the parameters are decoded into |scratch|,
+// a msg_class::Param owned by the handler object, instead of into fresh
+// objects. Strings, vectors and maps keep their storage from one message to
+// the next, so a frequent message of a steady shape decodes without
+// allocating. The handler should take its parameters by const reference.
+// |scratch| must only be used from one thread.
+#define IPC_MESSAGE_HANDLER_WITH_SCRATCH(msg_class, member_func, scratch)      \
+    case msg_class::ID: {                                                      \
+        msg_class::DispatchWithScratch(&ipc_message__, this, this, param__,    \
+                            &_IpcMessageHandlerClass::member_func, &scratch);  \
+	  }                                                                        \
+	  break;
+
 
 #define IPC_MESSAGE_UNHANDLED(code)                                            \
     default: {                                                                 \
@@ -1,5 +1,11 @@
 #include "ipc_message_utils.h"
 
+#include <stdint.h>
+
+#if defined(OS_POSIX)
+#include <fcntl.h>
+#endif
+
 
 namespace IPC {
 
@@ -25,49 +31,36 @@ bool ParamTraits<LogData>::Read(const Message* m,
 
 void IPC::ParamTraits<signed char>::Write(Message* m, const param_type& p)
 {
-	m->WriteBytes(&p, sizeof(param_type));
+	internal::WriteScalar(m, p);
 }
 
 bool ParamTraits<signed char>::Read(const Message* m,
 									base::PickleIterator* iter,
 									param_type* r) 
 {
-	const char* data;
-	if (!iter->ReadBytes(&data, sizeof(param_type)))
-		return false;
-	memcpy(r, data, sizeof(param_type));
-	return true;
+	return internal::ReadScalar(m, iter, r);
 }
 
 void ParamTraits<unsigned char>::Write(Message* m, const param_type& p) {
-	m->WriteBytes(&p, sizeof(param_type));
+	internal::WriteScalar(m, p);
 }
 
 bool ParamTraits<unsigned char>::Read(const Message* m,
 									  base::PickleIterator* iter,
 									  param_type* r) 
 {
-	const char* data;
-	if (!iter->ReadBytes(&data, sizeof(param_type)))
-		return false;
-	memcpy(r, data, sizeof(param_type));
-	return true;
+	return internal::ReadScalar(m, iter, r);
 }
 
 void ParamTraits<double>::Write(Message* m, const param_type& p) {
-	m->WriteBytes(reinterpret_cast<const char*>(&p), sizeof(param_type));
+	internal::WriteScalar(m, p);
 }
 
 bool ParamTraits<double>::Read(const Message* m,
 							   base::PickleIterator* iter,
 							   param_type* r) 
 {
-	const char *data;
-	if (!iter->ReadBytes(&data, sizeof(*r))) {
-		return false;
-	}
-	memcpy(r, data, sizeof(param_type));
-	return true;
+	return internal::ReadScalar(m, iter, r);
 }
 
 void ParamTraits<Message>::Write(Message* m, const Message& p) {
@@ -96,12 +89,89 @@ bool ParamTraits<Message>::Read(const Message* m,
 	return r->WriteBytes(payload, payload_size);
 }
 
-void ParamTraits<std::vector<char> >::Write(Message* m, const param_type& p) {
-	if (p.empty()) {
-		m->WriteData(NULL, 0);
-	} else {
-		m->WriteData(&p.front(), static_cast<int>(p.size()));
+void ParamTraits<scoped_refptr<base::RefCountedMemory> >::Write(Message* m,
+																 const param_type& p)
+{
+	m->WriteExternalData(p);
+}
+
+bool ParamTraits<scoped_refptr<base::RefCountedMemory> >::Read(const Message* m,
+																base::PickleIterator* iter,
+																param_type* r)
+{
+	const char *data;
+	int data_size = 0;
+	if (!iter->ReadData(&data, &data_size))
+		return false;
+	*r = new base::RefCountedBytes(reinterpret_cast<const unsigned char*>(data), data_size);
+	return true;
+}
+
+#if defined(OS_POSIX)
+void ParamTraits<base::SharedMemoryHandle>::Write(Message* m, const param_type& p)
+{
+	// An invalid handle goes as -1 and comes back invalid, so does one the
+	// message has no room for.
+	base::SharedMemoryHandle copy = p.Duplicate();
+	if (!copy.IsValid() || !m->WriteFileDescriptor(base::ScopedFD(copy.GetHandle())))
+		m->WriteInt(-1);
+	WriteParam(m, static_cast<unsigned long long>(p.GetSize()));
+}
+
+bool ParamTraits<base::SharedMemoryHandle>::Read(const Message* m,
+												 base::PickleIterator* iter,
+												 param_type* r)
+{
+	base::PickleIterator peek(*iter);
+	int index;
+	if (!peek.ReadInt(&index))
+		return false;
+
+	base::ScopedFD fd;
+	if (index == -1)
+		*iter = peek;
+	else if (!m->ReadFileDescriptor(iter, &fd))
+		return false;
+
+	unsigned long long size;
+	if (!ReadParam(m, iter, &size) || size > SIZE_MAX)
+		return false;
+
+	*r = fd.is_valid() ? base::SharedMemoryHandle(fd.release(), static_cast<size_t>(size))
+					   : base::SharedMemoryHandle();
+	return true;
+}
+
+void ParamTraits<base::ScopedFD>::Write(Message* m, const param_type& p)
+{
+	// Like a SharedMemoryHandle, an invalid descriptor or one the message
+	// has no room for arrives invalid.
+	int fd = p.is_valid() ? fcntl(p.get(), F_DUPFD_CLOEXEC, 0) : -1;
+	if (fd == -1 || !m->WriteFileDescriptor(base::ScopedFD(fd)))
+		m->WriteInt(-1);
+}
+
+bool ParamTraits<base::ScopedFD>::Read(const Message* m,
+									   base::PickleIterator* iter,
+									   param_type* r)
+{
+	base::PickleIterator peek(*iter);
+	int index;
+	if (!peek.ReadInt(&index))
+		return false;
+
+	if (index == -1)
+	{
+		*iter = peek;
+		r->reset();
+		return true;
 	}
+	return m->ReadFileDescriptor(iter, r);
+}
+#endif
+
+void ParamTraits<std::vector<char> >::Write(Message* m, const param_type& p) {
+	internal::WriteArray(m, p.empty() ? NULL : &p.front(), p.size(), sizeof(char));
 }
 
 bool ParamTraits<std::vector<char>>::Read(const Message* m,
@@ -110,7 +180,7 @@ bool ParamTraits<std::vector<char>>::Read(const Message* m,
 {
 	const char *data;
 	int data_size = 0;
-	if (!iter->ReadData(&data, &data_size) || data_size < 0)
+	if (!internal::ReadArray(m, iter, &data, &data_size, sizeof(char)))
 		return false;
 	r->resize(data_size);
 	if (data_size)
@@ -121,12 +191,7 @@ bool ParamTraits<std::vector<char>>::Read(const Message* m,
 void ParamTraits<std::vector<unsigned char> >::Write(Message* m,
 													 const param_type& p) 
 {
-	if (p.empty()) {
-		m->WriteData(NULL, 0);
-	} else {
-		m->WriteData(reinterpret_cast<const char*>(&p.front()),
-			static_cast<int>(p.size()));
-	}
+	internal::WriteArray(m, p.empty() ? NULL : &p.front(), p.size(), sizeof(unsigned char));
 }
 
 bool ParamTraits<std::vector<unsigned char>>::Read(const Message* m,
@@ -135,7 +200,7 @@ bool ParamTraits<std::vector<unsigned char>>::Read(const Message* m,
 {
 	const char *data;
 	int data_size = 0;
-	if (!iter->ReadData(&data, &data_size) || data_size < 0)
+	if (!internal::ReadArray(m, iter, &data, &data_size, sizeof(char)))
 		return false;
 	r->resize(data_size);
 	if (data_size)
@@ -144,7 +209,7 @@ bool ParamTraits<std::vector<unsigned char>>::Read(const Message* m,
 }
 
 void ParamTraits<std::vector<bool> >::Write(Message* m, const param_type& p) {
-	WriteParam(m, static_cast<int>(p.size()));
+	internal::WriteLength(m, p.size());
 	for (size_t i = 0; i < p.size(); i++)
 		WriteParam(m, static_cast<bool>(p[i]));
 }
@@ -155,7 +220,7 @@ bool ParamTraits<std::vector<bool>>::Read(const Message* m,
 {
 	int size;
 	// ReadLength() checks for < 0 itself.
-	if (!iter->ReadLength(&size))
+	if (!internal::ReadLength(m, iter, &size))
 		return false;
 	r->resize(size);
 	for (int i = 0; i < size; i++) {
@@ -1,13 +1,28 @@
 #ifndef IPC_MESSAGE_UTILS_H__
 #define IPC_MESSAGE_UTILS_H__
 
+#include <limits.h>
+
+#include <iterator>
 #include <vector>
 #include <map>
 #include <set>
 #include <tuple>
-
+#include <type_traits>
+#include <utility>
+
+#include "base/bits.h"
+#include "base/containers/span.h"
+#include "base/strings/string_piece.h"
+#include "build/build_config.h"
+#if defined(OS_POSIX)
+#include "base/files/scoped_file.h"
+#include "base/memory/shared_memory_handle.h"
+#endif
 #include "ipc_param_traits.h"
 #include "ipc_message.h"
+#include "ipc_sync_message.h"
+#include "message_dispatch.h"
 
 namespace IPC {
 
@@ -53,18 +68,207 @@ static inline bool ReadParam(const Message* m, base::PickleIterator* iter, P* p)
 }
 
 
+// Payload sizes ---------------------------------------------------------------
+//
+// GetParamSize(p) returns the bytes WriteParam(m, p) appends to the payload,
+// so a message can be reserved once before its parameters are written. It
+// counts the default encoding, compact messages usually need less.
+// Types whose size does not depend on the value have it in
+// internal::FixedParamSize<P>::value at compile time, the others provide
+//
+//   static size_t GetSize(const param_type& p);
+//
+// in their ParamTraits. Traits with neither count as 0, the message then
+// grows while they are written as it always did.
+
+namespace internal {
+
+// Every write is padded to 4 bytes.
+inline size_t AlignedParamSize(size_t size) {
+	return base::bits::Align(size, sizeof(uint32_t));
+}
+
+// 0 when the size depends on the value.
+template <class P, class Enable = void>
+struct FixedParamSize {
+	static constexpr size_t value = 0;
+};
+
+template <> struct FixedParamSize<bool> { static constexpr size_t value = sizeof(int32_t); };
+template <> struct FixedParamSize<int> { static constexpr size_t value = sizeof(int32_t); };
+template <> struct FixedParamSize<unsigned int> { static constexpr size_t value = sizeof(int32_t); };
+template <> struct FixedParamSize<signed char> { static constexpr size_t value = sizeof(int32_t); };
+template <> struct FixedParamSize<unsigned char> { static constexpr size_t value = sizeof(int32_t); };
+template <> struct FixedParamSize<long long> { static constexpr size_t value = sizeof(int64_t); };
+template <> struct FixedParamSize<unsigned long long> { static constexpr size_t value = sizeof(int64_t); };
+template <> struct FixedParamSize<float> { static constexpr size_t value = sizeof(float); };
+template <> struct FixedParamSize<double> { static constexpr size_t value = sizeof(double); };
+
+// Enum traits write an int.
+template <class P>
+struct FixedParamSize<P, typename std::enable_if<std::is_enum<P>::value>::type> {
+	static constexpr size_t value = sizeof(int32_t);
+};
+
+// Sum of the element sizes if all of them are fixed, 0 otherwise.
+template <class... Ts>
+struct FixedElementsSize;
+
+template <>
+struct FixedElementsSize<> {
+	static constexpr bool is_fixed = true;
+	static constexpr size_t value = 0;
+};
+
+template <class T, class... Ts>
+struct FixedElementsSize<T, Ts...> {
+	static constexpr bool is_fixed = FixedParamSize<T>::value != 0 &&
+									 FixedElementsSize<Ts...>::is_fixed;
+	static constexpr size_t value =
+		is_fixed ? FixedParamSize<T>::value + FixedElementsSize<Ts...>::value : 0;
+};
+
+template <class... Ts>
+struct FixedParamSize<std::tuple<Ts...> > : FixedElementsSize<Ts...> {
+};
+
+template <class A, class B>
+struct FixedParamSize<std::pair<A, B> > : FixedElementsSize<A, B> {
+};
+
+template <class Traits>
+struct HasGetSize {
+	template <class T>
+	static char Test(decltype(&T::GetSize));
+	template <class T>
+	static int Test(...);
+	static constexpr bool value = sizeof(Test<Traits>(0)) == sizeof(char);
+};
+
+template <class P,
+		  size_t fixed_size = FixedParamSize<P>::value,
+		  bool has_get_size = HasGetSize<ParamTraits<P> >::value>
+struct ParamSize {
+	static size_t Get(const P&) { return fixed_size; }
+};
+
+template <class P>
+struct ParamSize<P, 0, true> {
+	static size_t Get(const P& p) { return ParamTraits<P>::GetSize(p); }
+};
+
+template <class P>
+struct ParamSize<P, 0, false> {
+	static size_t Get(const P&) { return 0; }
+};
+
+}  // namespace internal
+
+template <class P>
+static inline size_t GetParamSize(const P& p) {
+	typedef typename SimilarTypeTraits<P>::Type Type;
+	return internal::ParamSize<Type>::Get(static_cast<const Type& >(p));
+}
+
+
+// Compact encoding ------------------------------------------------------------
+//
+// Messages declared with IPC_COMPACT_MESSAGE_CONTROLn or
+// IPC_COMPACT_MESSAGE_ROUTEDn have Message::COMPACT_BIT set. Their integers,
+// lengths and element counts are varints and their other scalars are packed
+// without padding. Strings and arrays keep their elements 4 byte aligned so
+// that views of them stay aligned. The traits check the flag when reading,
+// so a peer can take either encoding.
+
+namespace internal {
+
+inline void WriteLength(Message* m, size_t length) {
+	if (m->is_compact())
+		m->WriteVarUInt32(static_cast<uint32_t>(length));
+	else
+		m->WriteInt(static_cast<int>(length));
+}
+
+inline bool ReadLength(const Message* m, base::PickleIterator* iter, int* length) {
+	if (!m->is_compact())
+		return iter->ReadLength(length);
+
+	uint32_t value;
+	if (!iter->ReadVarUInt32(&value) || value > INT_MAX)
+		return false;
+	*length = static_cast<int>(value);
+	return true;
+}
+
+// A length followed by |count| elements of |element_size| bytes. Same as
+// Pickle::WriteData() in the default encoding.
+inline void WriteArray(Message* m, const void* data, size_t count, size_t element_size) {
+	WriteLength(m, count);
+	if (count)
+		m->WriteBytes(data, static_cast<int>(count * element_size));
+}
+
+inline bool ReadArray(const Message* m,
+					  base::PickleIterator* iter,
+					  const char** data,
+					  int* count,
+					  size_t element_size) {
+	if (!ReadLength(m, iter, count) ||
+		INT_MAX / element_size < static_cast<size_t>(*count))
+		return false;
+	// WriteArray() writes no bytes for an empty array. Reading none would
+	// still align the read index, which packed writes did not.
+	if (!*count) {
+		*data = NULL;
+		return true;
+	}
+	return iter->ReadBytes(data, static_cast<int>(*count * element_size));
+}
+
+// Scalars without a varint form, packed in compact messages.
+template <class T>
+inline void WriteScalar(Message* m, const T& p) {
+	if (m->is_compact())
+		m->WritePackedBytes(&p, sizeof(T));
+	else
+		m->WriteBytes(&p, sizeof(T));
+}
+
+template <class T>
+inline bool ReadScalar(const Message* m, base::PickleIterator* iter, T* r) {
+	const char* data;
+	bool ok = m->is_compact() ? iter->ReadPackedBytes(&data, sizeof(T))
+							  : iter->ReadBytes(&data, sizeof(T));
+	if (!ok)
+		return false;
+	memcpy(r, data, sizeof(T));
+	return true;
+}
+
+}  // namespace internal
+
+
 // Primitive ParamTraits -------------------------------------------------------
 
 template <>
 struct IPC_EXPORT ParamTraits<bool> {
 	typedef bool param_type;
 	static void Write(Message* m, const param_type& p) {
-		m->WriteBool(p);
+		if (m->is_compact())
+			m->WriteVarUInt32(p ? 1 : 0);
+		else
+			m->WriteBool(p);
 	}
 	static bool Read(const Message* m,
 					 base::PickleIterator* iter,
 					 param_type* r) {
-		return iter->ReadBool(r);
+		if (!m->is_compact())
+			return iter->ReadBool(r);
+		uint32_t value;
+		if (!iter->ReadVarUInt32(&value))
+			return false;
+		*r = value != 0;
+		return true;
 	}
 };
 
@@ -72,11 +276,16 @@ template <>
 struct IPC_EXPORT ParamTraits<int> {
 	typedef int param_type;
 	static void Write(Message* m, const param_type& p) {
-		m->WriteInt(p);
+		if (m->is_compact())
+			m->WriteVarInt32(p);
+		else
+			m->WriteInt(p);
 	}
 	static bool Read(const Message* m,
 					 base::PickleIterator* iter,
 					 param_type* r) {
+		if (m->is_compact())
+			return iter->ReadVarInt32(reinterpret_cast<int32_t*>(r));
 		return iter->ReadInt(r);
 	}
 };
@@ -85,11 +294,16 @@ template <>
 struct IPC_EXPORT ParamTraits<unsigned int> {
 	typedef unsigned int param_type;
 	static void Write(Message* m, const param_type& p) {
-		m->WriteInt(p);
+		if (m->is_compact())
+			m->WriteVarUInt32(p);
+		else
+			m->WriteInt(p);
 	}
 	static bool Read(const Message* m,
 					 base::PickleIterator* iter,
 					 param_type* r) {
+		if (m->is_compact())
+			return iter->ReadVarUInt32(reinterpret_cast<uint32_t*>(r));
 		return iter->ReadInt(reinterpret_cast<int*>(r));
 	}
 };
@@ -112,11 +326,16 @@ template <>
 struct IPC_EXPORT ParamTraits<long long> {
 	typedef long long param_type;
 	static void Write(Message* m, const param_type& p) {
-		m->WriteInt64(static_cast<int64_t>(p));
+		if (m->is_compact())
+			m->WriteVarInt64(static_cast<int64_t>(p));
+		else
+			m->WriteInt64(static_cast<int64_t>(p));
 	}
 	static bool Read(const Message* m,
 					 base::PickleIterator* iter,
 					 param_type* r) {
+		if (m->is_compact())
+			return iter->ReadVarInt64(reinterpret_cast<int64_t*>(r));
 		return iter->ReadInt64(reinterpret_cast<int64_t*>(r));
 	}
 };
@@ -125,11 +344,16 @@ template <>
 struct IPC_EXPORT ParamTraits<unsigned long long> {
 	typedef unsigned long long param_type;
 	static void Write(Message* m, const param_type& p) {
-		m->WriteInt64(p);
+		if (m->is_compact())
+			m->WriteVarUInt64(p);
+		else
+			m->WriteInt64(p);
 	}
 	static bool Read(const Message* m,
 					 base::PickleIterator* iter,
 					 param_type* r) {
+		if (m->is_compact())
+			return iter->ReadVarUInt64(reinterpret_cast<uint64_t*>(r));
 		return iter->ReadInt64(reinterpret_cast<int64_t*>(r));
 	}
 };
@@ -141,12 +365,12 @@ template <>
 struct IPC_EXPORT ParamTraits<float> {
 	typedef float param_type;
 	static void Write(Message* m, const param_type& p) {
-		m->WriteFloat(p);
+		internal::WriteScalar(m, p);
 	}
 	static bool Read(const Message* m,
 					 base::PickleIterator* iter,
 					 param_type* r) {
-		return iter->ReadFloat(r);
+		return internal::ReadScalar(m, iter, r);
 	}
 };
 
@@ -165,6 +389,10 @@ struct IPC_EXPORT ParamTraits<double> {
 template <>
 struct IPC_EXPORT ParamTraits<Message> {
 	static void Write(Message* m, const Message& p);
+	static size_t GetSize(const Message& p) {
+		return 3 * sizeof(uint32_t) + sizeof(int) +
+			   internal::AlignedParamSize(p.payload_size());
+	}
 	static bool Read(const Message* m,
 					 base::PickleIterator* iter,
 					 Message* r);
@@ -176,32 +404,186 @@ template <>
 struct IPC_EXPORT ParamTraits<std::string> {
 	typedef std::string param_type;
 	static void Write(Message* m, const param_type& p) {
-		m->WriteString(p);
+		internal::WriteArray(m, p.data(), p.size(), sizeof(char));
+	}
+	static size_t GetSize(const param_type& p) {
+		return sizeof(int) + internal::AlignedParamSize(p.size());
 	}
 	static bool Read(const Message* m,
 					 base::PickleIterator* iter,
 					 param_type* r) {
-		return iter->ReadString(r);
+		const char* data;
+		int length;
+		if (!internal::ReadArray(m, iter, &data, &length, sizeof(char)))
+			return false;
+		r->assign(data, length);
+		return true;
 	}
 };
 
+// UTF-16 on the wire, see Pickle::WriteUTF16().
 template <>
 struct IPC_EXPORT ParamTraits<std::wstring> {
 	typedef std::wstring param_type;
 	static void Write(Message* m, const param_type& p) {
-		m->WriteString16(p);
+		size_t length = base::Pickle::UTF16Length(p.data(), p.size());
+		internal::WriteLength(m, length);
+		if (length)
+			m->WriteUTF16(p.data(), p.size());
+	}
+	static size_t GetSize(const param_type& p) {
+		// Characters above the BMP take two units where wchar_t is UTF-32.
+		size_t length = base::Pickle::UTF16Length(p.data(), p.size());
+		return sizeof(int) + internal::AlignedParamSize(length * sizeof(base::char16));
+	}
+	static bool Read(const Message* m,
+					 base::PickleIterator* iter,
+					 param_type* r) {
+		int length;
+		if (!internal::ReadLength(m, iter, &length))
+			return false;
+		// Nothing to align to, see internal::ReadArray().
+		if (!length) {
+			r->clear();
+			return true;
+		}
+		return iter->ReadUTF16(length, r);
+	}
+};
+
+// View types -----------------------------------------------------------------
+//
+// Read into views of the message payload, valid while the message is. They
+// let a handler take a large string or blob without a copy:
+//
+//   IPC_MESSAGE_CONTROL1(TestMsg_Blob, base::span<const char>)
+//   void OnBlob(const base::span<const char>& blob);
+//
+// StringPiece matches the wire format of std::string, span<const char> and
+// span<const unsigned char> match std::vector<char> and
+// std::vector<unsigned char>.
+
+template <>
+struct IPC_EXPORT ParamTraits<base::StringPiece> {
+	typedef base::StringPiece param_type;
+	static void Write(Message* m, const param_type& p) {
+		internal::WriteArray(m, p.data(), p.size(), sizeof(char));
+	}
+	static size_t GetSize(const param_type& p) {
+		return sizeof(int) + internal::AlignedParamSize(p.size());
+	}
+	static bool Read(const Message* m,
+					 base::PickleIterator* iter,
+					 param_type* r) {
+		const char* data;
+		int length;
+		if (!internal::ReadArray(m, iter, &data, &length, sizeof(char)))
+			return false;
+		*r = base::StringPiece(data, length);
+		return true;
+	}
+};
+
+#if defined(WCHAR_T_IS_UTF16)
+template <>
+struct IPC_EXPORT ParamTraits<base::StringPiece16> {
+	typedef base::StringPiece16 param_type;
+	static void Write(Message* m, const param_type& p) {
+		internal::WriteArray(m, p.data(), p.size(), sizeof(base::char16));
+	}
+	static size_t GetSize(const param_type& p) {
+		return sizeof(int) + internal::AlignedParamSize(p.size() * sizeof(base::char16));
+	}
+	static bool Read(const Message* m,
+					 base::PickleIterator* iter,
+					 param_type* r) {
+		const char* data;
+		int length;
+		if (!internal::ReadArray(m, iter, &data, &length, sizeof(base::char16)))
+			return false;
+		*r = base::StringPiece16(reinterpret_cast<const base::char16*>(data), length);
+		return true;
+	}
+};
+#endif
+
+template <class T>
+struct ParamTraits<base::span<const T> > {
+	static_assert(std::is_trivially_copyable<T>::value, "span elements are copied as bytes");
+	static_assert(ALIGNOF(T) <= sizeof(uint32_t), "the payload is only 4 byte aligned");
+	typedef base::span<const T> param_type;
+	static void Write(Message* m, const param_type& p) {
+		internal::WriteArray(m, p.data(), p.size(), sizeof(T));
+	}
+	static size_t GetSize(const param_type& p) {
+		return sizeof(int) + internal::AlignedParamSize(p.size_bytes());
 	}
 	static bool Read(const Message* m,
 					 base::PickleIterator* iter,
 					 param_type* r) {
-		return iter->ReadString16(r);
+		const char* data;
+		int count;
+		if (!internal::ReadArray(m, iter, &data, &count, sizeof(T)))
+			return false;
+		*r = param_type(reinterpret_cast<const T*>(data), count);
+		return true;
 	}
 };
 
+// Written with Message::WriteExternalData(), the bytes are not copied into the
+// message. Reading copies them into a RefCountedBytes.
+template <>
+struct IPC_EXPORT ParamTraits<scoped_refptr<base::RefCountedMemory> > {
+	typedef scoped_refptr<base::RefCountedMemory> param_type;
+	static void Write(Message* m, const param_type& p);
+	// Only the length goes into the inline payload.
+	static size_t GetSize(const param_type&) {
+		return sizeof(int);
+	}
+	static bool Read(const Message* m,
+					 base::PickleIterator* iter,
+					 param_type* r);
+};
+
+#if defined(OS_POSIX)
+// The region goes along as a descriptor, only its index and size are in the
+// payload. Writing duplicates the descriptor, the sender keeps its handle.
+// The handle read is owned by the receiver, usually given to a
+// base::SharedMemory.
+template <>
+struct IPC_EXPORT ParamTraits<base::SharedMemoryHandle> {
+	typedef base::SharedMemoryHandle param_type;
+	static void Write(Message* m, const param_type& p);
+	static size_t GetSize(const param_type&) {
+		return sizeof(int) + sizeof(int64_t);
+	}
+	static bool Read(const Message* m,
+					 base::PickleIterator* iter,
+					 param_type* r);
+};
+
+// A descriptor of any kind: a pipe, a socket, an open file. Writing
+// duplicates it, the sender keeps |p| open. The receiver owns what it reads.
+template <>
+struct IPC_EXPORT ParamTraits<base::ScopedFD> {
+	typedef base::ScopedFD param_type;
+	static void Write(Message* m, const param_type& p);
+	static size_t GetSize(const param_type&) {
+		return sizeof(int);
+	}
+	static bool Read(const Message* m,
+					 base::PickleIterator* iter,
+					 param_type* r);
+};
+#endif
+
 template <>
 struct IPC_EXPORT ParamTraits<std::vector<char> > {
 	typedef std::vector<char> param_type;
 	static void Write(Message* m, const param_type& p);
+	static size_t GetSize(const param_type& p) {
+		return sizeof(int) + internal::AlignedParamSize(p.size());
+	}
 	static bool Read(const Message*,
 					 base::PickleIterator* iter,
 					 param_type* r);
@@ -211,6 +593,9 @@ template <>
 struct IPC_EXPORT ParamTraits<std::vector<unsigned char> > {
 	typedef std::vector<unsigned char> param_type;
 	static void Write(Message* m, const param_type& p);
+	static size_t GetSize(const param_type& p) {
+		return sizeof(int) + internal::AlignedParamSize(p.size());
+	}
 	static bool Read(const Message* m,
 					 base::PickleIterator* iter,
 					 param_type* r);
@@ -220,25 +605,71 @@ template <>
 struct IPC_EXPORT ParamTraits<std::vector<bool> > {
 	typedef std::vector<bool> param_type;
 	static void Write(Message* m, const param_type& p);
+	static size_t GetSize(const param_type& p) {
+		return sizeof(int) + p.size() * internal::FixedParamSize<bool>::value;
+	}
 	static bool Read(const Message* m,
 					 base::PickleIterator* iter,
 					 param_type* r);
 };
 
+// Specialize to true for a struct whose vectors may be written with one
+// memcpy. Only for structs without padding, which would go out uninitialized,
+// and with the same layout in both processes. Its ParamTraits are bypassed.
+//   template <> struct AllowBulkCopy<Point> : std::true_type {};
 template <class P>
-struct IPC_EXPORT ParamTraits<std::vector<P> > {
+struct AllowBulkCopy : std::false_type {
+};
+
+namespace internal {
+
+// The arithmetic types with ParamTraits of their own, the same width on
+// every platform. long, wchar_t and short are not, their width differs
+// between Windows and Linux.
+template <class P>
+struct IsFixedWidthArithmetic
+	: std::integral_constant<bool, std::is_same<P, signed char>::value ||
+								   std::is_same<P, unsigned char>::value ||
+								   std::is_same<P, int>::value ||
+								   std::is_same<P, unsigned int>::value ||
+								   std::is_same<P, long long>::value ||
+								   std::is_same<P, unsigned long long>::value ||
+								   std::is_same<P, float>::value ||
+								   std::is_same<P, double>::value> {
+};
+
+// Element types a vector is written with one memcpy instead of element by
+// element: the types above and the structs allowed by AllowBulkCopy. bool
+// and enums are left to their ParamTraits to validate the values.
+template <class P>
+struct IsBulkCopyable {
+	static const bool value = IsFixedWidthArithmetic<P>::value ||
+							  (AllowBulkCopy<P>::value &&
+							   std::is_trivially_copyable<P>::value);
+};
+
+template <class P, bool bulk = IsBulkCopyable<P>::value>
+struct VectorParamTraits {
 	typedef std::vector<P> param_type;
 	static void Write(Message* m, const param_type& p) {
-		WriteParam(m, static_cast<int>(p.size()));
+		WriteLength(m, p.size());
 		for (size_t i = 0; i < p.size(); i++)
 			WriteParam(m, p[i]);
 	}
+	static size_t GetSize(const param_type& p) {
+		if (FixedParamSize<P>::value)
+			return sizeof(int) + p.size() * FixedParamSize<P>::value;
+		size_t size = sizeof(int);
+		for (size_t i = 0; i < p.size(); i++)
+			size += GetParamSize(p[i]);
+		return size;
+	}
 	static bool Read(const Message* m,
 					 base::PickleIterator* iter,
 					 param_type* r) {
 		int size;
 		// ReadLength() checks for < 0 itself.
-		if (!iter->ReadLength(&size))
+		if (!ReadLength(m, iter, &size))
 			return false;
 		// Resizing beforehand is not safe, see BUG 1006367 for details.
 		if (INT_MAX / sizeof(P) <= static_cast<size_t>(size))
@@ -252,27 +683,111 @@ struct IPC_EXPORT ParamTraits<std::vector<P> > {
 	}
 };
 
+// Element types written as varints in compact messages.
+template <class P>
+struct HasVarIntEncoding
+	: std::integral_constant<bool, std::is_same<P, int>::value ||
+								   std::is_same<P, unsigned int>::value ||
+								   std::is_same<P, long long>::value ||
+								   std::is_same<P, unsigned long long>::value> {
+};
+
+// The element count followed by the raw elements, padded once at the end.
+// Compact messages write integers one varint at a time instead.
+template <class P>
+struct VectorParamTraits<P, true> {
+	typedef std::vector<P> param_type;
+	static void Write(Message* m, const param_type& p) {
+		if (HasVarIntEncoding<P>::value && m->is_compact())
+			WriteVarInts(m, p, HasVarIntEncoding<P>());
+		else
+			WriteArray(m, p.empty() ? NULL : &p.front(), p.size(), sizeof(P));
+	}
+	static size_t GetSize(const param_type& p) {
+		return sizeof(int) + AlignedParamSize(p.size() * sizeof(P));
+	}
+	static bool Read(const Message* m,
+					 base::PickleIterator* iter,
+					 param_type* r) {
+		if (HasVarIntEncoding<P>::value && m->is_compact())
+			return ReadVarInts(m, iter, r, HasVarIntEncoding<P>());
+
+		// The payload is only 4 byte aligned, copy instead of casting.
+		const char* data;
+		int size;
+		if (!ReadArray(m, iter, &data, &size, sizeof(P)))
+			return false;
+		r->resize(size);
+		if (size)
+			memcpy(&r->front(), data, size * sizeof(P));
+		return true;
+	}
+
+  private:
+	static void WriteVarInts(Message* m, const param_type& p, std::true_type) {
+		VectorParamTraits<P, false>::Write(m, p);
+	}
+	static void WriteVarInts(Message*, const param_type&, std::false_type) {
+	}
+	static bool ReadVarInts(const Message* m,
+							base::PickleIterator* iter,
+							param_type* r,
+							std::true_type) {
+		return VectorParamTraits<P, false>::Read(m, iter, r);
+	}
+	static bool ReadVarInts(const Message*,
+							base::PickleIterator*,
+							param_type*,
+							std::false_type) {
+		return false;
+	}
+};
+
+}  // namespace internal
+
+template <class P>
+struct IPC_EXPORT ParamTraits<std::vector<P> > : internal::VectorParamTraits<P> {
+};
+
 template <class P>
 struct IPC_EXPORT ParamTraits<std::set<P> > {
 	typedef std::set<P> param_type;
 	static void Write(Message* m, const param_type& p) {
-		WriteParam(m, static_cast<int>(p.size()));
+		internal::WriteLength(m, p.size());
 		typename param_type::const_iterator iter;
 		for (iter = p.begin(); iter != p.end(); ++iter)
 			WriteParam(m, *iter);
 	}
+	static size_t GetSize(const param_type& p) {
+		if (internal::FixedParamSize<P>::value)
+			return sizeof(int) + p.size() * internal::FixedParamSize<P>::value;
+		size_t size = sizeof(int);
+		typename param_type::const_iterator iter;
+		for (iter = p.begin(); iter != p.end(); ++iter)
+			size += GetParamSize(*iter);
+		return size;
+	}
 	static bool Read(const Message* m,
 					 base::PickleIterator* iter,
 					 param_type* r) {
 		int size;
-		if (!iter->ReadLength(&size))
+		if (!internal::ReadLength(m, iter, &size))
 			return false;
+		// Merges into |r|, see ParamTraits<std::map>::Read().
+		typename param_type::iterator it = r->begin();
+		P item;
 		for (int i = 0; i < size; ++i) {
-			P item;
 			if (!ReadParam(m, iter, &item))
 				return false;
-			r->insert(item);
+			if (i > 0 && !r->key_comp()(*std::prev(it), item))
+				return false;
+			while (it != r->end() && r->key_comp()(*it, item))
+				it = r->erase(it);
+			if (it == r->end() || r->key_comp()(item, *it))
+				it = r->insert(it, item);
+			++it;
 		}
+		r->erase(it, r->end());
 		return true;
 	}
 };
@@ -281,27 +796,49 @@ template <class K, class V, class C, class A>
 struct IPC_EXPORT ParamTraits<std::map<K, V, C, A> > {
 	typedef std::map<K, V, C, A> param_type;
 	static void Write(Message* m, const param_type& p) {
-		WriteParam(m, static_cast<int>(p.size()));
+		internal::WriteLength(m, p.size());
 		typename param_type::const_iterator iter;
 		for (iter = p.begin(); iter != p.end(); ++iter) {
 			WriteParam(m, iter->first);
 			WriteParam(m, iter->second);
 		}
 	}
+	static size_t GetSize(const param_type& p) {
+		if (internal::FixedElementsSize<K, V>::value)
+			return sizeof(int) + p.size() * internal::FixedElementsSize<K, V>::value;
+		size_t size = sizeof(int);
+		typename param_type::const_iterator iter;
+		for (iter = p.begin(); iter != p.end(); ++iter)
+			size += GetParamSize(iter->first) + GetParamSize(iter->second);
+		return size;
+	}
 	static bool Read(const Message* m,
 					 base::PickleIterator* iter,
 					 param_type* r) {
 		int size;
-		if (!ReadParam(m, iter, &size) || size < 0)
+		if (!internal::ReadLength(m, iter, &size))
 			return false;
+		// Write() sends the keys in order, so the message and |r| are merged
+		// in one pass: entries with a key from the message keep their node
+		// and the value is read over the old one, the others are erased.
+		// Decoding the same keys again into the same map does not allocate.
+		// Keys out of order are rejected.
+		typename param_type::iterator it = r->begin();
+		K k;
 		for (int i = 0; i < size; ++i) {
-			K k;
 			if (!ReadParam(m, iter, &k))
 				return false;
-			V& value = (*r)[k];
-			if (!ReadParam(m, iter, &value))
+			if (i > 0 && !r->key_comp()(std::prev(it)->first, k))
+				return false;
+			while (it != r->end() && r->key_comp()(it->first, k))
+				it = r->erase(it);
+			if (it == r->end() || r->key_comp()(k, it->first))
+				it = r->insert(it, typename param_type::value_type(k, V()));
+			if (!ReadParam(m, iter, &it->second))
 				return false;
+			++it;
 		}
+		r->erase(it, r->end());
 		return true;
 	}
 
@@ -314,107 +851,56 @@ struct IPC_EXPORT ParamTraits<std::pair<A, B> > {
 		WriteParam(m, p.first);
 		WriteParam(m, p.second);
 	}
-	static bool Read(const Message* m,
-					 base::PickleIterator* iter,
-					 param_type* r) {
-		return ReadParam(m, iter, &r->first) && ReadParam(m, iter, &r->second);
-	}
-};
-
-template <>
-struct ParamTraits<std::tuple<>> {
-	typedef std::tuple<> param_type;
-	static void Write(Message* m, const param_type& p) {
-	}
-	static bool Read(const Message* m,
-					 base::PickleIterator* iter,
-		             param_type* r) {
-		return true;
-	}
-};
-
-template <class A>
-struct ParamTraits<std::tuple<A>> {
-	typedef std::tuple<A> param_type;
-	static void Write(Message* m, const param_type& p) {
-		WriteParam(m, std::get<0>(p));
-	}
-	static bool Read(const Message* m,
-					 base::PickleIterator* iter,
-					 param_type* r) {
-		return ReadParam(m, iter, &std::get<0>(*r));
-	}
-};
-
-template <class A, class B>
-struct ParamTraits<std::tuple<A, B>> {
-	typedef std::tuple<A, B> param_type;
-	static void Write(Message* m, const param_type& p) {
-		WriteParam(m, std::get<0>(p));
-		WriteParam(m, std::get<1>(p));
-	}
-	static bool Read(const Message* m,
-					 base::PickleIterator* iter,
-					 param_type* r) {
-		return (ReadParam(m, iter, &std::get<0>(*r)) &&
-				ReadParam(m, iter, &std::get<1>(*r)));
-	}
-};
-
-template <class A, class B, class C>
-struct ParamTraits<std::tuple<A, B, C>> {
-	typedef std::tuple<A, B, C> param_type;
-	static void Write(Message* m, const param_type& p) {
-		WriteParam(m, std::get<0>(p));
-		WriteParam(m, std::get<1>(p));
-		WriteParam(m, std::get<2>(p));
+	static size_t GetSize(const param_type& p) {
+		return GetParamSize(p.first) + GetParamSize(p.second);
 	}
 	static bool Read(const Message* m,
 					 base::PickleIterator* iter,
 					 param_type* r) {
-		return (ReadParam(m, iter, &std::get<0>(*r)) &&
-				ReadParam(m, iter, &std::get<1>(*r)) &&
-				ReadParam(m, iter, &std::get<2>(*r)));
+		return ReadParam(m, iter, &r->first) && ReadParam(m, iter, &r->second);
 	}
 };
 
-template <class A, class B, class C, class D>
-struct ParamTraits<std::tuple<A, B, C, D>> {
-	typedef std::tuple<A, B, C, D> param_type;
+// Any number of elements, written in order.
+template <class... Ts>
+struct ParamTraits<std::tuple<Ts...>> {
+	typedef std::tuple<Ts...> param_type;
 	static void Write(Message* m, const param_type& p) {
-		WriteParam(m, std::get<0>(p));
-		WriteParam(m, std::get<1>(p));
-		WriteParam(m, std::get<2>(p));
-		WriteParam(m, std::get<3>(p));
+		WriteElements(m, p, std::index_sequence_for<Ts...>());
 	}
-	static bool Read(const Message* m,
-					 base::PickleIterator* iter,
-					 param_type* r) {
-		return (ReadParam(m, iter, &std::get<0>(*r)) &&
-				ReadParam(m, iter, &std::get<1>(*r)) &&
-				ReadParam(m, iter, &std::get<2>(*r)) &&
-				ReadParam(m, iter, &std::get<3>(*r)));
-	}
-};
-
-template <class A, class B, class C, class D, class E>
-struct ParamTraits<std::tuple<A, B, C, D, E>> {
-	typedef std::tuple<A, B, C, D, E> param_type;
-	static void Write(Message* m, const param_type& p) {
-		WriteParam(m, std::get<0>(p));
-		WriteParam(m, std::get<1>(p));
-		WriteParam(m, std::get<2>(p));
-		WriteParam(m, std::get<3>(p));
-		WriteParam(m, std::get<4>(p));
+	static size_t GetSize(const param_type& p) {
+		return GetElementsSize(p, std::index_sequence_for<Ts...>());
 	}
 	static bool Read(const Message* m,
 					 base::PickleIterator* iter,
 					 param_type* r) {
-		return (ReadParam(m, iter, &std::get<0>(*r)) &&
-				ReadParam(m, iter, &std::get<1>(*r)) &&
-				ReadParam(m, iter, &std::get<2>(*r)) &&
-				ReadParam(m, iter, &std::get<3>(*r)) &&
-				ReadParam(m, iter, &std::get<4>(*r)));
+		return ReadElements(m, iter, r, std::index_sequence_for<Ts...>());
+	}
+
+private:
+	// The braced lists evaluate the elements left to right.
+	template <size_t... Ns>
+	static void WriteElements(Message* m, const param_type& p, std::index_sequence<Ns...>) {
+		int expand[] = { 0, (WriteParam(m, std::get<Ns>(p)), 0)... };
+		(void)expand;
+	}
+	template <size_t... Ns>
+	static size_t GetElementsSize(const param_type& p, std::index_sequence<Ns...>) {
+		size_t sizes[] = { 0, GetParamSize(std::get<Ns>(p))... };
+		size_t size = 0;
+		for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); ++i)
+			size += sizes[i];
+		return size;
+	}
+	template <size_t... Ns>
+	static bool ReadElements(const Message* m,
+							 base::PickleIterator* iter,
+							 param_type* r,
+							 std::index_sequence<Ns...>) {
+		bool ok = true;
+		bool expand[] = { true, (ok = ok && ReadParam(m, iter, &std::get<Ns>(*r)))... };
+		(void)expand;
+		return ok;
 	}
 };
 
@@ -433,6 +919,77 @@ class MessageSchema {
 	static bool Read(const Message* msg, Param* p);
 };
 
+// Used for synchronous messages. The input parameters are sent, the output
+// parameters come back in the reply.
+template <class SendParamType, class ReplyParamType>
+class SyncMessageSchema;
+
+template <typename... Ins, typename... Outs>
+class SyncMessageSchema<std::tuple<Ins...>, std::tuple<Outs&...> > {
+  public:
+	typedef std::tuple<Ins...> SendParam;
+	typedef std::tuple<Outs...> ReplyParam;
+
+	static void Write(Message* msg, const SendParam& send);
+	static bool ReadSendParam(const Message* msg, SendParam* p);
+	static bool ReadReplyParam(const Message* msg, ReplyParam* p);
+
+	// Calls |func| with the input parameters and pointers to the output
+	// parameters, then sends them back through |sender|. A request that could
+	// not be read gets an error reply, its sender is not left waiting.
+	template <class T, class S, class Method>
+	static bool DispatchWithSendParams(bool ok, const SendParam& send_params,
+									   const Message* msg, T* obj, S* sender,
+									   Method func) {
+		Message* reply = SyncMessage::GenerateReply(msg);
+		if (ok) {
+			ReplyParam reply_params;
+			DispatchToMethod(obj, func, send_params, &reply_params);
+			WriteParam(reply, reply_params);
+		} else {
+			reply->set_reply_error();
+		}
+		sender->Send(reply);
+		return ok;
+	}
+};
+
+// Reads the reply of a sync message into the output parameters the caller
+// of Send() passed pointers to. They may be NULL if the reply is read some
+// other way, see ChannelProxy::SendWithReply().
+template <class ReplyParam>
+class ParamDeserializer;
+
+template <typename... Outs>
+class ParamDeserializer<std::tuple<Outs...> > : public MessageReplyDeserializer {
+  public:
+	explicit ParamDeserializer(const std::tuple<Outs*...>& out) : out_(out) {}
+
+  private:
+	bool SerializeOutputParameters(const Message& msg, base::PickleIterator iter) override {
+		return ReadElements(&msg, &iter, std::index_sequence_for<Outs...>());
+	}
+
+	template <size_t... Ns>
+	bool ReadElements(const Message* m, base::PickleIterator* iter, std::index_sequence<Ns...>) {
+		bool ok = true;
+		bool expand[] = { true, (ok = ok && ReadElement(m, iter, std::get<Ns>(out_)))... };
+		(void)expand;
+		return ok;
+	}
+
+	// A NULL output is still read past so the ones after it line up.
+	template <class P>
+	static bool ReadElement(const Message* m, base::PickleIterator* iter, P* out) {
+		if (out)
+			return ReadParam(m, iter, out);
+		P ignored;
+		return ReadParam(m, iter, &ignored);
+	}
+
+	std::tuple<Outs*...> out_;
+};
+
 
 } // namespace IPC
 
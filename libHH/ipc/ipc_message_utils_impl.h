@@ -7,6 +7,9 @@ namespace IPC {
 template <class ParamType>
 void MessageSchema<ParamType>::Write(Message* msg, const Param& p) 
 {
+	// One allocation for the whole payload, the writes then never grow the
+	// message. For fixed size parameters this is a constant.
+	msg->Reserve(GetParamSize(p));
 	WriteParam(msg, p);
 }
 
@@ -19,6 +22,30 @@ bool MessageSchema<ParamType>::Read(const Message* msg, Param* p)
 	return false;
 }
 
+template <typename... Ins, typename... Outs>
+void SyncMessageSchema<std::tuple<Ins...>, std::tuple<Outs&...> >::Write(Message* msg, const SendParam& send)
+{
+	msg->Reserve(GetParamSize(send));
+	WriteParam(msg, send);
+}
+
+template <typename... Ins, typename... Outs>
+bool SyncMessageSchema<std::tuple<Ins...>, std::tuple<Outs&...> >::ReadSendParam(const Message* msg, SendParam* p)
+{
+	base::PickleIterator iter = SyncMessage::GetDataIterator(msg);
+	return ReadParam(msg, &iter, p);
+}
+
+template <typename... Ins, typename... Outs>
+bool SyncMessageSchema<std::tuple<Ins...>, std::tuple<Outs&...> >::ReadReplyParam(const Message* msg, ReplyParam* p)
+{
+	if (msg->is_reply_error())
+		return false;
+
+	base::PickleIterator iter = SyncMessage::GetDataIterator(msg);
+	return ReadParam(msg, &iter, p);
+}
+
 }  // namespace IPC
 
 
@@ -0,0 +1,183 @@
+#include "ipc/ipc_shared_ring.h"
+
+#include <string.h>
+
+#include <new>
+
+namespace IPC {
+
+namespace internal {
+
+namespace {
+
+// Below this a ring holds less than most messages, above it the positions
+// could wrap past each other.
+const size_t kMinCapacity = 4 * 1024;
+const size_t kMaxCapacity = size_t(1) << 30;
+
+}  // namespace
+
+// The positions grow without bound and wrap at 2^32, the ring offset of a
+// position is position & (capacity - 1). Each side writes its own cache line.
+struct SharedRing::Header
+{
+	enum { kCacheLineSize = 64 };
+
+	// Written by the producer.
+	volatile base::subtle::Atomic32 write_position;
+	volatile base::subtle::Atomic32 space_waiter;
+	char pad0[kCacheLineSize - 2 * sizeof(base::subtle::Atomic32)];
+
+	// Written by the consumer.
+	volatile base::subtle::Atomic32 read_position;
+	volatile base::subtle::Atomic32 data_waiter;
+	char pad1[kCacheLineSize - 2 * sizeof(base::subtle::Atomic32)];
+};
+
+
+SharedRing::SharedRing()
+	: header_(NULL),
+	  data_(NULL),
+	  capacity_(0),
+	  cached_read_position_(0),
+	  cached_write_position_(0)
+{
+
+}
+
+// static
+size_t SharedRing::RegionSize(size_t capacity)
+{
+	return sizeof(Header) + capacity;
+}
+
+// static
+size_t SharedRing::CapacityForRegion(size_t region_size)
+{
+	if (region_size < sizeof(Header) + kMinCapacity)
+		return 0;
+
+	size_t capacity = region_size - sizeof(Header);
+	if (capacity > kMaxCapacity || (capacity & (capacity - 1)))
+		return 0;
+	return capacity;
+}
+
+// static
+void SharedRing::InitializeRegion(void* region)
+{
+	Header* header = new (region) Header;
+	header->write_position = 0;
+	header->space_waiter = 0;
+	header->read_position = 0;
+	header->data_waiter = 1;
+}
+
+void SharedRing::Attach(void* region, size_t capacity)
+{
+	header_ = static_cast<Header*>(region);
+	data_ = static_cast<char*>(region) + sizeof(Header);
+	capacity_ = capacity;
+	cached_read_position_ = base::subtle::Acquire_Load(&header_->read_position);
+	cached_write_position_ = base::subtle::Acquire_Load(&header_->write_position);
+}
+
+size_t SharedRing::Write(const void* data, size_t size)
+{
+	uint32_t write_position = base::subtle::NoBarrier_Load(&header_->write_position);
+	size_t room = capacity_ - (write_position - cached_read_position_);
+	if (room < size)
+	{
+		cached_read_position_ = base::subtle::Acquire_Load(&header_->read_position);
+		room = capacity_ - (write_position - cached_read_position_);
+	}
+
+	// The peer may scribble over the header, it only gets garbage back.
+	if (room > capacity_)
+		return 0;
+	if (size > room)
+		size = room;
+	if (!size)
+		return 0;
+
+	size_t offset = write_position & (capacity_ - 1);
+	size_t first = capacity_ - offset < size ? capacity_ - offset : size;
+	memcpy(data_ + offset, data, first);
+	memcpy(data_, static_cast<const char*>(data) + first, size - first);
+
+	base::subtle::Release_Store(&header_->write_position, write_position + static_cast<uint32_t>(size));
+	return size;
+}
+
+size_t SharedRing::Read(void* buffer, size_t size)
+{
+	uint32_t read_position = base::subtle::NoBarrier_Load(&header_->read_position);
+	size_t available = cached_write_position_ - read_position;
+	if (available < size)
+	{
+		cached_write_position_ = base::subtle::Acquire_Load(&header_->write_position);
+		available = cached_write_position_ - read_position;
+	}
+
+	if (available > capacity_)
+		return 0;
+	if (size > available)
+		size = available;
+	if (!size)
+		return 0;
+
+	size_t offset = read_position & (capacity_ - 1);
+	size_t first = capacity_ - offset < size ? capacity_ - offset : size;
+	memcpy(buffer, data_ + offset, first);
+	memcpy(static_cast<char*>(buffer) + first, data_, size - first);
+
+	base::subtle::Release_Store(&header_->read_position, read_position + static_cast<uint32_t>(size));
+	return size;
+}
+
+bool SharedRing::PrepareToWaitForData()
+{
+	// The flag is set before the last look at the ring, a producer writing
+	// in between either is seen here or sees the flag.
+	base::subtle::NoBarrier_Store(&header_->data_waiter, 1);
+	base::subtle::MemoryBarrier();
+	cached_write_position_ = base::subtle::NoBarrier_Load(&header_->write_position);
+	if (cached_write_position_ != static_cast<uint32_t>(base::subtle::NoBarrier_Load(&header_->read_position)))
+	{
+		base::subtle::NoBarrier_Store(&header_->data_waiter, 0);
+		return false;
+	}
+	return true;
+}
+
+bool SharedRing::TakeDataWaiter()
+{
+	base::subtle::MemoryBarrier();
+	return base::subtle::NoBarrier_Load(&header_->data_waiter) &&
+		   base::subtle::NoBarrier_AtomicExchange(&header_->data_waiter, 0);
+}
+
+bool SharedRing::PrepareToWaitForSpace()
+{
+	base::subtle::NoBarrier_Store(&header_->space_waiter, 1);
+	base::subtle::MemoryBarrier();
+	cached_read_position_ = base::subtle::NoBarrier_Load(&header_->read_position);
+	uint32_t write_position = base::subtle::NoBarrier_Load(&header_->write_position);
+	if (write_position - cached_read_position_ < capacity_)
+	{
+		base::subtle::NoBarrier_Store(&header_->space_waiter, 0);
+		return false;
+	}
+	return true;
+}
+
+bool SharedRing::TakeSpaceWaiter()
+{
+	base::subtle::MemoryBarrier();
+	return base::subtle::NoBarrier_Load(&header_->space_waiter) &&
+		   base::subtle::NoBarrier_AtomicExchange(&header_->space_waiter, 0);
+}
+
+}  // namespace internal
+
+}  // namespace IPC
@@ -0,0 +1,85 @@
+#ifndef IPC_IPC_SHARED_RING_H_
+#define IPC_IPC_SHARED_RING_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "base/atomicops.h"
+#include "base/macros.h"
+
+namespace IPC {
+
+namespace internal {
+
+// Byte ring for one producer and one consumer in different processes, laid
+// out in memory both of them map. It carries the same byte stream as the
+// socket of a channel, ChannelReader frames the messages as usual.
+//
+// Each side tells through the ring whether it is asleep. The other side
+// wakes it (through the socket, see ChannelPosix) only then, a consumer that
+// keeps up with the producer costs no system call at all.
+class SharedRing
+{
+public:
+	SharedRing();
+
+	// Bytes of shared memory a ring of |capacity| takes. |capacity| must be a
+	// power of two.
+	static size_t RegionSize(size_t capacity);
+
+	// Capacity of a ring given |region_size| bytes, 0 if no valid ring fits.
+	static size_t CapacityForRegion(size_t region_size);
+
+	// Sets up a new ring in |region|, once, by the side that creates the
+	// shared memory. The consumer starts out asleep.
+	static void InitializeRegion(void* region);
+
+	// Attaches to a ring set up by InitializeRegion().
+	void Attach(void* region, size_t capacity);
+
+	// Producer side. Copies as much of |data| as fits, returns the number of
+	// bytes written.
+	size_t Write(const void* data, size_t size);
+
+	// Consumer side. Copies up to |size| bytes to |buffer|, returns the
+	// number of bytes read.
+	size_t Read(void* buffer, size_t size);
+
+	// Consumer side, the ring looked empty. Returns true if the consumer may
+	// sleep, false if data came in meanwhile and it should read again.
+	bool PrepareToWaitForData();
+
+	// Producer side, after Write(). Returns true if the consumer sleeps and
+	// has to be woken up, it is then taken as awake.
+	bool TakeDataWaiter();
+
+	// Producer side, the ring was full. Returns true if the producer may
+	// sleep, false if room was made meanwhile.
+	bool PrepareToWaitForSpace();
+
+	// Consumer side, after Read(). Returns true if the producer waits for
+	// room and has to be woken up.
+	bool TakeSpaceWaiter();
+
+	size_t capacity() const { return capacity_; }
+
+private:
+	struct Header;
+
+	Header* header_;
+	char* data_;
+	size_t capacity_;
+
+	// The position of the other side as last read, the shared one is only
+	// read when the ring looks full (or empty).
+	uint32_t cached_read_position_;
+	uint32_t cached_write_position_;
+
+	DISALLOW_COPY_AND_ASSIGN(SharedRing);
+};
+
+}  // namespace internal
+
+}  // namespace IPC
+
+#endif  // IPC_IPC_SHARED_RING_H_
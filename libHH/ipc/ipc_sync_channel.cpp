@@ -0,0 +1,239 @@
+#include "ipc/ipc_sync_channel.h"
+
+#include <utility>
+
+#include "base/synchronization/waitable_event.h"
+#include "ipc/ipc_sync_message.h"
+
+namespace IPC {
+
+//------------------------------------------------------------------------------
+
+SyncChannel::SyncContext::SyncContext(
+    Listener* listener,
+    const scoped_refptr<base::SingleThreadTaskRunner>& ipc_task_runner)
+    : Context(listener, ipc_task_runner),
+      channel_broken_(false)
+{
+
+}
+
+SyncChannel::SyncContext::~SyncContext()
+{
+
+}
+
+// Called on the listener's thread
+bool SyncChannel::SyncContext::Push(SyncMessage* message, base::WaitableEvent* done_event)
+{
+    PendingSyncMsg pending;
+    pending.id = SyncMessage::GetMessageId(*message);
+    pending.deserializer = message->GetReplyDeserializer();
+    pending.done_event = done_event;
+    pending.done = false;
+    pending.send_result = false;
+
+    base::AutoLock auto_lock(lock_);
+    if (channel_broken_)
+    {
+        delete pending.deserializer;
+        return false;
+    }
+
+    deserializers_.push_back(pending);
+    return true;
+}
+
+// Called on the listener's thread
+bool SyncChannel::SyncContext::WaitForReply(base::WaitableEvent* done_event)
+{
+    while (true)
+    {
+        done_event->Wait();
+
+        DispatchReceivedSyncMessages();
+
+        base::AutoLock auto_lock(lock_);
+        if (deserializers_.back().done)
+            break;
+    }
+
+    base::AutoLock auto_lock(lock_);
+    PendingSyncMsg pending = deserializers_.back();
+    deserializers_.pop_back();
+    delete pending.deserializer;
+
+    // Sync messages that came in after the last dispatch. An outer Send()
+    // still waiting handles them, otherwise they go the usual way.
+    if (!received_sync_msgs_.empty())
+    {
+        if (!deserializers_.empty())
+        {
+            deserializers_.back().done_event->Signal();
+        }
+        else
+        {
+            while (!received_sync_msgs_.empty())
+            {
+                PostDispatchMessage(received_sync_msgs_.front());
+                received_sync_msgs_.pop_front();
+            }
+        }
+    }
+    return pending.send_result;
+}
+
+// Called on the listener's thread
+void SyncChannel::SyncContext::DispatchReceivedSyncMessages()
+{
+    base::circular_deque<std::shared_ptr<const Message> > messages;
+    {
+        base::AutoLock auto_lock(lock_);
+        messages.swap(received_sync_msgs_);
+    }
+
+    // The handlers reply through the channel, and may send sync messages
+    // themselves.
+    while (!messages.empty())
+    {
+        OnDispatchMessage(messages.front());
+        messages.pop_front();
+    }
+}
+
+// Called on the IPC::Channel thread
+bool SyncChannel::SyncContext::OnMessageReceived(const Message& msg)
+{
+    if (TryFilters(msg))
+        return true;
+
+    if (msg.is_reply())
+    {
+        // Otherwise it may answer a SendWithReply(). A reply matching neither
+        // is dropped here, its request timed out or was cancelled.
+        if (!TryToUnblockListener(msg))
+            TryToResolveReply(msg);
+        return true;
+    }
+
+    if (msg.is_sync())
+    {
+        // The listener thread may be blocked in Send(), the message goes
+        // straight to it.
+        base::AutoLock auto_lock(lock_);
+        if (!deserializers_.empty())
+        {
+            received_sync_msgs_.push_back(CopyReceivedMessage(msg));
+            deserializers_.back().done_event->Signal();
+            return true;
+        }
+    }
+
+    return OnMessageReceivedNoFilter(msg);
+}
+
+// Called on the IPC::Channel thread
+void SyncChannel::SyncContext::OnChannelError()
+{
+    CancelPendingSends();
+    Context::OnChannelError();
+}
+
+// Called on the IPC::Channel thread
+void SyncChannel::SyncContext::OnChannelClosed()
+{
+    CancelPendingSends();
+    Context::OnChannelClosed();
+}
+
+// Called on the IPC::Channel thread
+bool SyncChannel::SyncContext::TryToUnblockListener(const Message& msg)
+{
+    int id = SyncMessage::GetMessageId(msg);
+
+    // The reply is for the innermost message unless the peer answers out of
+    // order, search from the back.
+    base::AutoLock auto_lock(lock_);
+    for (size_t i = deserializers_.size(); i > 0; --i)
+    {
+        PendingSyncMsg& pending = deserializers_[i - 1];
+        if (pending.id != id || pending.done)
+            continue;
+
+        // The sender is blocked, its output parameters can be written from
+        // this thread.
+        pending.send_result = pending.deserializer->SerializeOutputParameters(msg);
+        pending.done = true;
+        pending.done_event->Signal();
+        return true;
+    }
+    return false;
+}
+
+// Called on the IPC::Channel thread
+void SyncChannel::SyncContext::CancelPendingSends()
+{
+    base::AutoLock auto_lock(lock_);
+    channel_broken_ = true;
+    for (size_t i = 0; i < deserializers_.size(); ++i)
+    {
+        PendingSyncMsg& pending = deserializers_[i];
+        if (pending.done)
+            continue;
+
+        pending.done = true;
+        pending.send_result = false;
+        pending.done_event->Signal();
+    }
+}
+
+//-----------------------------------------------------------------------------
+
+// static
+std::unique_ptr<SyncChannel> SyncChannel::Create(
+    const IPC::ChannelHandle& channel_handle,
+    Channel::Mode mode,
+    Listener* listener,
+    const scoped_refptr<base::SingleThreadTaskRunner>& ipc_task_runner)
+{
+    std::unique_ptr<SyncChannel> channel(new SyncChannel(listener, ipc_task_runner));
+    channel->Init(channel_handle, mode);
+    return channel;
+}
+
+SyncChannel::SyncChannel(Listener* listener,
+    const scoped_refptr<base::SingleThreadTaskRunner>& ipc_task_runner)
+    : ChannelProxy(new SyncContext(listener, ipc_task_runner))
+{
+
+}
+
+SyncChannel::~SyncChannel()
+{
+
+}
+
+bool SyncChannel::Send(Message* message)
+{
+    if (!message->is_sync())
+        return ChannelProxy::Send(message);
+
+    base::WaitableEvent done_event;
+    if (!sync_context()->Push(static_cast<SyncMessage*>(message), &done_event))
+    {
+        delete message;
+        return false;
+    }
+
+    ChannelProxy::Send(message);
+    return sync_context()->WaitForReply(&done_event);
+}
+
+SyncChannel::SyncContext* SyncChannel::sync_context() const
+{
+    return static_cast<SyncContext*>(context());
+}
+
+//-----------------------------------------------------------------------------
+
+}  // namespace IPC
@@ -0,0 +1,111 @@
+#ifndef IPC_IPC_SYNC_CHANNEL_H_
+#define IPC_IPC_SYNC_CHANNEL_H_
+
+#include <memory>
+
+#include "base/containers/circular_deque.h"
+#include "base/synchronization/lock.h"
+#include "ipc/ipc_channel_proxy.h"
+
+namespace base {
+class WaitableEvent;
+}
+
+namespace IPC {
+
+class MessageReplyDeserializer;
+class SyncMessage;
+
+// A ChannelProxy that also sends sync messages. Send() of a SyncMessage
+// blocks the listener thread until the reply has been read into the output
+// parameters. Replies are matched on the IO thread, which wakes the waiting
+// thread directly instead of posting to the listener task runner.
+//
+// While it waits, the thread still handles the sync messages the peer sends
+// it, so two processes sending each other sync messages do not deadlock.
+// Other incoming messages wait until Send() returned.
+//
+// Sync messages must be sent on the listener thread.
+class IPC_EXPORT SyncChannel : public ChannelProxy
+{
+public:
+    static std::unique_ptr<SyncChannel> Create(
+        const IPC::ChannelHandle& channel_handle,
+        Channel::Mode mode,
+        Listener* listener,
+        const scoped_refptr<base::SingleThreadTaskRunner>& ipc_task_runner);
+
+    ~SyncChannel();
+
+    // For a sync message, returns false if the channel broke before the reply
+    // arrived or the reply could not be read.
+    bool Send(Message* message) override;
+
+protected:
+    class SyncContext : public Context
+    {
+    public:
+        SyncContext(Listener* listener,
+            const scoped_refptr<base::SingleThreadTaskRunner>& ipc_task_runner);
+
+        // Registers |message| before it is sent, its reply will signal
+        // |done_event|. Returns false if the channel is broken already.
+        bool Push(SyncMessage* message, base::WaitableEvent* done_event);
+
+        // Waits for the reply to the message pushed last, handling incoming
+        // sync messages meanwhile, then unregisters it. Returns whether the
+        // reply arrived and was read.
+        bool WaitForReply(base::WaitableEvent* done_event);
+
+    protected:
+        ~SyncContext();
+
+        // Context methods, called on the IO thread.
+        bool OnMessageReceived(const Message& msg) override;
+        void OnChannelError() override;
+        void OnChannelClosed() override;
+
+    private:
+        // A sync message waiting for its reply.
+        struct PendingSyncMsg
+        {
+            int id;
+            MessageReplyDeserializer* deserializer;
+            base::WaitableEvent* done_event;
+            bool done;
+            bool send_result;
+        };
+
+        // Reads |msg| into the message it replies to and wakes its sender.
+        // Returns false if no Send() waits for it.
+        bool TryToUnblockListener(const Message& msg);
+
+        // Fails every pending message, the channel cannot deliver replies any
+        // more.
+        void CancelPendingSends();
+
+        // Called on the listener thread while it waits.
+        void DispatchReceivedSyncMessages();
+
+        // Innermost last, a thread handling an incoming sync message may send
+        // one itself. Guarded by |lock_|, like the members below.
+        base::circular_deque<PendingSyncMsg> deserializers_;
+
+        // Sync messages of the peer that arrived while a Send() waited.
+        base::circular_deque<std::shared_ptr<const Message> > received_sync_msgs_;
+
+        // Set once the channel broke, sync messages then fail at once.
+        bool channel_broken_;
+
+        base::Lock lock_;
+    };
+
+    SyncChannel(Listener* listener,
+        const scoped_refptr<base::SingleThreadTaskRunner>& ipc_task_runner);
+
+    SyncContext* sync_context() const;
+};
+
+}  // namespace IPC
+
+#endif  // IPC_IPC_SYNC_CHANNEL_H_
@@ -0,0 +1,81 @@
+#include "ipc/ipc_sync_message.h"
+
+#include "base/atomic_sequence_num.h"
+
+namespace IPC {
+
+namespace {
+
+base::StaticAtomicSequenceNumber g_next_id;
+
+}  // namespace
+
+SyncMessage::SyncMessage(int32_t routing_id, uint32_t type, MessageReplyDeserializer* deserializer)
+	: Message(routing_id, type),
+	  deserializer_(deserializer)
+{
+	set_sync();
+
+	// The request id is the first parameter, so Schema::Write() can add the
+	// others after it. Ids start at 1, GetMessageId() returns 0 for a
+	// message without one.
+	WriteInt(g_next_id.GetNext() + 1);
+}
+
+SyncMessage::~SyncMessage()
+{
+
+}
+
+MessageReplyDeserializer* SyncMessage::GetReplyDeserializer()
+{
+	return deserializer_.release();
+}
+
+bool SyncMessage::IsMessageReplyTo(const Message& msg, int request_id)
+{
+	if (!msg.is_reply())
+		return false;
+
+	return GetMessageId(msg) == request_id;
+}
+
+base::PickleIterator SyncMessage::GetDataIterator(const Message* msg)
+{
+	base::PickleIterator iter(*msg);
+	if (!iter.SkipBytes(sizeof(int)))
+		return base::PickleIterator();
+	return iter;
+}
+
+int SyncMessage::GetMessageId(const Message& msg)
+{
+	if (!msg.is_sync() && !msg.is_reply())
+		return 0;
+
+	base::PickleIterator iter(msg);
+	int request_id = 0;
+	if (!iter.ReadInt(&request_id))
+		return 0;
+	return request_id;
+}
+
+Message* SyncMessage::GenerateReply(const Message* msg)
+{
+	Message* reply = new Message(msg->routing_id(), IPC_REPLY_ID);
+	reply->set_reply();
+	// A server channel sends it to the client the request came from.
+	reply->set_sender_pid(msg->get_sender_pid());
+	reply->WriteInt(GetMessageId(*msg));
+	return reply;
+}
+
+bool MessageReplyDeserializer::SerializeOutputParameters(const Message& msg)
+{
+	if (msg.is_reply_error())
+		return false;
+
+	return SerializeOutputParameters(msg, SyncMessage::GetDataIterator(&msg));
+}
+
+}  // namespace IPC
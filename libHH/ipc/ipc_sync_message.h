@@ -0,0 +1,64 @@
+#ifndef IPC_IPC_SYNC_MESSAGE_H_
+#define IPC_IPC_SYNC_MESSAGE_H_
+
+#include <stdint.h>
+
+#include <memory>
+
+#include "ipc/ipc_message.h"
+
+namespace IPC {
+
+class MessageReplyDeserializer;
+
+// A message its sender blocks on until the reply arrives, see SyncChannel.
+// The first parameter of the payload is a request id, the reply carries the
+// same id and is matched to the request by it.
+class IPC_EXPORT SyncMessage : public Message
+{
+public:
+	// Takes ownership of |deserializer|, which reads the reply into the output
+	// parameters of the caller.
+	SyncMessage(int32_t routing_id, uint32_t type, MessageReplyDeserializer* deserializer);
+	~SyncMessage() override;
+
+	// Gives up the deserializer, the channel keeps it until the reply
+	// arrives. Only call once.
+	MessageReplyDeserializer* GetReplyDeserializer();
+
+	// Returns true if |msg| is the reply to the request |request_id|.
+	static bool IsMessageReplyTo(const Message& msg, int request_id);
+
+	// An iterator positioned after the request id, at the parameters of a
+	// request or a reply.
+	static base::PickleIterator GetDataIterator(const Message* msg);
+
+	// The request id of a request or a reply.
+	static int GetMessageId(const Message& msg);
+
+	// A reply to |msg| without parameters yet, for the receiver to write its
+	// output parameters to.
+	static Message* GenerateReply(const Message* msg);
+
+private:
+	std::unique_ptr<MessageReplyDeserializer> deserializer_;
+};
+
+// Reads the output parameters of a reply into where the caller of Send()
+// wants them.
+class IPC_EXPORT MessageReplyDeserializer
+{
+public:
+	virtual ~MessageReplyDeserializer() {}
+
+	// Returns false if the reply is an error reply or cannot be read.
+	bool SerializeOutputParameters(const Message& msg);
+
+private:
+	// Derived classes read the parameters of |msg| starting at |iter|.
+	virtual bool SerializeOutputParameters(const Message& msg, base::PickleIterator iter) = 0;
+};
+
+}  // namespace IPC
+
+#endif  // IPC_IPC_SYNC_MESSAGE_H_
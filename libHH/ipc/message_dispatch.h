@@ -1,37 +1,66 @@
 #ifndef MESSAGE_DISPATCH_H_
 #define MESSAGE_DISPATCH_H_
 
+#include <stddef.h>
+
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
 namespace IPC {
 
+namespace internal {
+
+template <typename ObjT, typename Method, typename Tuple, size_t... Ns, typename... Extra>
+inline void DispatchToMethodImpl(ObjT* obj, Method method, Tuple&& arg,
+								 std::index_sequence<Ns...>, Extra&&... extra)
+{
+	(obj->*method)(std::forward<Extra>(extra)..., std::get<Ns>(std::forward<Tuple>(arg))...);
+}
 
-template <typename ObjT, typename Method, class A>
-inline void DispatchToMethod(ObjT* obj, Method method, const std::tuple<A>& arg) 
+template <typename ObjT, typename Method, typename In, size_t... Ns, typename Out, size_t... Ms>
+inline void DispatchToMethodImpl(ObjT* obj, Method method, const In& in, std::index_sequence<Ns...>,
+								 Out* out, std::index_sequence<Ms...>)
 {
-	(obj->*method)(std::get<0>(arg));
+	(obj->*method)(std::get<Ns>(in)..., &std::get<Ms>(*out)...);
 }
 
-template <typename ObjT, typename Method, class A, class B>
-inline void DispatchToMethod(ObjT* obj, Method method, const std::tuple<A, B>& arg) 
+}  // namespace internal
+
+// Calls |method| on |obj| with the elements of |arg|. A tuple passed as an
+// rvalue has its elements moved into by-value parameters, const& parameters
+// bind to the elements directly, either way nothing decoded from a message
+// is copied again.
+template <typename ObjT, typename Method, typename... Args>
+inline void DispatchToMethod(ObjT* obj, Method method, const std::tuple<Args...>& arg)
 {
-	(obj->*method)(std::get<0>(arg), std::get<1>(arg));
+	internal::DispatchToMethodImpl(obj, method, arg, std::index_sequence_for<Args...>());
 }
 
-template <typename ObjT, typename Method, class A, class B, class C>
-inline void DispatchToMethod(ObjT* obj, Method method, const std::tuple<A, B, C>& arg) 
+template <typename ObjT, typename Method, typename... Args>
+inline void DispatchToMethod(ObjT* obj, Method method, std::tuple<Args...>&& arg)
 {
-	(obj->*method)(std::get<0>(arg), std::get<1>(arg), std::get<2>(arg));
+	internal::DispatchToMethodImpl(obj, method, std::move(arg), std::index_sequence_for<Args...>());
 }
 
-template <typename ObjT, typename Method, class A, class B, class C, class D>
-inline void DispatchToMethod(ObjT* obj, Method method, const std::tuple<A, B, C, D>& arg) 
+// Calls |method| on |obj| with the elements of |in| followed by pointers to
+// the elements of |out|. Used by sync messages, the handler fills in |out|
+// and it is sent back as the reply.
+template <typename ObjT, typename Method, typename... Ins, typename... Outs>
+inline void DispatchToMethod(ObjT* obj, Method method, const std::tuple<Ins...>& in, std::tuple<Outs...>* out)
 {
-	(obj->*method)(std::get<0>(arg), std::get<1>(arg), std::get<2>(arg), std::get<3>(arg));
+	internal::DispatchToMethodImpl(obj, method, in, std::index_sequence_for<Ins...>(),
+								   out, std::index_sequence_for<Outs...>());
 }
 
-template <typename ObjT, typename Method, class A, class B, class C, class D, class E>
-inline void DispatchToMethod(ObjT* obj, Method method, const std::tuple<A, B, C, D, E>& arg) 
+// Same as above, |parameter| goes first. Used by the message maps declared
+// with IPC_BEGIN_MESSAGE_MAP_WITH_PARAM.
+template <typename ObjT, typename Method, typename P, typename Tuple>
+inline void DispatchToMethodWithParam(ObjT* obj, Method method, P* parameter, Tuple&& arg)
 {
-	(obj->*method)(std::get<0>(arg), std::get<1>(arg), std::get<2>(arg), std::get<3>(arg), std::get<4>(arg));
+	typedef typename std::decay<Tuple>::type TupleType;
+	internal::DispatchToMethodImpl(obj, method, std::forward<Tuple>(arg),
+								   std::make_index_sequence<std::tuple_size<TupleType>::value>(), parameter);
 }
 
 
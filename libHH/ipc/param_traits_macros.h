@@ -12,6 +12,7 @@
 	  static void Write(Message* m, const param_type& p); \
 	  static bool Read(const Message* m, base::PickleIterator* iter, \
 	                   param_type* p); \
+	  static size_t GetSize(const param_type& p); \
     }; \
   }
 
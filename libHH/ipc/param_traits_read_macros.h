@@ -31,7 +31,7 @@
 	bool ParamTraits<enum_name>:: \
 	Read(const Message* m, base::PickleIterator* iter, param_type* p) { \
 	int value; \
-	if (!iter->ReadInt(&value)) \
+	if (!ReadParam(m, iter, &value)) \
 	return false; \
 	if (!(validation_expression)) \
 	return false; \
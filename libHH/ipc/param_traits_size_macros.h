@@ -0,0 +1,32 @@
+#ifndef PARAM_TRAITS_SIZE_MACROS_H_
+#define PARAM_TRAITS_SIZE_MACROS_H_
+
+// Null out all the macros that need nulling.
+#include "ipc_message_null_macros.h"
+
+// STRUCT declarations cause corresponding STRUCT_TRAITS declarations to occur.
+#undef IPC_STRUCT_BEGIN_WITH_PARENT
+#undef IPC_STRUCT_MEMBER
+#undef IPC_STRUCT_END
+#define IPC_STRUCT_BEGIN_WITH_PARENT(struct_name, parent) \
+	IPC_STRUCT_TRAITS_BEGIN(struct_name)
+#define IPC_STRUCT_MEMBER(type, name, ...) IPC_STRUCT_TRAITS_MEMBER(name)
+#define IPC_STRUCT_END() IPC_STRUCT_TRAITS_END()
+
+// Set up so next include will generate size methods.
+#undef IPC_STRUCT_TRAITS_BEGIN
+#undef IPC_STRUCT_TRAITS_MEMBER
+#undef IPC_STRUCT_TRAITS_PARENT
+#undef IPC_STRUCT_TRAITS_END
+#define IPC_STRUCT_TRAITS_BEGIN(struct_name) \
+	size_t ParamTraits<struct_name>::GetSize(const param_type& p) { \
+	return
+#define IPC_STRUCT_TRAITS_MEMBER(name) GetParamSize(p.name) +
+#define IPC_STRUCT_TRAITS_PARENT(type) GetParamSize<type>(p) +
+#define IPC_STRUCT_TRAITS_END() 0; }
+
+// Enums are written as an int, their size is known without a method.
+#undef IPC_ENUM_TRAITS_VALIDATE
+#define IPC_ENUM_TRAITS_VALIDATE(enum_name, validation_expression)
+
+#endif  // PARAM_TRAITS_SIZE_MACROS_H_
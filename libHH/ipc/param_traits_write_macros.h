@@ -27,7 +27,7 @@
 #undef IPC_ENUM_TRAITS_VALIDATE
 #define IPC_ENUM_TRAITS_VALIDATE(enum_name, validation_expression) \
 	void ParamTraits<enum_name>::Write(Message* m, const param_type& value) { \
-	m->WriteInt(static_cast<int>(value)); \
+	WriteParam(m, static_cast<int>(value)); \
   }
 
 #endif  // PARAM_TRAITS_WRITE_MACROS_H_
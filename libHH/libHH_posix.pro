@@ -0,0 +1,52 @@
+# Linux build of the POSIX IPC layer: the epoll message pump, ChannelPosix /
+# ChannelPosixServer, the shared-memory ring and the platform-neutral code
+# they sit on. Windows builds use libHH.vcxproj.
+#
+# The rest of libHH (logging, MessageLoop, the Qt UI pump, ChannelProxy) is
+# not ported to GCC yet and is left out of this target.
+
+TEMPLATE = lib
+TARGET = libHH_posix
+CONFIG += staticlib c++14 warn_on
+CONFIG -= app_bundle
+QT = core
+
+INCLUDEPATH += .
+
+QMAKE_CXXFLAGS_WARN_ON += -Wextra -Werror
+
+HEADERS += \
+    base/files/scoped_file.h \
+    base/memory/shared_memory.h \
+    base/memory/shared_memory_handle.h \
+    base/message_loop/message_pump_epoll.h \
+    ipc/ipc_channel.h \
+    ipc/ipc_channel_posix.h \
+    ipc/ipc_flow_control.h \
+    ipc/ipc_message.h \
+    ipc/ipc_message_attachment_set.h \
+    ipc/ipc_shared_ring.h \
+    ipc/ipc_sync_message.h
+
+SOURCES += \
+    base/files/scoped_file.cpp \
+    base/memory/aligned_memory.cpp \
+    base/memory/ref_counted.cpp \
+    base/memory/ref_counted_memory.cpp \
+    base/memory/shared_memory_posix.cpp \
+    base/message_loop/message_pump.cpp \
+    base/message_loop/message_pump_default.cpp \
+    base/message_loop/message_pump_epoll.cpp \
+    base/pickle.cpp \
+    base/synchronization/lock.cpp \
+    base/synchronization/waitable_event.cpp \
+    base/task_runner.cpp \
+    base/threading/scoped_blocking_call.cpp \
+    base/vlog.cpp \
+    ipc/ipc_channel.cpp \
+    ipc/ipc_channel_posix.cpp \
+    ipc/ipc_flow_control.cpp \
+    ipc/ipc_message.cpp \
+    ipc/ipc_message_attachment_set.cpp \
+    ipc/ipc_shared_ring.cpp \
+    ipc/ipc_sync_message.cpp
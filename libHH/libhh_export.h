@@ -1,17 +1,25 @@
 #ifndef LIBHH_EXPORT_H_
 #define LIBHH_EXPORT_H_
 
+#if defined(_MSC_VER)
 // Ե std ģľ
 __pragma(warning(disable:4251))
+#endif
 
 #if defined(COMPONENT_BUILD)
 
+#if defined(_MSC_VER)
+
 #if defined(LIBHH_IMPLEMENTATION)
 #define LIBHH_EXPORT __declspec(dllexport)
 #else
 #define LIBHH_EXPORT __declspec(dllimport)
 #endif  // defined(LIBHH_IMPLEMENTATION)
 
+#else  // defined(_MSC_VER)
+#define LIBHH_EXPORT __attribute__((visibility("default")))
+#endif
+
 #else  // defined(COMPONENT_BUILD)
 #define LIBHH_EXPORT
 #endif